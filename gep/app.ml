@@ -287,7 +287,7 @@ let make_op_dict name pars atts dict =
 (** Default implementation to access an instruction from "instructions" list.
 	Call the "get_instruction" from the maker with a dictionary augmanted
 	with "IDENT", "ident", "ICODE", "params", "has_param", "num_params",
-	"is_inst_branch", "attr" and "predecode".
+	"is_inst_branch", "is_branch", "attr" and "predecode".
 	@param info		Current generation information (not set for instruction action).
 	@param maker	Current maker structure.
 	@param dict		Environment dictionnary.
@@ -304,6 +304,7 @@ let get_instruction info maker f dict _ i =
 	f (maker.get_instruction  i
 		(("ICODE", Templater.TEXT (fun out -> Printf.fprintf out "%d" (Iter.get_id i))) ::
 		("is_inst_branch", Templater.BOOL (fun _ -> Iter.is_branch_instr i )) ::
+		("is_branch", Templater.BOOL (fun _ -> Branch.is_branch (Branch.branch_reg info))) ::
 		("attr", Templater.FUN (eval_attr info i)) ::
 		("params", Templater.COLL (get_params maker i)) ::
 		("predecode", Templater.TEXT gen_predecode)::
@@ -492,6 +492,31 @@ let to_int32_list m =
 	aux [] 0
 
 
+(** Compute the runs of consecutive ones of a mask, as used by
+	gen_int to extract a masked value a word at a time.
+	@param m	Mask.
+	@return		List of (index of the first bit from the msb, length) with
+				lengths of 32 bits max. *)
+let to_runs m =
+	let s = get_intern_val m in
+	let l = String.length s in
+	let rec aux i res =
+		if i >= l then List.rev res else
+		if s.[i] <> '1' then aux (i + 1) res else
+		let rec run j = if j < l && j - i < 32 && s.[j] = '1' then run (j + 1) else j in
+		let j = run i in
+		aux j ((i, j - i) :: res) in
+	aux 0 []
+
+
+(** Produce the C initializer of the runs of a mask (struct mask_run_t array
+	ended by a null run).
+	@param m	Mask.
+	@return		C initializer. *)
+let c_runs m =
+	"{" ^ (String.concat "" (List.map (fun (p, n) -> Printf.sprintf "{%d, %d}, " p n) (to_runs m))) ^ "{0, 0}}"
+
+
 (** produces the suffix needed in C for the given mask translated in C constant,
 currently only suffix for 64 bit const is returned *)
 let c_const_suffix m =
@@ -267,8 +267,8 @@ let get_mask_decl_for_format_param inst idx =
 	let string_mask = get_mask_for_format_param (get_format_string inst) idx in
 	let mask = Bitmask.to_int32_list string_mask in
 		if not inst_info.is_risc then
-			Printf.sprintf "\tstatic uint32_t tab_mask%d[%d] = {%8s}; /* %s */\n\tstatic mask_t mask%d = {tab_mask%d, %d};\n"
-				idx (List.length mask) (to_C_list mask) (Bitmask.to_string string_mask) idx idx (Bitmask.length string_mask)
+			Printf.sprintf "\tstatic uint32_t tab_mask%d[%d] = {%8s}; /* %s */\n\tstatic struct mask_run_t runs%d[] = %s;\n\tstatic mask_t mask%d = {tab_mask%d, %d, runs%d};\n"
+				idx (List.length mask) (to_C_list mask) (Bitmask.to_string string_mask) idx (Bitmask.c_runs string_mask) idx idx (Bitmask.length string_mask) idx
 		else
 			failwith "shouldn't happen (decode.ml::get_mask_decl_for_format_param)"
 
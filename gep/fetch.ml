@@ -26,6 +26,9 @@ open Printf
 (** Flag to output or not fetch tables stats *)
 let output_fetch_stat    = ref false
 
+(** Flag to output the RISC decoding trees as C switches instead of table walks *)
+let switch_fetch = ref false
+
 (** Threshold for number of duplications of entries of an instruction opcode
 	before the PQMC support (PQMC allows grouping opcodes using X and reduce number
 	of opcodes). *)
@@ -117,6 +120,37 @@ let get_instr_list dt =
 		sl
 
 
+(** Get the C name of a decoding tree node.
+	@param dt	Node to name.
+	@return		"" for the root, "_v1_v2..." for the node of opcode values v1, v2, ... *)
+let dectree_name dt =
+	let rec aux l s =
+		match l with
+		| [] -> s
+		| a::b ->
+			let sa = Bitmask.to_string a in
+			aux b (if (String.length s) == 0 then sa else (s ^ "_" ^ sa)) in
+	match dt with
+	| DecTree(i, _, _, _, _) ->
+		let s = aux i "" in
+		if s = "" then s else "_" ^ s
+
+
+(** Get the value of the last opcode leading to a decoding tree node.
+	@param dt	Node (not the root).
+	@return		Opcode value in the parent table. *)
+let dectree_value dt =
+	match dt with
+	| DecTree(i, _, _, _, _) -> Bitmask.to_int (List.nth i ((List.length i) - 1))
+
+
+(** Find the root of a decoding tree.
+	@param dl	Nodes of the tree.
+	@return		Root node. *)
+let find_root dl =
+	List.find (fun dt -> match dt with DecTree(i, _, _, _, _) -> i = []) dl
+
+
 (** Get the image attribute of the given specfication.
 	@param sp	Specification.
 	@return		Image attribute. *)
@@ -282,6 +316,42 @@ exception CheckIsizeException
 let fetch_generic = 0
 
 
+(** Compute the shift/mask sequence gathering the bits of a mask
+	in a contiguous value (software parallel bit extraction).
+	@param mask	Mask of the bits to gather.
+	@return		List of (right shift, mask after shift) for each run of ones. *)
+let extract_runs mask =
+	let s = Bitmask.get_intern_val mask in
+	let l = String.length s in
+	let is_one i = i < l && s.[l - 1 - i] = '1' in
+	let ones n = if n >= 64 then Int64.minus_one else Int64.pred (Int64.shift_left Int64.one n) in
+	let rec run j = if is_one j then run (j + 1) else j in
+	let rec aux i k res =
+		if i >= l then List.rev res else
+		if not (is_one i) then aux (i + 1) k res else
+		let j = run i in
+		aux j (k + j - i) ((i - k, Int64.shift_left (ones (j - i)) k) :: res) in
+	aux 0 0 []
+
+
+(** Output the C function extracting the opcode of a RISC decoding table.
+	@param out			Stream to output to.
+	@param fetch_size	Instruction size (in bits).
+	@param name			Name of the table.
+	@param mask			Mask of the table. *)
+let output_extract out fetch_size name mask =
+	let suffix = if fetch_size > 32 then "LL" else "" in
+	let term (sh, m) =
+		if sh = 0 then Printf.sprintf "(code & 0X%LX%s)" m suffix
+		else Printf.sprintf "((code >> %d) & 0X%LX%s)" sh m suffix in
+	let body =
+		match extract_runs mask with
+		| [] -> "0"
+		| runs -> String.concat "\n\t\t| " (List.map term runs) in
+	Printf.fprintf out "static uint%d_t extract_table%s(uint%d_t code) {\n\treturn %s;\n}\n"
+		fetch_size name fetch_size body
+
+
 (* outputs the declaration of all structures related to the given DecTree dt
 	in C language, all needed Decode_Ent and Table_Decodage structures
 	will be output and already initialised, everything will be output in
@@ -295,17 +365,7 @@ let fetch_generic = 0
 	@param dl				All node list. *)
 let rec output_table_C_decl fetch_size suffix out fetch_stat dt dl =
 
-	let name_of t =
-		let correct_name s =
-			if s = "" then s else "_" ^ s in
-		let rec aux l s =
-			match l with
-			| [] -> s
-			| a::b ->
-				let sa = Bitmask.to_string a in
-				aux b (if (String.length s) == 0 then sa else (s ^ "_" ^ sa)) in
-		match t with
-		| DecTree(i, s, m, g, d) -> correct_name (aux i "") in
+	let name_of = dectree_name in
 
 	(* we hope we never have a too big mask, we don't want to produce
 	 * fetch tables with millions of entries (most of them void).
@@ -408,11 +468,14 @@ let rec output_table_C_decl fetch_size suffix out fetch_stat dt dl =
 		let nb_nodes = produce_decode_ent 0 0 in
 		Printf.fprintf out "};\n";
 		if fetch_size != fetch_generic then
-			Printf.fprintf out "static Table_Decodage%s _table%s = {0X%LX%s, table_table%s};\n" type_suffix name (Bitmask.to_int64 l_mask) (Bitmask.c_const_suffix l_mask) name
+			(output_extract out fetch_size name l_mask;
+			let decode = if !switch_fetch && (name_of dt) = "" then "decode_table" ^ name else "0" in
+			Printf.fprintf out "static Table_Decodage%s _table%s = {0X%LX%s, table_table%s, extract_table%s, %s};\n" type_suffix name (Bitmask.to_int64 l_mask) (Bitmask.c_const_suffix l_mask) name name decode)
 		else
 			(Printf.fprintf out "static uint32_t tab_mask%s[%d] = {%s};\n" name (List.length (Bitmask.to_int32_list l_mask)) (to_C_list l_mask);
+			Printf.fprintf out "static struct mask_run_t runs%s[] = %s;\n" name (Bitmask.c_runs l_mask);
 			Printf.fprintf out "static mask_t mask%s = {\n\ttab_mask%s," name name;
-			Printf.fprintf out "\t%d};\n" (Bitmask.length l_mask);
+			Printf.fprintf out "\t%d,\n\truns%s};\n" (Bitmask.length l_mask) name;
 			Printf.fprintf out "static Table_Decodage%s _table%s = {&mask%s, table_table%s};\n" type_suffix name name name
 			);
 		Printf.fprintf out "Table_Decodage%s *%s_table%s = &_table%s;\n" type_suffix info.Toc.proc name name;
@@ -422,6 +485,61 @@ let rec output_table_C_decl fetch_size suffix out fetch_stat dt dl =
 			Printf.fprintf fetch_stat "%8d/%8d, name=%s\n" nb_nodes num_dec_ent name )
 
 
+(** Output the decoding tree of a RISC instruction set as a C function
+	made of nested switches on the opcodes extracted by the tables.
+	@param out			Stream to output to.
+	@param fetch_size	Instruction size (in bits).
+	@param suffix		Suffix of the instruction set.
+	@param dl			Nodes of the tree. *)
+let output_switch out fetch_size suffix dl =
+	let info = Toc.info () in
+	let proc = Config.uppercase info.Toc.proc in
+	let rec gen ind dt =
+		let sons = List.sort
+			(fun d1 d2 -> compare (dectree_value d1) (dectree_value d2))
+			(find_sons_of_node dt dl) in
+		Printf.fprintf out "%sswitch(extract_table%s(code)) {\n" ind (suffix ^ (dectree_name dt));
+		List.iter
+			(fun d ->
+				match d with
+				| DecTree(_, sp::_, _, _, _) ->
+					Printf.fprintf out "%scase 0X%X: return %s_%s;\n" ind (dectree_value d) proc (Config.uppercase (Iter.get_name sp))
+				| _ ->
+					Printf.fprintf out "%scase 0X%X:\n" ind (dectree_value d);
+					gen (ind ^ "\t") d)
+			sons;
+		Printf.fprintf out "%sdefault: return %s_UNKNOWN;\n%s}\n" ind proc ind in
+	Printf.fprintf out "static %s_ident_t decode_table%s(uint%d_t code) {\n" info.Toc.proc suffix fetch_size;
+	gen "\t" (find_root dl);
+	Printf.fprintf out "}\n\n"
+
+
+(** Output the statistics of a RISC decoding tree: depth and size
+	as tables or as switches.
+	@param out	Stream to output to.
+	@param dl	Nodes of the tree. *)
+let output_tree_stat out dl =
+	let rec depth d dt =
+		List.fold_left
+			(fun (m, s, n) son ->
+				match son with
+				| DecTree(_, _::_, _, _, _) -> (max m d, s + d, n + 1)
+				| _ ->
+					let (m', s', n') = depth (d + 1) son in
+					(max m m', s + s', n + n'))
+			(d, 0, 0)
+			(find_sons_of_node dt dl) in
+	let (max_depth, sum, count) = depth 1 (find_root dl) in
+	let tables = List.filter (fun dt -> (get_instr_list dt) = []) dl in
+	let entries = List.fold_left (fun s dt -> s + (1 lsl (get_local_mask_length dt))) 0 tables in
+	fprintf out "depth: max=%d, average=%.2f on %d instructions\n"
+		max_depth ((float sum) /. (float (max count 1))) count;
+	fprintf out "tables: %d tables, %d entries (%d bytes of Decode_Ent on a 64-bit host)\n"
+		(List.length tables) entries (entries * 16);
+	fprintf out "switches: %d switches, %d cases\n"
+		(List.length tables) ((List.length dl) - 1)
+
+
 (* sort the DecTree in a given list according to a reverse pseudo-lexicographic order among the name of the DecTrees *)
 let sort_dectree_list d_l =
 	let name_of t =
@@ -641,7 +759,14 @@ let output_table out sp_l fetch_size idx fetch_stat =
 	let suffix = if idx < 0 then "" else ("_" ^ (string_of_int idx)) in
 	let aux dl dt = output_table_C_decl fetch_size suffix out fetch_stat dt dl in
 	let dl =  sort_dectree_list (build_dec_nodes sp_l) in
-	List.iter (aux dl) dl
+	let is_switch = !switch_fetch && fetch_size != fetch_generic in
+	if is_switch then
+		Printf.fprintf out "static %s_ident_t decode_table%s(uint%d_t code);\n\n" (Toc.info ()).Toc.proc suffix fetch_size;
+	List.iter (aux dl) dl;
+	if is_switch then
+		output_switch out fetch_size suffix dl;
+	if !output_fetch_stat && fetch_size != fetch_generic then
+		output_tree_stat fetch_stat dl
 
 
 (** output all C struct declarations and fetch tables
@@ -658,6 +783,8 @@ let output_all_table_C_decl out =
 	let idx = ref (-1) in
 	(*List.iter (fun x -> (output_struct_decl out (fst x) !idx); idx := !idx + 1) iss_sizes;*)
 	idx := if num_iss > 1 then 0 else -1;
+	if !switch_fetch then
+		fprintf out "#define %s_SWITCH_FETCH\n\n" (Config.uppercase (Irg.get_proc_name ()));
 	List.iter
 		(fun (sizes, iset) ->
 			if num_iss > 1 then
@@ -106,6 +106,9 @@ let paths = [
 	Sys.getcwd ()]
 let check				 				= ref false
 let sim                  				= ref false
+let aot                  				= ref false
+let batch                				= ref false
+let jit                  				= ref false
 let decode_arg           				= ref false
 let gen_with_trace       				= ref false
 let size                 				= ref 0
@@ -117,6 +120,8 @@ let options = [
 	("-s",   Arg.Set_int size, "for fixed-size ISA, size of the instructions in bits (to control NMP images)");
 	("-a",   Arg.String (fun a -> sources := a::!sources), "add a source file to the library compilation");
 	("-S",   Arg.Set     sim, "generate the simulator application");
+	("-aot", Arg.Set     aot, "generate the ahead-of-time translator application");
+	("-batch", Arg.Set   batch, "generate the batch simulator application");
 	("-D",   Arg.Set     decode_arg, "activate complex arguments decoding");
 	("-gen-with-trace", Arg.Set gen_with_trace,
         "Generate simulator with decoding of dynamic traces of instructions (faster). module decode_dtrace must be used with this option" );
@@ -124,9 +129,14 @@ let options = [
 		"Optimized generation with a profiling file given it's path. Instructions handlers are sorted to optimized host simulator cache" );
 	("-PJ",  Arg.Int (fun a -> (App.profiled_switch_size := a; switches := ("GLISS_PROFILED_JUMPS", true)::!switches)),
 		"Stands for profiled jumps: enable better branch prediction if -p option is also activated");
+	("-TD",  Arg.Unit (fun _ -> switches := ("GLISS_THREADED_DISPATCH", true)::!switches),
+		"Stands for threaded dispatch: instruction code is inlined in the run functions and dispatched with computed gotos");
+	("-jit", Arg.Unit (fun _ -> jit := true; switches := ("GLISS_JIT", true)::!switches),
+		"generate the block translator: hot blocks are translated into x86-64 host code by the run functions");
 	("-off", Arg.String (fun a -> switches := (a, false)::!switches), "unactivate the given switch");
 	("-on",  Arg.String (fun a -> switches := (a, true)::!switches), "activate the given switch");
 	("-fstat", Arg.Set Fetch.output_fetch_stat, "generates stats about fetch tables in <proc_name>_fetch_tables.stat");
+	("-fswitch", Arg.Set Fetch.switch_fetch, "generates the RISC decoding trees as nested C switches instead of table walks");
 	("-c", Arg.Set check, "only check if the NML is valid for generation");
 	("-no-default", Arg.Set no_default, "disable automatic generation of Makefile, api, fetch, decode and code tables");
 	("-t", Arg.String add_template, "add a template to generate")
@@ -295,7 +305,8 @@ let output_mask_decl inst idx is_risc out =
 		if not is_risc then
 			(Printf.fprintf out "static uint32_t tab_mask%d[%d] = {" idx (List.length mask);
 			Printf.fprintf out "%8s}; /* %s */\n" (to_C_list mask) (Bitmask.to_string string_mask);
-			Printf.fprintf out "\tstatic mask_t mask%d = {tab_mask%d, %d};\n" idx idx (Bitmask.length string_mask))
+			Printf.fprintf out "\tstatic struct mask_run_t runs%d[] = %s;\n" idx (Bitmask.c_runs string_mask);
+			Printf.fprintf out "\tstatic mask_t mask%d = {tab_mask%d, %d, runs%d};\n" idx idx (Bitmask.length string_mask) idx)
 
 
 (** Declare the masks in case of a complex parameter decoding.
@@ -823,7 +834,15 @@ let _ =
 									   "but gep was not able to find a single one while parsing the NML");
 					
 					(* output code table *)
-					App.make_template "code_table.h" "src/code_table.h" dict
+					App.make_template "code_table.h" "src/code_table.h" dict;
+
+					(* output block translator *)
+					if !jit then begin
+						App.make_template "jit.h" "src/jit.h" dict;
+						App.make_template "jit.c" "src/jit.c" dict;
+						App.make_template "jit_stencils.c" "src/jit_stencils.c" dict;
+						App.make_template "jit_mkstencils.c" "src/jit_mkstencils.c" dict
+					end
 				end;
 
 				(* module linking *)
@@ -832,6 +851,37 @@ let _ =
 				(* generate other templates *)
 				List.iter (fun (inp, out) -> App.make_template_path inp out dict) !templates;
 
+				(* generate AOT translator *)
+				if !aot then
+					(try
+						let path = App.find_lib "aot/aot.c" paths in
+						App.makedir "aot";
+						App.replace_gliss info
+							(path ^ "/" ^ "aot/aot.c")
+							("aot/" ^ info.Toc.proc ^ "-aot.c" );
+						App.make_template_path (path ^ "/aot/aot_table.h") "aot/aot_table.h" dict;
+						Templater.generate_path
+							[ ("proc", Templater.TEXT (fun out -> output_string out info.Toc.proc)) ]
+							(path ^ "/aot/Makefile")
+							"aot/Makefile"
+					with Not_found ->
+						raise (Sys_error "no template to make aot program"));
+
+				(* generate batch simulator *)
+				if !batch then
+					(try
+						let path = App.find_lib "batch/batch.c" paths in
+						App.makedir "batch";
+						App.replace_gliss info
+							(path ^ "/" ^ "batch/batch.c")
+							("batch/" ^ info.Toc.proc ^ "-batch.c" );
+						Templater.generate_path
+							[ ("proc", Templater.TEXT (fun out -> output_string out info.Toc.proc)) ]
+							(path ^ "/batch/Makefile")
+							"batch/Makefile"
+					with Not_found ->
+						raise (Sys_error "no template to make batch program"));
+
 				(* generate application *)
 				if !sim then
 					try
@@ -0,0 +1,571 @@
+/*
+ * Ahead-of-time translator base file.
+ * Copyright (c) 2010, IRIT - UPS <casse@irit.fr>
+ *
+ * This file is part of GLISS V2.
+ *
+ * OGliss is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * OGliss is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OGliss; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * This program translates the code sections of an executable into a C
+ * source that may be compiled and linked with the simulator library.
+ * The decoded instructions are grouped in basic blocks ended by the
+ * instructions that may assign the PC (as found by the is_branch analysis
+ * of GEP). Each basic block becomes a C function calling in sequence the
+ * (static) instruction codes of code_table.h with constant instructions
+ * whose operands are extracted at translation time, so that the compiler
+ * can inline the codes and optimize across the instructions of the block.
+ * The block may be entered at any of its instructions and is left as soon
+ * as the PC is not the next instruction, the simulation is ended or the
+ * block is written. When the PC leaves the block sequentially, the function
+ * tail-calls the block that follows.
+ *
+ * The generated gliss_aot_run() function executes a simulator using these
+ * functions and falls back to gliss_step() for addresses that have not
+ * been translated, for blocks containing a breakpoint and, with a memory
+ * supporting GLISS_MEM_WATCH, for translated blocks that have been written.
+ * The generated main() simulates the translated executable (unless
+ * GLISS_AOT_NO_MAIN is defined).
+ *
+ * The generated source must be compiled with optimization (at least -O2)
+ * to inline the instruction codes and turn the chaining calls into jumps.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <gliss/api.h>
+#include <gliss/macros.h>
+#include <gliss/loader.h>
+#include <gliss/id.h>
+#include "aot_table.h"
+
+/* translated instruction */
+typedef struct aot_inst_t {
+	gliss_address_t addr;
+	gliss_address_t next;
+	int block;					/* index of the basic block (-1 if not translated) */
+	gliss_inst_t inst;
+} aot_inst_t;
+
+/* basic block */
+typedef struct aot_block_t {
+	int first, last;			/* indexes of first and last instructions */
+} aot_block_t;
+
+static aot_inst_t *insts = NULL;
+static int insts_cnt = 0, insts_max = 0;
+static aot_block_t *blocks = NULL;
+static int blocks_cnt = 0;
+
+
+/**
+ * Display usage of the command.
+ * @param prog_name	Program name.
+ */
+static void usage(const char *prog_name) {
+	fprintf(stderr, "SYNTAX: %s OPTIONS <exec_name>\n\n"
+			"OPTIONS may be a combination of \n"
+			"  -h, -help             : display usage message\n"
+			"  -o <path>             : output C file (default <exec_name>-aotsim.c)\n"
+			"  -v, -verbose          : display translated instructions\n"
+			"\n", prog_name);
+}
+
+
+/**
+ * Add a translated instruction.
+ * @param inst	Decoded instruction.
+ * @return		0 for success, -1 for memory error.
+ */
+static int add_inst(gliss_inst_t *inst) {
+	aot_inst_t *i;
+
+	/* enlarge the array */
+	if(insts_cnt == insts_max) {
+		aot_inst_t *n;
+		insts_max = insts_max ? insts_max * 2 : 1024;
+		n = (aot_inst_t *)realloc(insts, insts_max * sizeof(aot_inst_t));
+		if(n == NULL)
+			return -1;
+		insts = n;
+	}
+
+	/* record the instruction */
+	i = &insts[insts_cnt++];
+	i->addr = inst->addr;
+	i->next = inst->addr + gliss_get_inst_size(inst) / 8;
+	i->block = -1;
+	i->inst = *inst;
+	return 0;
+}
+
+
+/**
+ * Comparison of translated instructions by address.
+ */
+static int compare_inst(const void *p1, const void *p2) {
+	const aot_inst_t *i1 = (const aot_inst_t *)p1, *i2 = (const aot_inst_t *)p2;
+	if(i1->addr < i2->addr)
+		return -1;
+	else if(i1->addr > i2->addr)
+		return 1;
+	else
+		return 0;
+}
+
+
+/**
+ * Look for a translated instruction.
+ * @param addr	Address of the instruction.
+ * @return		Found instruction or NULL.
+ */
+static aot_inst_t *find_inst(gliss_address_t addr) {
+	int l = 0, h = insts_cnt - 1;
+	while(l <= h) {
+		int m = (l + h) / 2;
+		if(insts[m].addr == addr)
+			return &insts[m];
+		else if(insts[m].addr < addr)
+			l = m + 1;
+		else
+			h = m - 1;
+	}
+	return NULL;
+}
+
+
+/**
+ * Group the sorted instructions in basic blocks. A block starts after
+ * an unknown instruction, a gap or an instruction that may assign the PC.
+ * @return	0 for success, -1 for memory error.
+ */
+static int build_blocks(void) {
+	int i, leader = 1;
+
+	blocks = (aot_block_t *)malloc((insts_cnt ? insts_cnt : 1) * sizeof(aot_block_t));
+	if(blocks == NULL)
+		return -1;
+	for(i = 0; i < insts_cnt; i++) {
+		if(insts[i].inst.ident == GLISS_UNKNOWN) {
+			leader = 1;
+			continue;
+		}
+		if(leader || insts[i - 1].next != insts[i].addr) {
+			blocks[blocks_cnt].first = i;
+			blocks_cnt++;
+		}
+		insts[i].block = blocks_cnt - 1;
+		blocks[blocks_cnt - 1].last = i;
+		leader = gliss_aot_branch_table[insts[i].inst.ident];
+	}
+	return 0;
+}
+
+
+/**
+ * Output the C source of the translated instructions.
+ * @param out	Stream to output to.
+ * @param exec	Executable name.
+ */
+static void output(FILE *out, const char *exec) {
+	int i, b, n = 0;
+	int pref = strlen(GLISS_PROC_NAME) + 1;
+
+	/* count the translated instructions */
+	for(i = 0; i < insts_cnt; i++)
+		if(insts[i].block >= 0)
+			n++;
+
+	/* header */
+	fprintf(out,
+		"/* Generated by gliss-aot from %s */\n\n"
+		"#include <stdint.h>\n"
+		"#include <stdio.h>\n"
+		"#include <string.h>\n"
+		"#include <gliss/api.h>\n"
+		"#include <gliss/id.h>\n"
+		"#include <gliss/loader.h>\n"
+		"#include <gliss/mem.h>\n"
+		"#define GLISS_NO_CODE_TABLE\n"
+		"#include \"code_table.h\"\n\n"
+		"typedef void (*gliss_aot_fun_t)(gliss_sim_t *sim, gliss_state_t *state, uint64_t *cnt);\n"
+		"typedef struct { gliss_address_t addr, next; gliss_aot_fun_t fun; } gliss_aot_block_t;\n"
+		"typedef struct { gliss_address_t addr; int block; } gliss_aot_entry_t;\n\n"
+		"/* flags of the translated blocks, stopping the chaining */\n"
+		"#define GLISS_AOT_BRK	1	/* breakpoint */\n"
+		"#define GLISS_AOT_SMC	2	/* written code, executed by gliss_step() */\n"
+		"static unsigned char gliss_aot_flags[%d];\n\n",
+		exec, blocks_cnt ? blocks_cnt : 1);
+
+	/* declarations */
+	for(b = 0; b < blocks_cnt; b++)
+		fprintf(out, "static void gliss_aot_%08llx(gliss_sim_t *, gliss_state_t *, uint64_t *);\n",
+			(unsigned long long)insts[blocks[b].first].addr);
+	fputc('\n', out);
+
+	/* block functions */
+	for(b = 0; b < blocks_cnt; b++) {
+		aot_inst_t *first = &insts[blocks[b].first], *last = &insts[blocks[b].last], *next;
+
+		/* instructions with extracted operands */
+		fprintf(out, "/* block %08llx-%08llx */\n",
+			(unsigned long long)first->addr, (unsigned long long)last->next);
+		fprintf(out, "static const gliss_inst_t gliss_aot_i%08llx[] = {\n", (unsigned long long)first->addr);
+		for(i = blocks[b].first; i <= blocks[b].last; i++) {
+			fprintf(out, "\t{ ");
+			gliss_aot_output_inst(out, &insts[i].inst);
+			fprintf(out, " },\n");
+		}
+		fprintf(out, "};\n");
+
+		/* function */
+		fprintf(out,
+			"static void gliss_aot_%08llx(gliss_sim_t *sim, gliss_state_t *state, uint64_t *cnt) {\n"
+			"\tuint64_t n = 0;\n"
+			"\tswitch(state->GLISS_PC_NAME) {\n",
+			(unsigned long long)first->addr);
+		for(i = blocks[b].first; i <= blocks[b].last; i++) {
+			fprintf(out,
+				"\tcase 0x%08llx:\n"
+				"\t\tgliss_instr_%s_code(state, (gliss_inst_t *)&gliss_aot_i%08llx[%d]);\n"
+				"\t\tn++;\n",
+				(unsigned long long)insts[i].addr, gliss_get_string_ident(insts[i].inst.ident) + pref,
+				(unsigned long long)first->addr, i - blocks[b].first);
+			if(i < blocks[b].last)
+				fprintf(out,
+					"\t\tif(state->GLISS_PC_NAME != 0x%08llx || sim->ended || gliss_aot_flags[%d])\n"
+					"\t\t\tbreak;\n",
+					(unsigned long long)insts[i].next, b);
+		}
+		fprintf(out,
+			"\t}\n"
+			"\t*cnt += n;\n");
+		next = find_inst(last->next);
+		if(next != NULL && next->block >= 0)
+			fprintf(out,
+				"\tif(state->GLISS_PC_NAME == 0x%08llx && !gliss_aot_flags[%d] && !sim->ended)\n"
+				"\t\tgliss_aot_%08llx(sim, state, cnt);\n",
+				(unsigned long long)last->next, next->block,
+				(unsigned long long)insts[blocks[next->block].first].addr);
+		fprintf(out, "}\n\n");
+	}
+
+	/* block table */
+	fprintf(out, "static const gliss_aot_block_t gliss_aot_blocks[] = {\n");
+	for(b = 0; b < blocks_cnt; b++)
+		fprintf(out, "\t{ 0x%08llx, 0x%08llx, gliss_aot_%08llx },\n",
+			(unsigned long long)insts[blocks[b].first].addr, (unsigned long long)insts[blocks[b].last].next,
+			(unsigned long long)insts[blocks[b].first].addr);
+	fprintf(out, "\t{ 0, 0, 0 }\n};\n\n");
+
+	/* instruction table */
+	fprintf(out, "static const gliss_aot_entry_t gliss_aot_table[] = {\n");
+	for(i = 0; i < insts_cnt; i++)
+		if(insts[i].block >= 0)
+			fprintf(out, "\t{ 0x%08llx, %d },\n", (unsigned long long)insts[i].addr, insts[i].block);
+	fprintf(out, "\t{ 0, -1 }\n};\n\n");
+
+	/* code watcher */
+	fprintf(out,
+		"#ifdef GLISS_MEM_WATCH\n"
+		"/* called at the first write to a page of translated code */\n"
+		"static void gliss_aot_watcher(gliss_memory_t *mem, gliss_address_t address, uint32_t size, void *data) {\n"
+		"\tint i;\n"
+		"\tfor(i = 0; i < %d; i++)\n"
+		"\t\tif(gliss_aot_blocks[i].addr <= address + (size - 1) && gliss_aot_blocks[i].next - 1 >= address)\n"
+		"\t\t\tgliss_aot_flags[i] |= GLISS_AOT_SMC;\n"
+		"}\n"
+		"#endif\n\n",
+		blocks_cnt);
+
+	/* run function */
+	fprintf(out,
+		"/**\n"
+		" * Run the simulator using the code translated from %s.\n"
+		" * As gliss_run_and_count_inst(), the execution stops at the end of the simulation\n"
+		" * or at a breakpoint. Addresses that are not translated, blocks containing\n"
+		" * a breakpoint and written code are executed by gliss_step().\n"
+		" * @param sim	Simulator to run.\n"
+		" * @return		Number of executed instructions.\n"
+		" */\n"
+		"uint64_t gliss_aot_run(gliss_sim_t *sim) {\n"
+		"\tgliss_state_t *state = sim->state;\n"
+		"\tuint64_t cnt = 0;\n"
+		"\tint i;\n"
+		"#ifdef GLISS_MEM_WATCH\n"
+		"\tgliss_memory_t *mem = gliss_get_memory(gliss_platform(state), GLISS_MAIN_MEMORY);\n"
+		"#endif\n"
+		"\n"
+		"\t/* record the breakpoints and watch the translated code */\n"
+		"\tfor(i = 0; i < %d; i++)\n"
+		"\t\tgliss_aot_flags[i] &= ~GLISS_AOT_BRK;\n"
+		"\tfor(i = 0; i < %d; i++) {\n"
+		"\t\tif(gliss_is_breakpoint(sim, gliss_aot_table[i].addr))\n"
+		"\t\t\tgliss_aot_flags[gliss_aot_table[i].block] |= GLISS_AOT_BRK;\n"
+		"#ifdef GLISS_MEM_WATCH\n"
+		"\t\tif(!(gliss_aot_flags[gliss_aot_table[i].block] & GLISS_AOT_SMC))\n"
+		"\t\t\tgliss_mem_watch(mem, gliss_aot_table[i].addr);\n"
+		"#endif\n"
+		"\t}\n"
+		"#ifdef GLISS_MEM_WATCH\n"
+		"\tgliss_mem_add_watcher(mem, gliss_aot_watcher, 0);\n"
+		"#endif\n"
+		"\n"
+		"\twhile(!sim->ended) {\n"
+		"\t\tgliss_address_t pc = state->GLISS_PC_NAME;\n"
+		"\t\tint l = 0, h = %d, m = -1;\n"
+		"\t\twhile(l <= h) {\n"
+		"\t\t\tint k = (l + h) / 2;\n"
+		"\t\t\tif(gliss_aot_table[k].addr == pc) { m = gliss_aot_table[k].block; break; }\n"
+		"\t\t\telse if(gliss_aot_table[k].addr < pc) l = k + 1;\n"
+		"\t\t\telse h = k - 1;\n"
+		"\t\t}\n"
+		"\t\tif(m >= 0 && !gliss_aot_flags[m]) {\n"
+		"\t\t\tgliss_aot_blocks[m].fun(sim, state, &cnt);\n"
+		"\t\t\t/* the decoded trace of gliss_step() is no more the current one */\n"
+		"\t\t\tsim->trace = 0;\n"
+		"\t\t}\n"
+		"\t\telse {\n"
+		"\t\t\tgliss_step(sim);\n"
+		"\t\t\tcnt++;\n"
+		"\t\t}\n"
+		"\t\tif(gliss_is_breakpoint(sim, state->GLISS_PC_NAME)) {\n"
+		"\t\t\tif(state->GLISS_PC_NAME == sim->addr_exit)\n"
+		"\t\t\t\tsim->ended = 1;\n"
+		"\t\t\tbreak;\n"
+		"\t\t}\n"
+		"\t}\n"
+		"\n"
+		"#ifdef GLISS_MEM_WATCH\n"
+		"\tgliss_mem_remove_watcher(mem, gliss_aot_watcher, 0);\n"
+		"#endif\n"
+		"\treturn cnt;\n"
+		"}\n\n",
+		exec, blocks_cnt, n, n - 1);
+
+	/* driver */
+	fprintf(out,
+		"#ifndef GLISS_AOT_NO_MAIN\n"
+		"/**\n"
+		" * Simulate %s with the translated code.\n"
+		" * usage: <command> [-stats] [ARGUMENTS]\n"
+		" */\n"
+		"int main(int argc, char **argv) {\n"
+		"\tstatic const char *path = \"%s\";\n"
+		"\tchar *envp[] = { 0 };\n"
+		"\tgliss_loader_t *loader;\n"
+		"\tgliss_platform_t *pf;\n"
+		"\tgliss_state_t *state;\n"
+		"\tgliss_sim_t *sim;\n"
+		"\tgliss_env_t *env;\n"
+		"\tgliss_address_t start, exit_addr = 0;\n"
+		"\tuint64_t cnt;\n"
+		"\tint i, stats = 0;\n"
+		"\n"
+		"\t/* look for start and exit addresses */\n"
+		"\tif(argc > 1 && strcmp(argv[1], \"-stats\") == 0) {\n"
+		"\t\tstats = 1;\n"
+		"\t\targc--;\n"
+		"\t\targv++;\n"
+		"\t}\n"
+		"\tloader = gliss_loader_open(path);\n"
+		"\tif(loader == 0) {\n"
+		"\t\tfprintf(stderr, \"ERROR: cannot open %%s\\n\", path);\n"
+		"\t\treturn 2;\n"
+		"\t}\n"
+		"\tstart = gliss_loader_start(loader);\n"
+		"\ti = gliss_loader_find_sym(loader, \"_exit\");\n"
+		"\tif(i >= 0) {\n"
+		"\t\tgliss_loader_sym_t data;\n"
+		"\t\tgliss_loader_sym(loader, i, &data);\n"
+		"\t\texit_addr = data.value;\n"
+		"\t}\n"
+		"\tgliss_loader_close(loader);\n"
+		"\n"
+		"\t/* build the simulator */\n"
+		"\tpf = gliss_new_platform();\n"
+		"\tif(pf == 0) {\n"
+		"\t\tfprintf(stderr, \"ERROR: cannot create platform\\n\");\n"
+		"\t\treturn 2;\n"
+		"\t}\n"
+		"\tgliss_lock_platform(pf);\n"
+		"\targv[0] = (char *)path;\n"
+		"\tenv = gliss_get_sys_env(pf);\n"
+		"\tenv->argc = argc;\n"
+		"\tenv->argv = argv;\n"
+		"\tenv->argv_addr = 0;\n"
+		"\tenv->envp = envp;\n"
+		"\tenv->envp_addr = 0;\n"
+		"\tenv->auxv = 0;\n"
+		"\tenv->auxv_addr = 0;\n"
+		"\tenv->stack_pointer = 0;\n"
+		"\tif(gliss_load_platform(pf, path) == -1) {\n"
+		"\t\tfprintf(stderr, \"ERROR: cannot load %%s\\n\", path);\n"
+		"\t\tgliss_unlock_platform(pf);\n"
+		"\t\treturn 2;\n"
+		"\t}\n"
+		"\tstate = gliss_new_state(pf);\n"
+		"\tif(state == 0) {\n"
+		"\t\tfprintf(stderr, \"ERROR: cannot create the state\\n\");\n"
+		"\t\tgliss_unlock_platform(pf);\n"
+		"\t\treturn 2;\n"
+		"\t}\n"
+		"\tsim = gliss_new_sim(state, start, exit_addr);\n"
+		"\tif(sim == 0) {\n"
+		"\t\tfprintf(stderr, \"ERROR: cannot create the simulator\\n\");\n"
+		"\t\tgliss_delete_state(state);\n"
+		"\t\tgliss_unlock_platform(pf);\n"
+		"\t\treturn 2;\n"
+		"\t}\n"
+		"\n"
+		"\t/* run it */\n"
+		"\tcnt = 0;\n"
+		"\twhile(!gliss_is_sim_ended(sim))\n"
+		"\t\tcnt += gliss_aot_run(sim);\n"
+		"\tif(stats)\n"
+		"\t\tfprintf(stderr, \"%%llu instructions\\n\", (unsigned long long)cnt);\n"
+		"\n"
+		"\t/* cleanup (the simulator releases the state) */\n"
+		"\tgliss_delete_sim(sim);\n"
+		"\tgliss_unlock_platform(pf);\n"
+		"\treturn 0;\n"
+		"}\n"
+		"#endif\n",
+		exec, exec);
+}
+
+
+int main(int argc, char **argv) {
+	gliss_platform_t *platform;
+	gliss_decoder_t *decoder;
+	gliss_loader_t *loader;
+	const char *exec = NULL, *out_path = NULL;
+	char *exec_argv[2] = { NULL, NULL }, *exec_envp[1] = { NULL };
+	gliss_env_t *env;
+	char buffer[256];
+	int verbose = 0;
+	int i, s;
+	FILE *out;
+
+	/* scan arguments */
+	for(i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "-h") == 0)  {
+			usage(argv[0]);
+			return 0;
+		}
+		else if(strcmp(argv[i], "-verbose") == 0 || strcmp(argv[i], "-v") == 0)
+			verbose = 1;
+		else if(strcmp(argv[i], "-o") == 0) {
+			i++;
+			if(i >= argc) {
+				usage(argv[0]);
+				fprintf(stderr, "ERROR: -o option requires a path\n");
+				return 2;
+			}
+			out_path = argv[i];
+		}
+		else if(argv[i][0] == '-') {
+			usage(argv[0]);
+			fprintf(stderr, "ERROR: unknown option: %s\n", argv[i]);
+			return 2;
+		}
+		else
+			exec = argv[i];
+	}
+	if(exec == NULL) {
+		usage(argv[0]);
+		fprintf(stderr, "ERROR: no executable given !\n");
+		return 2;
+	}
+
+	/* load the executable */
+	loader = gliss_loader_open(exec);
+	if(loader == NULL) {
+		fprintf(stderr, "ERROR: cannot open program %s\n", exec);
+		return 2;
+	}
+	platform = gliss_new_platform();
+	if(platform == NULL) {
+		fprintf(stderr, "ERROR: cannot create platform\n");
+		return 2;
+	}
+	gliss_lock_platform(platform);
+	env = gliss_get_sys_env(platform);
+	env->argc = 1;
+	env->argv = exec_argv;
+	env->envp = exec_envp;
+	exec_argv[0] = (char *)exec;
+	gliss_load(platform, loader);
+	decoder = gliss_new_decoder(platform);
+	if(decoder == NULL) {
+		fprintf(stderr, "ERROR: cannot create decoder\n");
+		return 2;
+	}
+
+	/* decode the code sections */
+	for(s = 0; s < gliss_loader_count_sects(loader); s++) {
+		gliss_loader_sect_t sect;
+		gliss_address_t addr;
+		gliss_loader_sect(loader, s, &sect);
+		if(sect.type != GLISS_LOADER_SECT_TEXT)
+			continue;
+		if(verbose)
+			fprintf(stderr, "translating %s (%08llx, %d bytes)\n", sect.name, (unsigned long long)sect.addr, sect.size);
+		for(addr = sect.addr; addr < sect.addr + sect.size; ) {
+			gliss_inst_t *inst = gliss_decode(decoder, addr);
+			unsigned long size = gliss_get_inst_size(inst) / 8;
+			if(verbose) {
+				gliss_disasm(buffer, inst);
+				fprintf(stderr, "%08llx: %s\n", (unsigned long long)addr, buffer);
+			}
+			if(add_inst(inst) < 0) {
+				fprintf(stderr, "ERROR: not enough memory\n");
+				return 1;
+			}
+			gliss_free_inst(inst);
+			addr += size ? size : 1;
+		}
+	}
+	qsort(insts, insts_cnt, sizeof(aot_inst_t), compare_inst);
+	if(build_blocks() < 0) {
+		fprintf(stderr, "ERROR: not enough memory\n");
+		return 1;
+	}
+	if(verbose)
+		fprintf(stderr, "%d basic blocks\n", blocks_cnt);
+
+	/* output the source */
+	if(out_path == NULL) {
+		snprintf(buffer, sizeof(buffer), "%s-aotsim.c", exec);
+		out_path = buffer;
+	}
+	out = fopen(out_path, "w");
+	if(out == NULL) {
+		fprintf(stderr, "ERROR: cannot create %s\n", out_path);
+		return 1;
+	}
+	output(out, exec);
+	fclose(out);
+
+	/* cleanup */
+	gliss_delete_decoder(decoder);
+	gliss_loader_close(loader);
+	gliss_unlock_platform(platform);
+	free(insts);
+	free(blocks);
+	return 0;
+}
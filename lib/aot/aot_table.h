@@ -0,0 +1,63 @@
+/* Generated by gep ($(date)) copyright (c) 2010 IRIT - UPS */
+
+#ifndef GLISS_$(PROC)_AOT_AOT_TABLE_H
+#define GLISS_$(PROC)_AOT_AOT_TABLE_H
+
+/*
+ * Instruction tables of the ahead-of-time translator: instructions ending
+ * a basic block and output of the decoded operands as C initializers.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <$(proc)/api.h>
+#include <$(proc)/macros.h>
+
+/* instructions that may assign the PC (is_branch analysis), ending a basic block */
+static const unsigned char $(proc)_aot_branch_table[] = {
+	1$(foreach instructions),
+	$(if is_branch)1$(else)0$(end)$(end)
+};
+
+/* output of an operand value as a C constant */
+#define $(PROC)_AOT_OUT_INT(out, v, t)	fprintf(out, "(" t ")0x%llxULL", (unsigned long long)(v))
+#define $(PROC)_AOT_OUT_int8(out, v)	$(PROC)_AOT_OUT_INT(out, v, "int8_t")
+#define $(PROC)_AOT_OUT_uint8(out, v)	$(PROC)_AOT_OUT_INT(out, v, "uint8_t")
+#define $(PROC)_AOT_OUT_int16(out, v)	$(PROC)_AOT_OUT_INT(out, v, "int16_t")
+#define $(PROC)_AOT_OUT_uint16(out, v)	$(PROC)_AOT_OUT_INT(out, v, "uint16_t")
+#define $(PROC)_AOT_OUT_int32(out, v)	$(PROC)_AOT_OUT_INT(out, v, "int32_t")
+#define $(PROC)_AOT_OUT_uint32(out, v)	$(PROC)_AOT_OUT_INT(out, v, "uint32_t")
+#define $(PROC)_AOT_OUT_int64(out, v)	$(PROC)_AOT_OUT_INT(out, v, "int64_t")
+#define $(PROC)_AOT_OUT_uint64(out, v)	$(PROC)_AOT_OUT_INT(out, v, "uint64_t")
+#define $(PROC)_AOT_OUT__float(out, v)	fprintf(out, "%af", (double)(v))
+#define $(PROC)_AOT_OUT__double(out, v)	fprintf(out, "%a", (double)(v))
+#define $(PROC)_AOT_OUT__long_double(out, v)	fprintf(out, "%LaL", (long double)(v))
+
+/**
+ * Output the identifier, the address and the operands of a decoded instruction
+ * as the designated initializers of a $(proc)_inst_t.
+ * @param out	Stream to output to.
+ * @param inst	Decoded instruction.
+ */
+static void $(proc)_aot_output_inst(FILE *out, $(proc)_inst_t *inst) {
+	fprintf(out, ".ident = %s, .addr = 0x%llx",
+		$(proc)_get_string_ident(inst->ident), (unsigned long long)inst->addr);
+	switch(inst->ident) {
+$(foreach instructions)
+	case $(PROC)_$(IDENT):
+$(foreach params)
+$(if !GLISS_INSTR_FAST_STRUCT)
+		fprintf(out, ", .instrinput[$(INDEX)].val.$(param_type) = ");
+$(else)
+		fprintf(out, ", .op_union.op_struct_$(ident).$(PARAM) = ");
+$(end)
+		$(PROC)_AOT_OUT_$(param_type)(out, $(PROC)_$(IDENT)_$(PARAM));
+$(end)
+		break;
+$(end)
+	default:
+		break;
+	}
+}
+
+#endif /* GLISS_$(PROC)_AOT_AOT_TABLE_H */
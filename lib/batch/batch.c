@@ -0,0 +1,462 @@
+/*
+ * Batch simulator base file.
+ * Copyright (c) 2010, IRIT - UPS <casse@irit.fr>
+ *
+ * This file is part of GLISS V2.
+ *
+ * GLISS V2 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * GLISS V2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GLISS V2; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <gliss/api.h>
+#include <gliss/loader.h>
+#include <gliss/config.h>
+
+extern char **environ;
+
+/* exit code of a simulated program (first system call parameter) */
+#ifdef GLISS_SYSPARM_REG32_REG
+#	define EXIT_CODE(state)		((int)GLISS_SYSPARM_REG32_REG(state, 0))
+#else
+#	define EXIT_CODE(state)		0
+#endif
+
+/* job status */
+typedef enum job_status_t {
+	JOB_WAITING = 0,	/* not run yet */
+	JOB_ENDED,			/* simulation ended (exit address or exit system call) */
+	JOB_BUDGET,			/* maximal instruction count reached */
+	JOB_ERROR			/* simulation cannot be prepared */
+} job_status_t;
+
+static const char *status_names[] = {
+	"waiting",
+	"ended",
+	"budget",
+	"error"
+};
+
+
+/**
+ * A program image shared by all jobs running the same executable:
+ * the ELF file is parsed only once and, with the decoder module
+ * decode_shared_cache, the decoded instructions are shared by the jobs.
+ */
+typedef struct image_t {
+	char *path;						/* executable path */
+	gliss_loader_t *loader;			/* opened executable */
+	gliss_address_t start;			/* start address */
+	gliss_address_t exit;			/* exit address (_exit symbol) */
+#ifdef GLISS_SHARED_DECODE_CACHE
+	gliss_decode_cache_t *cache;	/* decoded instructions */
+#endif
+	struct image_t *next;
+} image_t;
+
+
+/**
+ * A simulation job, built from a line of the job list.
+ */
+typedef struct job_t {
+	int line;				/* line in the job list */
+	image_t *image;			/* executable image */
+	int argc;				/* simulated arguments */
+	char **argv;
+	job_status_t status;	/* result status */
+	int code;				/* exit code */
+	uint64_t insts;			/* executed instructions */
+	uint64_t time;			/* simulation time (in micro-seconds) */
+} job_t;
+
+
+/**
+ * Batch description shared by the workers.
+ */
+typedef struct batch_t {
+	job_t *jobs;			/* job table */
+	int cnt;				/* job count */
+	int next;				/* next job to run */
+	uint64_t max;			/* maximal instruction count by job (0 for no limit) */
+	image_t *images;		/* loaded images */
+} batch_t;
+
+
+/**
+ * Display usage of the command.
+ * @param prog_name	Program name.
+ */
+static void usage(const char *prog_name) {
+	fprintf(stderr, "SYNTAX: %s OPTIONS <job list>\n\n"
+			"OPTIONS may be a combination of \n"
+			"  -h, -help             : display usage message\n"
+			"  -j=<count>            : number of worker threads (default number of processors)\n"
+			"  -max=<count>          : stop each simulation after <count> instructions\n"
+			"  -o=<path>             : output the job results in the given file (default stdout)\n"
+			"\n"
+			"each line of the job list gives an executable followed by its arguments\n"
+			"(separated by white spaces); empty lines and lines starting with '#' are ignored.\n"
+			"The result file contains one line by job with: line number in the job list,\n"
+			"status (ended, budget or error), exit code, executed instructions,\n"
+			"simulation time (in micro-seconds) and executable path.\n\n", prog_name);
+}
+
+
+/**
+ * Display error.
+ * @param fmt		Format string.
+ * @param ...		Format arguments.
+ */
+static void error(const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	fprintf(stderr, "ERROR: ");
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+
+/**
+ * Get the image of an executable, loading it if required.
+ * @param batch		Current batch.
+ * @param path		Executable path.
+ * @return			Found image or null (error displayed).
+ */
+static image_t *get_image(batch_t *batch, const char *path) {
+	gliss_loader_sym_t data;
+	image_t *image;
+	int i;
+
+	/* already loaded? */
+	for(image = batch->images; image != NULL; image = image->next)
+		if(strcmp(image->path, path) == 0)
+			return image;
+
+	/* build the image */
+	image = (image_t *)calloc(1, sizeof(image_t));
+	if(image == NULL) {
+		error("no more memory\n");
+		return NULL;
+	}
+	image->loader = gliss_loader_open(path);
+	if(image->loader == NULL) {
+		error("cannot open program %s: %s\n", path, strerror(errno));
+		free(image);
+		return NULL;
+	}
+	image->path = strdup(path);
+	image->start = gliss_loader_start(image->loader);
+	i = gliss_loader_find_sym(image->loader, "_exit");
+	if(i < 0) {
+		error("cannot find the \"_exit\" symbol in %s\n", path);
+		gliss_loader_close(image->loader);
+		free(image->path);
+		free(image);
+		return NULL;
+	}
+	gliss_loader_sym(image->loader, i, &data);
+	image->exit = data.value;
+#	ifdef GLISS_SHARED_DECODE_CACHE
+		image->cache = gliss_new_decode_cache(0);
+#	endif
+
+	/* record it */
+	image->next = batch->images;
+	batch->images = image;
+	return image;
+}
+
+
+/**
+ * Release the images of the batch.
+ * @param batch		Batch to work on.
+ */
+static void delete_images(batch_t *batch) {
+	while(batch->images != NULL) {
+		image_t *image = batch->images;
+		batch->images = image->next;
+		gliss_loader_close(image->loader);
+#		ifdef GLISS_SHARED_DECODE_CACHE
+			gliss_unlock_decode_cache(image->cache);
+#		endif
+		free(image->path);
+		free(image);
+	}
+}
+
+
+/**
+ * Read the job list.
+ * @param batch		Batch to fill.
+ * @param path		Path of the job list.
+ * @return			0 for success, -1 for error (displayed).
+ */
+static int read_jobs(batch_t *batch, const char *path) {
+	char buf[4096];
+	int line = 0, max = 0;
+	FILE *in;
+
+	in = fopen(path, "r");
+	if(in == NULL) {
+		error("cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	while(fgets(buf, sizeof(buf), in) != NULL) {
+		char *args[256], *p;
+		job_t *job;
+		int argc = 0, i;
+		line++;
+
+		/* split the line */
+		for(p = strtok(buf, " \t\r\n"); p != NULL && argc < 255; p = strtok(NULL, " \t\r\n"))
+			args[argc++] = p;
+		if(argc == 0 || args[0][0] == '#')
+			continue;
+
+		/* allocate the job */
+		if(batch->cnt == max) {
+			max = max ? max * 2 : 64;
+			batch->jobs = (job_t *)realloc(batch->jobs, max * sizeof(job_t));
+			if(batch->jobs == NULL) {
+				error("no more memory\n");
+				fclose(in);
+				return -1;
+			}
+		}
+		job = &batch->jobs[batch->cnt++];
+		memset(job, 0, sizeof(job_t));
+		job->line = line;
+
+		/* get the image */
+		job->image = get_image(batch, args[0]);
+		if(job->image == NULL) {
+			fclose(in);
+			return -1;
+		}
+
+		/* record the arguments */
+		job->argc = argc;
+		job->argv = (char **)malloc((argc + 1) * sizeof(char *));
+		if(job->argv == NULL) {
+			error("no more memory\n");
+			fclose(in);
+			return -1;
+		}
+		for(i = 0; i < argc; i++)
+			job->argv[i] = strdup(args[i]);
+		job->argv[argc] = NULL;
+	}
+
+	fclose(in);
+	return 0;
+}
+
+
+/**
+ * Run a job.
+ * @param batch		Current batch.
+ * @param job		Job to run.
+ */
+static void run_job(batch_t *batch, job_t *job) {
+	struct timeval start_time, end_time, delay;
+	gliss_platform_t *pf;
+	gliss_state_t *state;
+	gliss_sim_t *sim;
+	gliss_env_t *env;
+	gliss_stop_t reason;
+
+	gettimeofday(&start_time, NULL);
+
+	/* build the platform from the image */
+	pf = gliss_new_platform();
+	if(pf == NULL) {
+		job->status = JOB_ERROR;
+		return;
+	}
+	/* hold the platform until the cleanup (the state only holds it while it lives) */
+	gliss_lock_platform(pf);
+	env = gliss_get_sys_env(pf);
+	env->argc = job->argc;
+	env->argv = job->argv;
+	env->argv_addr = 0;
+	env->envp = environ;
+	env->envp_addr = 0;
+	env->auxv = 0;
+	env->auxv_addr = 0;
+	env->stack_pointer = 0;
+#	ifdef GLISS_SHARED_DECODE_CACHE
+		gliss_set_decode_cache(pf, job->image->cache);
+#	endif
+	gliss_load(pf, job->image->loader);
+
+	/* build the simulator */
+	state = gliss_new_state(pf);
+	if(state == NULL) {
+		gliss_unlock_platform(pf);
+		job->status = JOB_ERROR;
+		return;
+	}
+	sim = gliss_new_sim(state, job->image->start, job->image->exit);
+	if(sim == NULL) {
+		gliss_delete_state(state);
+		gliss_unlock_platform(pf);
+		job->status = JOB_ERROR;
+		return;
+	}
+
+	/* simulate */
+	if(batch->max == 0) {
+		job->insts = gliss_run_and_count_inst(sim);
+		job->status = JOB_ENDED;
+	}
+	else {
+		job->insts = gliss_run_n(sim, batch->max, &reason);
+		job->status = reason == GLISS_STOP_BUDGET ? JOB_BUDGET : JOB_ENDED;
+	}
+	if(job->status == JOB_ENDED)
+		job->code = EXIT_CODE(state);
+
+	/* cleanup */
+	gliss_delete_sim(sim);
+	gliss_unlock_platform(pf);
+
+	gettimeofday(&end_time, NULL);
+	timersub(&end_time, &start_time, &delay);
+	job->time = (uint64_t)delay.tv_sec * 1000000 + delay.tv_usec;
+}
+
+
+/**
+ * Worker thread: run the jobs until the list is empty.
+ * @param arg	Current batch.
+ */
+static void *run_worker(void *arg) {
+	batch_t *batch = (batch_t *)arg;
+	while(1) {
+		int i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+		if(i >= batch->cnt)
+			break;
+		run_job(batch, &batch->jobs[i]);
+	}
+	return NULL;
+}
+
+
+/**
+ * Batch simulator entry point.
+ */
+int main(int argc, char **argv) {
+	batch_t batch;
+	pthread_t *workers;
+	int threads = 0, i, j, failed = 0;
+	char *list = NULL, *out_path = NULL;
+	FILE *out = stdout;
+
+	/* parse arguments */
+	memset(&batch, 0, sizeof(batch));
+	for(i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0) {
+			usage(argv[0]);
+			return 0;
+		}
+		else if(strncmp(argv[i], "-j=", 3) == 0)
+			threads = atoi(argv[i] + 3);
+		else if(strncmp(argv[i], "-max=", 5) == 0)
+			batch.max = strtoull(argv[i] + 5, NULL, 10);
+		else if(strncmp(argv[i], "-o=", 3) == 0)
+			out_path = argv[i] + 3;
+		else if(argv[i][0] == '-') {
+			usage(argv[0]);
+			error("unknown option: %s\n", argv[i]);
+			return 2;
+		}
+		else if(list != NULL) {
+			usage(argv[0]);
+			error("several job lists given\n");
+			return 2;
+		}
+		else
+			list = argv[i];
+	}
+	if(list == NULL) {
+		usage(argv[0]);
+		error("no job list given!\n");
+		return 2;
+	}
+	if(threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(threads <= 0)
+		threads = 1;
+
+	/* load the jobs and their images */
+	if(read_jobs(&batch, list) < 0)
+		return 1;
+	if(threads > batch.cnt)
+		threads = batch.cnt;
+
+	/* run the workers */
+	workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+	if(workers == NULL) {
+		error("no more memory\n");
+		return 1;
+	}
+	for(i = 0; i < threads; i++)
+		if(pthread_create(&workers[i], NULL, run_worker, &batch) != 0) {
+			error("cannot create worker %d\n", i);
+			threads = i;
+			break;
+		}
+	for(i = 0; i < threads; i++)
+		pthread_join(workers[i], NULL);
+	free(workers);
+
+	/* output the results */
+	if(out_path != NULL) {
+		out = fopen(out_path, "w");
+		if(out == NULL) {
+			error("cannot open %s: %s\n", out_path, strerror(errno));
+			return 1;
+		}
+	}
+	fprintf(out, "# line\tstatus\tcode\tinstructions\ttime(us)\texecutable\n");
+	for(i = 0; i < batch.cnt; i++) {
+		job_t *job = &batch.jobs[i];
+		fprintf(out, "%d\t%s\t%d\t%llu\t%llu\t%s\n",
+			job->line, status_names[job->status], job->code,
+			(unsigned long long)job->insts, (unsigned long long)job->time,
+			job->image->path);
+		if(job->status == JOB_ERROR || job->status == JOB_WAITING)
+			failed++;
+	}
+	if(out != stdout)
+		fclose(out);
+
+	/* cleanup */
+	for(i = 0; i < batch.cnt; i++) {
+		for(j = 0; j < batch.jobs[i].argc; j++)
+			free(batch.jobs[i].argv[j]);
+		free(batch.jobs[i].argv);
+	}
+	free(batch.jobs);
+	delete_images(&batch);
+	return failed ? 1 : 0;
+}
@@ -13,6 +13,7 @@ extern  "C"
 #define GLISS_CATEGORY_STATE
 #define GLISS_CATEGORY_INIT(s)
 #define GLISS_CATEGORY_DESTROY(s)
+#define GLISS_CATEGORY_COPY(s, src)
 
 #if defined(__cplusplus)
 }
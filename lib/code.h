@@ -13,6 +13,7 @@ extern  "C"
 #define GLISS_CODE_STATE
 #define GLISS_CODE_INIT(s)
 #define GLISS_CODE_DESTROY(s)
+#define GLISS_CODE_COPY(s, src)
 
 #if defined(__cplusplus)
 }
@@ -28,127 +28,39 @@
 #include <gliss/config.h>
 
 /**
- * Data structure for storing labels.
+ * Disassembler instance.
  */
-typedef struct list_entry_t {
-	const char *name;
-	gliss_address_t addr;
-	struct list_entry_t *next;
-} list_entry_t;
+typedef struct disasm_inst_t {
+	gliss_loader_t *loader;		/* loader providing the labels */
+} disasm_inst_t;
 
 
 /**
- * List of labels.
+ * Disassembler instance of the current thread, used by the label solver
+ * (that has no context argument).
  */
-static list_entry_t *labels = 0;
-
-
-/**
- * Print list of labels.
- */
-void print_list(list_entry_t *l) {
-	fprintf(stderr, "printing list\n");
-	list_entry_t *e = l;
-	while(e) {
-		fprintf(stderr, "\t\"%s\"\t%08X\n", e->name, e->addr);
-		e = e->next;
-	}
-	fprintf(stderr, "end list.\n");
-}
-
-
-/**
- * Add a symbol to the label list.
- * @param m		List header.
- * @param n		Name of label.
- * @param a		Address of label.
- */
-void add_to_list(list_entry_t **m, const char *n, gliss_address_t a) {
-
-#	ifdef GLISS_PROCESS_CODE_LABEL
-		{ GLISS_PROCESS_CODE_LABEL(a); }
-#	endif
-
-	/* build the node */
-	list_entry_t *e = (list_entry_t *)malloc(sizeof(list_entry_t));
-	if(e == 0) {
-		fprintf(stderr, "ERROR: malloc failed\n");
-		return;
-	}
-	e->name = n;
-	e->addr = a;
-	e->next = 0;
-
-	/* find the position */
-	list_entry_t *cur = *m;
-	list_entry_t **prev = m;
-	while(cur && cur->addr < a) {
-		prev = &cur->next;
-		cur = cur->next;
-	}
-
-	/* insert the node */
-	*prev = e;
-	if(cur)
-		e->next = cur;
-}
+static __thread disasm_inst_t *current_disasm = 0;
 
 
 /**
  * Get the label name associated with an address
- * @param	m	the sorted list to search within
+ * @param	loader	loader containing the symbols
  * @para	addr	the address whose label (if any) is wanted
  * @param	name	will point to the name if a label exists, NULL otherwise
  * @return	0 if no label exists for the given address, non zero otherwise
 */
-int get_label_from_list(list_entry_t *m, gliss_address_t addr, const char **name) {
-
-	/* find the entry */
-	list_entry_t *e = m;
-	while(e && e->addr < addr)
-		e = e->next;
-
-	/* found ? */
-	if(e && e->addr == addr) {
-		*name = e->name;
-		return 1;
-	}
-
-	/* not found */
-	else {
-		*name = 0;
-		return 0;
-	}
-}
-
-
-/**
- * Get the closer name associated with an address
- * @param	m	the sorted list to search within
- * @para	addr	the address whose label (if any) is wanted
- * @return	Closer entry associated with address or null.
-*/
-list_entry_t *get_closer_label_from_list(list_entry_t *m, gliss_address_t addr) {
-	list_entry_t *e = m, *prev = 0;
-	while(e && e->addr <= addr) {
-		prev = e;
-		e = e->next;
-	}
-	return prev;
-}
-
-
-/**
- * Destroy the label list.
- * @param m		Label list header.
- */
-void destroy_list(list_entry_t *m) {
-	list_entry_t *cur = m;
-	while(cur) {
-		list_entry_t *next = cur->next;
-		free(cur);
-		cur = next;
+static int get_label(gliss_loader_t *loader, gliss_address_t addr, const char **name) {
+	gliss_loader_sym_t data;
+	int sym = gliss_loader_find_sym_at(loader, addr);
+	if(sym >= 0) {
+		gliss_loader_sym(loader, sym, &data);
+		if(data.value == addr) {
+			*name = data.name;
+			return 1;
+		}
 	}
+	*name = 0;
+	return 0;
 }
 
 
@@ -196,14 +108,18 @@ static void fail_with_help(const char *msg, ...) {
  * @return			Result string of conversion.
  */
 char *gliss_solve_label_disasm(gliss_address_t address) {
-	static char buf[256];
-	list_entry_t *lab = get_closer_label_from_list(labels, address);
-	if(!lab)
+	static __thread char buf[256];
+	gliss_loader_sym_t lab;
+	int sym = gliss_loader_find_sym_at(current_disasm->loader, address);
+	if(sym < 0)
 		sprintf(buf, "%08x", address);
-	else if(lab->addr == address)
-		snprintf(buf, sizeof(buf), "%08x <%s>", address, lab->name);
-	else
-		snprintf(buf, sizeof(buf), "%08x <%s+0x%x>", address, lab->name, address - lab->addr);
+	else {
+		gliss_loader_sym(current_disasm->loader, sym, &lab);
+		if(lab.value == address)
+			snprintf(buf, sizeof(buf), "%08x <%s>", address, lab.name);
+		else
+			snprintf(buf, sizeof(buf), "%08x <%s+0x%x>", address, lab.name, address - lab.value);
+	}
 	return buf;
 }
 
@@ -223,6 +139,7 @@ int main(int argc, char **argv) {
 	gliss_inst_t *(*decode)(gliss_decoder_t *decoder, gliss_address_t address) = gliss_decode;
 	int i_sect;
 	gliss_decoder_t *d;
+	disasm_inst_t disasm = { 0 };
 
 	/* test arguments */
 	for(i = 1; i < argc; i++) {
@@ -276,20 +193,24 @@ int main(int argc, char **argv) {
 		gliss_loader_sym(loader, sym_it, &data);
 		if(data.type == GLISS_LOADER_SYM_CODE || data.type == GLISS_LOADER_SYM_DATA) {
 			printf("[L]");
-			if(data.sect != 0)
-				add_to_list(&labels, data.name, data.value);
+#			ifdef GLISS_PROCESS_CODE_LABEL
+				if(data.sect != 0)
+					{ GLISS_PROCESS_CODE_LABEL(data.value); }
+#			endif
 		}
 		printf("\t%20s\tvalue:%08X\tsize:%08X\tinfo:%08X\tshndx:%08X\n", data.name, data.value, data.size, data.type, data.sect);
 	}
 
 	/* configure disassembly */
+	disasm.loader = loader;
+	current_disasm = &disasm;
 	gliss_solve_label = gliss_solve_label_disasm;
 
 	/* create the platform */
 	pf = gliss_new_platform();
 	if(pf == NULL) {
 		fprintf(stderr, "ERROR: cannot create the platform.");
-		destroy_list(labels);
+		gliss_loader_close(loader);
 		return 1;
 	}
 
@@ -330,7 +251,7 @@ int main(int argc, char **argv) {
 			const char *n;
 
 			/* display label */
-			if(get_label_from_list(labels, adr_start, &n)) {
+			if(get_label(loader, adr_start, &n)) {
 				printf("\n%08x <%s>\n", adr_start, n);
 				prev_addr = adr_start;
 			}
@@ -361,7 +282,7 @@ int main(int argc, char **argv) {
 	/* cleanup */
 	gliss_delete_decoder(d);
 	gliss_unlock_platform(pf);
-	destroy_list(labels);
+	gliss_loader_close(loader);
 
 	return 0;
 }
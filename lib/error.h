@@ -33,6 +33,7 @@
 #define GLISS_ERROR_STATE
 #define GLISS_ERROR_INIT(s)
 #define GLISS_ERROR_DESTROY(s)
+#define GLISS_ERROR_COPY(s, src)
 
 /* functions */
 void gliss_panic(const char *format, ...);
@@ -111,6 +111,12 @@
 #define PRIMARYMEMORY_HASH_TABLE_SIZE 4096
 /* secondary hash table size */
 #define SECONDARYMEMORY_HASH_TABLE_SIZE 16
+/* software TLB size (must be a power of 2) */
+#ifndef MEMORY_TLB_SIZE
+#	define MEMORY_TLB_SIZE 64
+#endif
+/* tag of an invalid TLB entry (never a page address) */
+#define MEMORY_TLB_INVALID	1
 
 /*
  * Memory is allocated dynamically when needed.
@@ -149,20 +155,380 @@ typedef struct memory_page_table_entry_t  {
 	gliss_address_t addr;
 	struct memory_page_table_entry_t *next;
 	uint8_t *storage;
+	struct memory_chunk_t *frame;	/* chunk containing the storage */
+	int slot;						/* index of the storage in the frame */
+	int watched;					/* watched by gliss_mem_watch() */
+	int dirty;						/* written since gliss_mem_clear_dirty() */
 } memory_page_table_entry_t;
 
 typedef struct  {
 	memory_page_table_entry_t *pte[SECONDARYMEMORY_HASH_TABLE_SIZE];
 } secondary_memory_hash_table_t;
 
+/*
+ * Accesses to the pages go first through a direct-mapped software TLB
+ * associating page addresses with page storage, one for the reads and
+ * one for the writes. The hash tables are only used on a TLB miss.
+ *
+ * Reading a page that has never been written does not allocate it:
+ * the read is served by a shared zero page and the page is only allocated
+ * at its first write (the TLB entries of the page are then invalidated).
+ *
+ * A page only enters the write TLB after being marked dirty by a write
+ * through the hash tables, so that the dirty tracking of incremental
+ * checkpoints costs nothing to the writes hitting the TLB.
+ */
+typedef struct {
+	gliss_address_t tag;	/* page address or MEMORY_TLB_INVALID */
+	uint8_t *storage;
+} memory_tlb_entry_t;
+
+/* function called at the first write to a watched page */
+typedef struct memory_watcher_t {
+	struct memory_watcher_t *next;
+	gliss_mem_watcher_t fun;
+	void *data;
+} memory_watcher_t;
+
 struct gliss_memory_t {
 	void* image_link; /* link to a generic image data resource of the memory
 	                     it permits to fetch informations about image structure
 	                     via an optionnal external system */
     secondary_memory_hash_table_t *primary_hash_table[PRIMARYMEMORY_HASH_TABLE_SIZE];
+	memory_tlb_entry_t read_tlb[MEMORY_TLB_SIZE];
+	memory_tlb_entry_t write_tlb[MEMORY_TLB_SIZE];
+	struct memory_chunk_t *chunks;	/* allocated page storages */
+	struct memory_pte_block_t *ptes;	/* allocated page descriptors */
+	uint32_t watch_stamp;			/* count of writes to watched pages */
+	memory_watcher_t *watchers;		/* functions called on these writes */
+	gliss_address_t *unborn;		/* watched pages not allocated yet */
+	int unborn_cnt, unborn_max;
 };
 typedef struct gliss_memory_t memory_64_t;
 
+/* PAGE POOL */
+
+/*
+ * Pages are not allocated one by one but by chunks of MEMORY_CHUNK_PAGES
+ * pages: a chunk contains a page-aligned block of storage. The page
+ * descriptors are allocated apart, by blocks of MEMORY_PTE_BLOCK, so that
+ * a page sharing the storage of another memory does not reserve
+ * storage. The chunks of a memory are released at once when the memory
+ * is deleted and up to MEMORY_POOL_KEEP chunks are kept in a free list
+ * to be reused by the next memories, avoiding to go back to the system
+ * allocator when platforms are repeatedly created and deleted.
+ *
+ * The storage of a page may be shared by several memories after a
+ * gliss_mem_copy() (copy-on-write): the chunks count the references
+ * to each of their storage pages and a shared page is copied in a private
+ * page at its first write. A chunk is released when its memory is deleted
+ * and no other memory still references its storage pages.
+ */
+
+/* number of pages in a chunk */
+#ifndef MEMORY_CHUNK_PAGES
+#	define MEMORY_CHUNK_PAGES	64
+#endif
+/* maximal number of chunks kept in the free list */
+#ifndef MEMORY_POOL_KEEP
+#	define MEMORY_POOL_KEEP	256
+#endif
+/* number of page descriptors in a block */
+#ifndef MEMORY_PTE_BLOCK
+#	define MEMORY_PTE_BLOCK	64
+#endif
+
+typedef struct memory_chunk_t {
+	struct memory_chunk_t *next;
+	int used;						/* number of used pages */
+	int refs;						/* references (owner memory and storage pages) */
+	void *block;					/* allocated storage block */
+	uint8_t *storage;				/* page-aligned storage */
+	int frame_refs[MEMORY_CHUNK_PAGES];	/* references to the storage pages */
+} memory_chunk_t;
+
+typedef struct memory_pte_block_t {
+	struct memory_pte_block_t *next;
+	int used;						/* number of used descriptors */
+	memory_page_table_entry_t entries[MEMORY_PTE_BLOCK];
+} memory_pte_block_t;
+
+/* free chunks */
+static memory_chunk_t *mem_free_chunks = NULL;
+/* pool statistics */
+static gliss_mem_pool_stats_t mem_pool_stats = { 0, 0, 0, 0, MEMORY_CHUNK_PAGES, 0 };
+/* lock of the pool and of the storage counters (memories used by different
+   threads may share storage pages after a gliss_mem_copy()); the counters
+   of the storage pages are also atomically updated as a memory checks
+   without lock if its page is still shared before writing it */
+static char mem_pool_locked = 0;
+
+
+/**
+ * Acquire the lock of the page pool.
+ */
+static inline void mem_pool_lock(void) {
+	while(__atomic_test_and_set(&mem_pool_locked, __ATOMIC_ACQUIRE))
+		;
+}
+
+
+/**
+ * Release the lock of the page pool.
+ */
+static inline void mem_pool_unlock(void) {
+	__atomic_clear(&mem_pool_locked, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Get a new chunk, from the free list or from the system.
+ * Must be called with the pool lock.
+ * @return	Allocated chunk (NULL if there is not enough memory).
+ */
+static memory_chunk_t *mem_alloc_chunk(void) {
+	memory_chunk_t *chunk = mem_free_chunks;
+
+	/* reuse a free chunk */
+	if(chunk != NULL) {
+		mem_free_chunks = chunk->next;
+		mem_pool_stats.free_chunks--;
+		mem_pool_stats.reused_chunks++;
+	}
+
+	/* allocate a new chunk */
+	else {
+		chunk = (memory_chunk_t *)malloc(sizeof(memory_chunk_t));
+		if(chunk == NULL)
+			return NULL;
+		chunk->block = malloc(MEMORY_CHUNK_PAGES * MEMORY_PAGE_SIZE + MEMORY_PAGE_SIZE);
+		if(chunk->block == NULL) {
+			free(chunk);
+			return NULL;
+		}
+		chunk->storage = (uint8_t *)(((uintptr_t)chunk->block + MEMORY_PAGE_SIZE - 1) & ~(uintptr_t)(MEMORY_PAGE_SIZE - 1));
+		mem_pool_stats.system_chunks++;
+	}
+
+	chunk->used = 0;
+	return chunk;
+}
+
+
+/**
+ * Give a chunk back to the pool. Must be called with the pool lock.
+ * @param chunk	Released chunk.
+ */
+static void mem_release_chunk(memory_chunk_t *chunk) {
+	mem_pool_stats.pages -= chunk->used;
+	if(mem_pool_stats.free_chunks < MEMORY_POOL_KEEP) {
+		chunk->next = mem_free_chunks;
+		mem_free_chunks = chunk;
+		mem_pool_stats.free_chunks++;
+	}
+	else {
+		free(chunk->block);
+		free(chunk);
+	}
+}
+
+
+/**
+ * Allocate a page descriptor in the blocks of the given memory.
+ * @param mem	Memory to allocate for.
+ * @return		Allocated page entry (without storage).
+ */
+static memory_page_table_entry_t *mem_alloc_pte(memory_64_t *mem) {
+	memory_pte_block_t *block = mem->ptes;
+	memory_page_table_entry_t *pte;
+
+	/* need a new block ? */
+	if(block == NULL || block->used == MEMORY_PTE_BLOCK) {
+		block = (memory_pte_block_t *)malloc(sizeof(memory_pte_block_t));
+		assertp(block != NULL, "Failed to allocate memory in mem_alloc_pte\n");
+		block->used = 0;
+		block->next = mem->ptes;
+		mem->ptes = block;
+	}
+
+	/* allocate the descriptor */
+	pte = &block->entries[block->used++];
+	pte->storage = NULL;
+	pte->frame = NULL;
+	pte->slot = 0;
+	pte->watched = 0;
+	pte->dirty = 0;
+	return pte;
+}
+
+
+/**
+ * Allocate a page storage in the chunks of the given memory and make
+ * the given page entry use it. Must be called with the pool lock.
+ * @param mem	Memory to allocate for.
+ * @param pte	Page entry.
+ */
+static void mem_alloc_storage(memory_64_t *mem, memory_page_table_entry_t *pte) {
+	memory_chunk_t *chunk = mem->chunks;
+
+	/* need a new chunk ? */
+	if(chunk == NULL || chunk->used == MEMORY_CHUNK_PAGES) {
+		chunk = mem_alloc_chunk();
+		assertp(chunk != NULL, "Failed to allocate memory in mem_alloc_storage\n");
+		chunk->refs = 1;
+		chunk->next = mem->chunks;
+		mem->chunks = chunk;
+	}
+
+	/* allocate the storage */
+	pte->frame = chunk;
+	pte->slot = chunk->used;
+	pte->storage = chunk->storage + pte->slot * MEMORY_PAGE_SIZE;
+	__atomic_store_n(&chunk->frame_refs[pte->slot], 1, __ATOMIC_RELAXED);
+	chunk->refs++;
+	chunk->used++;
+	mem_pool_stats.pages++;
+}
+
+
+/**
+ * Release the reference of a page entry to its storage.
+ * Must be called with the pool lock.
+ * @param pte	Page entry.
+ */
+static void mem_unref_storage(memory_page_table_entry_t *pte) {
+	memory_chunk_t *frame = pte->frame;
+	__atomic_sub_fetch(&frame->frame_refs[pte->slot], 1, __ATOMIC_RELEASE);
+	if(--frame->refs == 0)
+		mem_release_chunk(frame);
+}
+
+
+/**
+ * Allocate a page descriptor and its storage.
+ * @param mem	Memory to allocate for.
+ * @return		Allocated page entry.
+ */
+static memory_page_table_entry_t *mem_alloc_page(memory_64_t *mem) {
+	memory_page_table_entry_t *pte = mem_alloc_pte(mem);
+	mem_pool_lock();
+	mem_alloc_storage(mem, pte);
+	mem_pool_unlock();
+#	ifndef GLISS_NO_PAGE_INIT
+		memset(pte->storage, 0, MEMORY_PAGE_SIZE);
+#	endif
+	return pte;
+}
+
+
+/**
+ * Allocate a page descriptor sharing the storage of the given page
+ * (no storage is reserved).
+ * @param mem	Memory to allocate for.
+ * @param src	Shared page (of another memory).
+ * @return		Allocated page entry.
+ */
+static memory_page_table_entry_t *mem_share_page(memory_64_t *mem, memory_page_table_entry_t *src) {
+	memory_page_table_entry_t *pte = mem_alloc_pte(mem);
+	mem_pool_lock();
+	pte->addr = src->addr;
+	pte->storage = src->storage;
+	pte->frame = src->frame;
+	pte->slot = src->slot;
+	pte->dirty = 1;
+	__atomic_add_fetch(&src->frame->frame_refs[src->slot], 1, __ATOMIC_RELAXED);
+	src->frame->refs++;
+	mem_pool_unlock();
+	return pte;
+}
+
+
+/**
+ * Ensure that the storage of the given page is not shared with another memory
+ * before writing it: if it is, the page is copied in a new storage.
+ * @param mem	Memory of the page.
+ * @param pte	Page entry.
+ * @return		1 if the page has been copied, 0 else.
+ */
+static int mem_unshare_page(memory_64_t *mem, memory_page_table_entry_t *pte) {
+	memory_page_table_entry_t old;
+	if(__atomic_load_n(&pte->frame->frame_refs[pte->slot], __ATOMIC_ACQUIRE) == 1)
+		return 0;
+
+	/* copy in a new storage */
+	old = *pte;
+	mem_pool_lock();
+	mem_alloc_storage(mem, pte);
+	memcpy(pte->storage, old.storage, MEMORY_PAGE_SIZE);
+	mem_unref_storage(&old);
+	mem_pool_stats.copied_pages++;
+	mem_pool_unlock();
+	return 1;
+}
+
+
+/**
+ * Release the pages of the given memory.
+ * @param mem	Memory to work on.
+ */
+static void mem_free_pages(memory_64_t *mem) {
+	memory_chunk_t *chunk, *next;
+	memory_pte_block_t *block;
+	int i;
+	mem_pool_lock();
+
+	/* release the references to the storage pages */
+	for(block = mem->ptes; block != NULL; block = block->next)
+		for(i = 0; i < block->used; i++)
+			if(block->entries[i].storage != NULL)
+				mem_unref_storage(&block->entries[i]);
+
+	/* release the chunks (unless their storage is used by another memory) */
+	for(chunk = mem->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		if(--chunk->refs == 0)
+			mem_release_chunk(chunk);
+	}
+	mem->chunks = NULL;
+	mem_pool_unlock();
+
+	/* release the page descriptors */
+	while(mem->ptes != NULL) {
+		block = mem->ptes;
+		mem->ptes = block->next;
+		free(block);
+	}
+}
+
+
+/**
+ * Get the statistics of the page pool (shared by all memories).
+ * @param stats	Filled with the statistics.
+ * @ingroup memory
+ */
+void gliss_mem_pool_stats(gliss_mem_pool_stats_t *stats) {
+	mem_pool_lock();
+	*stats = mem_pool_stats;
+	mem_pool_unlock();
+}
+
+
+/**
+ * Give back the free chunks of the page pool to the system.
+ * @ingroup memory
+ */
+void gliss_mem_pool_release(void) {
+	mem_pool_lock();
+	while(mem_free_chunks != NULL) {
+		memory_chunk_t *chunk = mem_free_chunks;
+		mem_free_chunks = chunk->next;
+		free(chunk->block);
+		free(chunk);
+	}
+	mem_pool_stats.free_chunks = 0;
+	mem_pool_unlock();
+}
+
 
 /**
  * Compute hash level 1.
@@ -184,6 +550,42 @@ static uint32_t mem_hash2(gliss_address_t addr)  {
 }
 
 
+/**
+ * Invalidate the TLB entries of the given page.
+ * @param mem	Memory to work on.
+ * @param addr	Address of the page.
+ */
+static void mem_tlb_invalidate(memory_64_t *mem, gliss_address_t addr) {
+	uint32_t i = FMOD(addr / MEMORY_PAGE_SIZE, MEMORY_TLB_SIZE);
+	mem->read_tlb[i].tag = MEMORY_TLB_INVALID;
+	mem->write_tlb[i].tag = MEMORY_TLB_INVALID;
+}
+
+
+/**
+ * Invalidate the whole TLB.
+ * @param mem	Memory to work on.
+ */
+static void mem_tlb_flush(memory_64_t *mem) {
+	int i;
+	for(i = 0; i < MEMORY_TLB_SIZE; i++) {
+		mem->read_tlb[i].tag = MEMORY_TLB_INVALID;
+		mem->write_tlb[i].tag = MEMORY_TLB_INVALID;
+	}
+}
+
+
+/**
+ * Invalidate the write TLB (its pages become shared after a copy).
+ * @param mem	Memory to work on.
+ */
+static void mem_tlb_flush_write(memory_64_t *mem) {
+	int i;
+	for(i = 0; i < MEMORY_TLB_SIZE; i++)
+		mem->write_tlb[i].tag = MEMORY_TLB_INVALID;
+}
+
+
 /**
  * Build a new memory handler.
  * @return	Memory handler or NULL if there is not enough memory.
@@ -195,6 +597,14 @@ gliss_memory_t *gliss_mem_new(void) {
     if (mem!=NULL){
         memset(mem->primary_hash_table,0,sizeof(mem->primary_hash_table));
         mem->image_link = NULL;
+        mem->chunks = NULL;
+        mem->ptes = NULL;
+        mem->watch_stamp = 0;
+        mem->watchers = NULL;
+        mem->unborn = NULL;
+        mem->unborn_cnt = 0;
+        mem->unborn_max = 0;
+        mem_tlb_flush(mem);
     }
     return (gliss_memory_t *)mem;
 }
@@ -206,35 +616,57 @@ gliss_memory_t *gliss_mem_new(void) {
  * @ingroup memory
  */
 void gliss_mem_delete(gliss_memory_t *memory) {
-	int i,j;
+	int i;
 	secondary_memory_hash_table_t *secondary_hash_table;
-	memory_page_table_entry_t *pte;
-	memory_page_table_entry_t *nextpte;
 
 	/* get right type */
 	memory_64_t *mem64 = (memory_64_t *)memory;
 
 	for (i=0; i<PRIMARYMEMORY_HASH_TABLE_SIZE;i++)  {
 		secondary_hash_table = mem64->primary_hash_table[i];
-		if(secondary_hash_table) {
-			for(j=0;j<SECONDARYMEMORY_HASH_TABLE_SIZE;j++) {
-				pte=secondary_hash_table->pte[j];
-				while (pte) {
-					nextpte=pte->next;
-					free(pte->storage);
-					free(pte);	/* freeing each page */
-					pte=nextpte;
-				}
-			}
+		if(secondary_hash_table)
 			free(secondary_hash_table); /* freeing each secondary hash table */
-		}
 	}
+	mem_free_pages(mem64);	/* freeing the pages */
+	while(mem64->watchers != NULL) {
+		memory_watcher_t *w = mem64->watchers;
+		mem64->watchers = w->next;
+		free(w);
+	}
+	free(mem64->unborn);
 	free(mem64); /* freeing the primary hash table */
 }
 
 
 /**
- * Copy the current memory.
+ * Get the size of host memory allocated to the target memory
+ * (page chunks and hash tables).
+ * @param memory	Memory to look at.
+ * @return			Allocated size in bytes.
+ * @ingroup memory
+ */
+size_t gliss_mem_resident(gliss_memory_t *memory) {
+	int i;
+	memory_64_t *mem = memory;
+	memory_chunk_t *chunk;
+	memory_pte_block_t *block;
+	size_t size = sizeof(memory_64_t);
+
+	for(i = 0; i < PRIMARYMEMORY_HASH_TABLE_SIZE; i++)
+		if(mem->primary_hash_table[i])
+			size += sizeof(secondary_memory_hash_table_t);
+	for(chunk = mem->chunks; chunk != NULL; chunk = chunk->next)
+		size += sizeof(memory_chunk_t) + (MEMORY_CHUNK_PAGES + 1) * MEMORY_PAGE_SIZE;
+	for(block = mem->ptes; block != NULL; block = block->next)
+		size += sizeof(memory_pte_block_t);
+	return size;
+}
+
+
+/**
+ * Copy the current memory. The copy is lazy: both memories share the page
+ * storages that are only copied at their first write by one of them
+ * (copy-on-write). The memories can be deleted in any order.
  * @param memory	Memory to copy.
  * @return			Copied meory or null if there is not enough memory.
  * @ingroup memory
@@ -248,24 +680,180 @@ gliss_memory_t *gliss_mem_copy(gliss_memory_t *memory) {
 	if(target == NULL)
 		return NULL;
 
-	/* copy memory */
+	/* share the pages */
 	for(i=0;i<PRIMARYMEMORY_HASH_TABLE_SIZE;i++) {
 		secondary_memory_hash_table_t *secondary_hash_table = mem->primary_hash_table[i];
 		if(secondary_hash_table) {
+			secondary_memory_hash_table_t *target_table = (secondary_memory_hash_table_t *)
+				calloc(sizeof(secondary_memory_hash_table_t), 1);
+			assertp(target_table != NULL, "Failed to allocate memory in gliss_mem_copy\n");
+			target->primary_hash_table[i] = target_table;
 			for(j=0;j<SECONDARYMEMORY_HASH_TABLE_SIZE;j++) {
-				memory_page_table_entry_t *pte=secondary_hash_table->pte[i];
-				if(pte) {
-					do {
-						gliss_mem_write(target, pte->addr, pte->storage, MEMORY_PAGE_SIZE);
-					} while((pte=pte->next) != 0);
+				memory_page_table_entry_t *pte=secondary_hash_table->pte[j];
+				for(; pte != NULL; pte = pte->next) {
+					memory_page_table_entry_t *copy = mem_share_page(target, pte);
+					copy->next = target_table->pte[j];
+					target_table->pte[j] = copy;
 				}
 			}
 		}
 	}
+
+	/* source pages are now shared: next writes must unshare them
+	   (under the lock as several threads may copy the same memory) */
+	mem_pool_lock();
+	mem_tlb_flush_write(mem);
+	mem_pool_unlock();
 	return target;
 }
 
 
+/**
+ * Write a page record of a memory checkpoint.
+ * @param out		Stream to write to.
+ * @param addr		Address of the page.
+ * @param buf		Page content (in target byte order).
+ * @param size		Page size.
+ * @return			0 for success, -1 for error.
+ */
+static int mem_save_record(FILE *out, uint64_t addr, const void *buf, uint32_t size) {
+	if(fwrite(&addr, sizeof(addr), 1, out) != 1
+	|| fwrite(&size, sizeof(size), 1, out) != 1
+	|| (size != 0 && fwrite(buf, size, 1, out) != 1))
+		return -1;
+	return 0;
+}
+
+
+/**
+ * Test if a page is only made of zeroes (such pages are not saved).
+ * @param buf	Page content.
+ * @param size	Page size (multiple of 8).
+ * @return		Non-zero if the page is null.
+ */
+static int mem_is_null(const void *buf, size_t size) {
+	const uint64_t *p = (const uint64_t *)buf;
+	size_t i;
+	for(i = 0; i < size / sizeof(uint64_t); i++)
+		if(p[i] != 0)
+			return 0;
+	return 1;
+}
+
+
+/**
+ * Save the non-null pages of the memory (used for checkpoints).
+ * The pages are stored as a sequence of records (address, size, content)
+ * ended by a record of null size and null address
+ * (a record of null size and non-null address is a padding of address bytes).
+ * @param memory	Memory to save.
+ * @param out		Stream to write to.
+ * @return			0 for success, -1 for error.
+ * @ingroup memory
+ */
+int gliss_mem_save(gliss_memory_t *memory, FILE *out) {
+	int i, j;
+	memory_64_t *mem = memory;
+	memory_page_table_entry_t *pte;
+
+	for(i = 0; i < PRIMARYMEMORY_HASH_TABLE_SIZE; i++)
+		if(mem->primary_hash_table[i] != NULL)
+			for(j = 0; j < SECONDARYMEMORY_HASH_TABLE_SIZE; j++)
+				for(pte = mem->primary_hash_table[i]->pte[j]; pte != NULL; pte = pte->next)
+					if(!mem_is_null(pte->storage, MEMORY_PAGE_SIZE)
+					&& mem_save_record(out, pte->addr, pte->storage, MEMORY_PAGE_SIZE) != 0)
+						return -1;
+	return mem_save_record(out, 0, NULL, 0);
+}
+
+
+/**
+ * Save the pages written since the last call to gliss_mem_clear_dirty()
+ * (or since the creation of the memory), null or not, in the same format
+ * as gliss_mem_save(): restored over the memory saved before, they give
+ * the current content (incremental checkpoints).
+ * @param memory	Memory to save.
+ * @param out		Stream to write to.
+ * @return			0 for success, -1 for error.
+ * @ingroup memory
+ */
+int gliss_mem_save_dirty(gliss_memory_t *memory, FILE *out) {
+	int i, j;
+	memory_64_t *mem = memory;
+	memory_page_table_entry_t *pte;
+
+	for(i = 0; i < PRIMARYMEMORY_HASH_TABLE_SIZE; i++)
+		if(mem->primary_hash_table[i] != NULL)
+			for(j = 0; j < SECONDARYMEMORY_HASH_TABLE_SIZE; j++)
+				for(pte = mem->primary_hash_table[i]->pte[j]; pte != NULL; pte = pte->next)
+					if(pte->dirty
+					&& mem_save_record(out, pte->addr, pte->storage, MEMORY_PAGE_SIZE) != 0)
+						return -1;
+	return mem_save_record(out, 0, NULL, 0);
+}
+
+
+/**
+ * Start a new dirty period: the pages are marked as not written.
+ * The write TLB is emptied so that the next write to a page marks it again.
+ * @param memory	Memory to work on.
+ * @ingroup memory
+ */
+void gliss_mem_clear_dirty(gliss_memory_t *memory) {
+	memory_64_t *mem = memory;
+	memory_pte_block_t *block;
+	int i;
+
+	for(block = mem->ptes; block != NULL; block = block->next)
+		for(i = 0; i < block->used; i++)
+			block->entries[i].dirty = 0;
+	mem_tlb_flush_write(mem);
+}
+
+
+/**
+ * Restore the pages saved by gliss_mem_save() (possibly by another memory module).
+ * The pages are written over the current content of the memory.
+ * @param memory	Memory to restore to.
+ * @param in		Stream to read from.
+ * @return			0 for success, -1 for error (truncated or invalid stream).
+ * @ingroup memory
+ */
+int gliss_mem_restore(gliss_memory_t *memory, FILE *in) {
+	uint64_t addr;
+	uint32_t size;
+	uint8_t *buf = NULL;
+	uint32_t buf_size = 0;
+
+	while(1) {
+		if(fread(&addr, sizeof(addr), 1, in) != 1
+		|| fread(&size, sizeof(size), 1, in) != 1)
+			break;
+		if(size == 0 && addr == 0) {
+			free(buf);
+			return 0;
+		}
+		if(size == 0) {
+			if(fseek(in, addr, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+		if(size > buf_size) {
+			uint8_t *nbuf = (uint8_t *)realloc(buf, size);
+			if(nbuf == NULL)
+				break;
+			buf = nbuf;
+			buf_size = size;
+		}
+		if(fread(buf, size, 1, in) != 1)
+			break;
+		gliss_mem_write(memory, (gliss_address_t)addr, buf, size);
+	}
+	free(buf);
+	return -1;
+}
+
+
 /**
  * Look for a page in memory.
  * @param mem	Memory to work on.
@@ -332,6 +920,24 @@ static secondary_memory_hash_table_t* mem_get_secondary_hash_table(
 }
 
 
+/**
+ * Test if a page was watched before being allocated and, if so, remove
+ * it from the watched pages not allocated yet.
+ * @param mem	Memory to work on.
+ * @param addr	Page address.
+ * @return		1 if the page was watched, 0 else.
+ */
+static int mem_take_unborn(memory_64_t *mem, gliss_address_t addr) {
+	int i;
+	for(i = 0; i < mem->unborn_cnt; i++)
+		if(mem->unborn[i] == addr) {
+			mem->unborn[i] = mem->unborn[--mem->unborn_cnt];
+			return 1;
+		}
+	return 0;
+}
+
+
 /**
  * Get the page matching the given address and create it if it does not exist.
  * @parm mem	Memory to work on.
@@ -352,27 +958,192 @@ static memory_page_table_entry_t *mem_get_page(memory_64_t *mem, gliss_address_t
 		secondary_hash_table = mem_get_secondary_hash_table(mem, addr);
 		h2 = mem_hash2(addr);
 
-		/* allocation of the page entry descriptor */
-		pte = (memory_page_table_entry_t *)malloc(sizeof(memory_page_table_entry_t));
-		assertp(pte != NULL, "Failed to allocate memory in mem_get_page\n");
+		/* allocation of the page (from the pool) */
+		pte = mem_alloc_page(mem);
 		pte->addr = addr;
 
-		/* allocation of the page */
-#		ifndef GLISS_NO_PAGE_INIT
-			pte->storage = (uint8_t *)calloc(MEMORY_PAGE_SIZE,1);
-#		else
-			pte->storage = (uint8_t *)malloc(MEMORY_PAGE_SIZE);
-#		endif
-		assertp(pte->storage != NULL, "Failed to allocate memory in mem_get_page\n");
-
 		/* adding the memory page to the list of memory page size entry*/
 		pte->next = secondary_hash_table->pte[h2];
 		secondary_hash_table->pte[h2]=pte;
+		mem_tlb_invalidate(mem, addr);
+
+		/* watched before being allocated? */
+		if(mem->unborn_cnt != 0)
+			pte->watched = mem_take_unborn(mem, addr);
+	}
+	return pte;
+}
+
+
+/**
+ * Get the page matching the given address for writing: the page is created
+ * if it does not exist and copied if it is shared with another memory.
+ * @param mem	Memory to work on.
+ * @param addr	Address of the page.
+ */
+static memory_page_table_entry_t *mem_get_writable_page(memory_64_t *mem, gliss_address_t addr) {
+	memory_page_table_entry_t *pte = mem_get_page(mem, addr);
+	if(mem_unshare_page(mem, pte))
+		mem_tlb_invalidate(mem, pte->addr);
+	pte->dirty = 1;
+	if(pte->watched) {
+		memory_watcher_t *w;
+		pte->watched = 0;
+		mem->watch_stamp++;
+		for(w = mem->watchers; w != NULL; w = w->next)
+			w->fun(mem, pte->addr, MEMORY_PAGE_SIZE, w->data);
 	}
 	return pte;
 }
 
 
+/**
+ * Watch the writes to the page containing the given address: the next
+ * write to this page increments the watch stamp of the memory, calls
+ * the watchers with the page and ends the watch. This lets a user keeping
+ * copies or decoded forms of the memory content (like the fetch window
+ * of CISC instructions or the decode caches) detect that they may be
+ * out of date. The watched pages are kept out of the write TLB so that
+ * the watch costs nothing to the other writes. A page that has never been
+ * written is not allocated: it is only recorded and becomes watched when
+ * its first write allocates it.
+ * @param memory	Memory to work on.
+ * @param address	Address in the watched page.
+ * @ingroup memory
+ */
+void gliss_mem_watch(gliss_memory_t *memory, gliss_address_t address) {
+	memory_64_t *mem = (memory_64_t *)memory;
+	memory_page_table_entry_t *pte = mem_search_page(mem, address);
+
+	/* page not allocated: record it */
+	if(pte == NULL) {
+		gliss_address_t addr = address - (address % MEMORY_PAGE_SIZE);
+		int i;
+		for(i = 0; i < mem->unborn_cnt; i++)
+			if(mem->unborn[i] == addr)
+				return;
+		if(mem->unborn_cnt == mem->unborn_max) {
+			int max = mem->unborn_max ? mem->unborn_max * 2 : 16;
+			gliss_address_t *n = (gliss_address_t *)realloc(mem->unborn, max * sizeof(gliss_address_t));
+			assertp(n != NULL, "Failed to allocate memory in gliss_mem_watch\n");
+			mem->unborn = n;
+			mem->unborn_max = max;
+		}
+		mem->unborn[mem->unborn_cnt++] = addr;
+		return;
+	}
+
+	if(!pte->watched) {
+		pte->watched = 1;
+		mem->write_tlb[FMOD(pte->addr / MEMORY_PAGE_SIZE, MEMORY_TLB_SIZE)].tag = MEMORY_TLB_INVALID;
+	}
+}
+
+
+/**
+ * Get the watch stamp of the memory, incremented at each first write
+ * to a page watched by gliss_mem_watch().
+ * @param memory	Memory to work on.
+ * @return			Current watch stamp.
+ * @ingroup memory
+ */
+uint32_t gliss_mem_watch_stamp(gliss_memory_t *memory) {
+	return ((memory_64_t *)memory)->watch_stamp;
+}
+
+
+/**
+ * Add a function called at the first write to a page watched by
+ * gliss_mem_watch(), with the address and the size of the page.
+ * The function is called before the write is performed.
+ * @param memory	Memory to work on.
+ * @param fun		Called function.
+ * @param data		Data passed to the function.
+ * @ingroup memory
+ */
+void gliss_mem_add_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data) {
+	memory_64_t *mem = (memory_64_t *)memory;
+	memory_watcher_t *w = (memory_watcher_t *)malloc(sizeof(memory_watcher_t));
+	assertp(w != NULL, "Failed to allocate memory in gliss_mem_add_watcher\n");
+	w->fun = fun;
+	w->data = data;
+	w->next = mem->watchers;
+	mem->watchers = w;
+}
+
+
+/**
+ * Remove a function added by gliss_mem_add_watcher().
+ * @param memory	Memory to work on.
+ * @param fun		Removed function.
+ * @param data		Data passed to the function.
+ * @ingroup memory
+ */
+void gliss_mem_remove_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data) {
+	memory_64_t *mem = (memory_64_t *)memory;
+	memory_watcher_t **p;
+	for(p = &mem->watchers; *p != NULL; p = &(*p)->next)
+		if((*p)->fun == fun && (*p)->data == data) {
+			memory_watcher_t *w = *p;
+			*p = w->next;
+			free(w);
+			return;
+		}
+}
+
+
+/* shared page read for the pages never written */
+static uint64_t mem_zero_page[MEMORY_PAGE_SIZE / sizeof(uint64_t)];
+
+
+/**
+ * Get the storage of a page for reading without creating it.
+ * @param mem	Memory to work on.
+ * @param addr	Address in the page.
+ * @return		Page storage or the zero page if the page does not exist.
+ */
+static uint8_t *mem_find_storage(memory_64_t *mem, gliss_address_t addr) {
+	memory_page_table_entry_t *pte = mem_search_page(mem, addr);
+	return pte != NULL ? pte->storage : (uint8_t *)mem_zero_page;
+}
+
+
+/**
+ * Get the storage of the page containing the given address for reading,
+ * looking first in the read TLB.
+ * @param mem	Memory to work on.
+ * @param addr	Accessed address.
+ * @return		Page storage (possibly the zero page).
+ */
+static inline uint8_t *mem_read_page(memory_64_t *mem, gliss_address_t addr) {
+	gliss_address_t page = addr - FMOD(addr, MEMORY_PAGE_SIZE);
+	memory_tlb_entry_t *e = &mem->read_tlb[FMOD(addr / MEMORY_PAGE_SIZE, MEMORY_TLB_SIZE)];
+	if(e->tag != page) {
+		e->storage = mem_find_storage(mem, page);
+		e->tag = page;
+	}
+	return e->storage;
+}
+
+
+/**
+ * Get the storage of the page containing the given address for writing,
+ * looking first in the write TLB.
+ * @param mem	Memory to work on.
+ * @param addr	Accessed address.
+ * @return		Page storage.
+ */
+static inline uint8_t *mem_write_page(memory_64_t *mem, gliss_address_t addr) {
+	gliss_address_t page = addr - FMOD(addr, MEMORY_PAGE_SIZE);
+	memory_tlb_entry_t *e = &mem->write_tlb[FMOD(addr / MEMORY_PAGE_SIZE, MEMORY_TLB_SIZE)];
+	if(e->tag != page) {
+		e->storage = mem_get_writable_page(mem, page)->storage;
+		e->tag = page;
+	}
+	return e->storage;
+}
+
+
 /**
  * Write a buffer into memory.
  * @param memory	Memory to write into.
@@ -385,7 +1156,7 @@ void gliss_mem_write(gliss_memory_t *memory, gliss_address_t address, void *buff
 	if(size>0) {
 		memory_64_t *mem = (memory_64_t *)memory;
 		uint32_t offset = address % MEMORY_PAGE_SIZE;
-		memory_page_table_entry_t *pte = mem_get_page(mem, address);
+		memory_page_table_entry_t *pte = mem_get_writable_page(mem, address);
         uint32_t sz = MEMORY_PAGE_SIZE - offset;
         if(size > sz) {
 			memcpy(pte->storage+offset, buffer, sz);
@@ -394,7 +1165,7 @@ void gliss_mem_write(gliss_memory_t *memory, gliss_address_t address, void *buff
 			buffer = (uint8_t *)buffer + sz;
 			if(size>=MEMORY_PAGE_SIZE) {
 				do {
-					pte = mem_get_page(mem, address);
+					pte = mem_get_writable_page(mem, address);
 					memcpy(pte->storage, buffer, MEMORY_PAGE_SIZE);
 					size -= MEMORY_PAGE_SIZE;
 					address += MEMORY_PAGE_SIZE;
@@ -402,7 +1173,7 @@ void gliss_mem_write(gliss_memory_t *memory, gliss_address_t address, void *buff
 				} while(size >= MEMORY_PAGE_SIZE);
 			}
 			if(size > 0) {
-				pte=mem_get_page(mem, address);
+				pte=mem_get_writable_page(mem, address);
 				memcpy(pte->storage, buffer, size);
 			}
         }
@@ -424,29 +1195,29 @@ void gliss_mem_read(gliss_memory_t *memory, gliss_address_t address, void *buffe
 	if(size > 0) {
 		memory_64_t *mem = (memory_64_t *) memory;
 		uint32_t offset = address % MEMORY_PAGE_SIZE;
-		memory_page_table_entry_t *pte = mem_get_page(mem, address);
+		uint8_t *storage = mem_find_storage(mem, address);
 		uint32_t sz = MEMORY_PAGE_SIZE - offset;
 		if(size > sz) {
-			memcpy(buffer, pte->storage + offset, sz);
+			memcpy(buffer, storage + offset, sz);
 			size -= sz;
             address += sz;
 			buffer = (uint8_t *)buffer + sz;
 			if(size >= MEMORY_PAGE_SIZE) {
 				do {
-					pte = mem_get_page(mem, address);
-					memcpy(buffer, pte->storage, MEMORY_PAGE_SIZE);
+					storage = mem_find_storage(mem, address);
+					memcpy(buffer, storage, MEMORY_PAGE_SIZE);
 					size -= MEMORY_PAGE_SIZE;
 					address += MEMORY_PAGE_SIZE;
 					buffer = (uint8_t *)buffer + MEMORY_PAGE_SIZE;
 				} while(size >= MEMORY_PAGE_SIZE);
 			}
 			if(size>0) {
-				pte = mem_get_page(mem, address);
-				memcpy(buffer, pte->storage, size);
+				storage = mem_find_storage(mem, address);
+				memcpy(buffer, storage, size);
 			}
 		}
 		else
-			memcpy(buffer, pte->storage + offset, size);
+			memcpy(buffer, storage + offset, size);
     }
 }
 
@@ -460,9 +1231,8 @@ void gliss_mem_read(gliss_memory_t *memory, gliss_address_t address, void *buffe
  */
 uint8_t gliss_mem_read8(gliss_memory_t *memory, gliss_address_t address) {
 	memory_64_t *mem = (memory_64_t *)memory;
-	gliss_address_t offset = address % MEMORY_PAGE_SIZE;
-	memory_page_table_entry_t *pte = mem_get_page(mem, address);
-	return pte->storage[offset];
+	gliss_address_t offset = FMOD(address, MEMORY_PAGE_SIZE);
+	return mem_read_page(mem, address)[offset];
 }
 
 
@@ -484,8 +1254,7 @@ uint16_t gliss_mem_read16(gliss_memory_t *memory, gliss_address_t address) {
 
 	/* get page */
     gliss_address_t offset = FMOD(address, MEMORY_PAGE_SIZE);
-    memory_page_table_entry_t *pte = mem_get_page(memory, address);
-    uint8_t* p = pte->storage + offset;
+    uint8_t* p = mem_read_page(memory, address) + offset;
 
 	/* read the bytes */
 	if(!((offset & (sizeof(T)-1)) | ((offset + (sizeof(T)-1)) & MEMORY_PAGE_SIZE)))
@@ -522,8 +1291,7 @@ uint32_t gliss_mem_read32(gliss_memory_t *memory, gliss_address_t address) {
 
 	/* get page */
     gliss_address_t offset = FMOD(address, MEMORY_PAGE_SIZE);
-    memory_page_table_entry_t *pte = mem_get_page(memory, address);
-    uint8_t* p = pte->storage + offset;
+    uint8_t* p = mem_read_page(memory, address) + offset;
 
 	/* read the bytes */
 	if(!((offset & (sizeof(T)-1)) | ((offset + (sizeof(T)-1)) & MEMORY_PAGE_SIZE)))
@@ -560,8 +1328,7 @@ uint64_t gliss_mem_read64(gliss_memory_t *memory, gliss_address_t address) {
 
 	/* get page */
     gliss_address_t offset = FMOD(address, MEMORY_PAGE_SIZE);
-    memory_page_table_entry_t *pte = mem_get_page(memory, address);
-    uint8_t* p = pte->storage + offset;
+    uint8_t* p = mem_read_page(memory, address) + offset;
 
 	/* read the bytes */
 	if(!((offset & (sizeof(T)-1)) | ((offset + (sizeof(T)-1)) & MEMORY_PAGE_SIZE)))
@@ -636,11 +1403,8 @@ long double gliss_mem_readld(gliss_memory_t *memory, gliss_address_t address) {
  */
 void gliss_mem_write8(gliss_memory_t *memory, gliss_address_t address, uint8_t val) {
 	memory_64_t *mem = (memory_64_t *)memory;
-	gliss_address_t offset;
-	memory_page_table_entry_t *pte;
-	offset = address % MEMORY_PAGE_SIZE;
-	pte = mem_get_page(mem, address);
-	pte->storage[offset] = val;
+	gliss_address_t offset = FMOD(address, MEMORY_PAGE_SIZE);
+	mem_write_page(mem, address)[offset] = val;
 }
 
 
@@ -661,10 +1425,8 @@ void gliss_mem_write16(gliss_memory_t *memory, gliss_address_t address, uint16_t
 	uint16_t *q;
 
 	/* compute address */
-	memory_page_table_entry_t *pte;
-	offset = address % MEMORY_PAGE_SIZE;
-	pte = mem_get_page(mem, address);
-	q = (uint16_t *)(pte->storage + offset);
+	offset = FMOD(address, MEMORY_PAGE_SIZE);
+	q = (uint16_t *)(mem_write_page(mem, address) + offset);
 
 	/* invert ? */
 #	if HOST_ENDIANNESS != TARGET_ENDIANNESS
@@ -675,11 +1437,13 @@ void gliss_mem_write16(gliss_memory_t *memory, gliss_address_t address, uint16_t
 	}
 #	endif
 
-	/* aligned ? */
+	/* aligned or inter-page ? */
 	if((address & 0x00000001) == 0)
 		*q = p->half;
-	else
+	else if(offset + 2 <= MEMORY_PAGE_SIZE)
 		memcpy(q, p->bytes, 2);
+	else
+		gliss_mem_write(memory, address, p->bytes, 2);
 }
 
 
@@ -700,10 +1464,8 @@ void gliss_mem_write32(gliss_memory_t *memory, gliss_address_t address, uint32_t
 	uint32_t *q;
 
 	/* compute address */
-	memory_page_table_entry_t *pte;
-	offset = address % MEMORY_PAGE_SIZE;
-	pte = mem_get_page(mem, address);
-	q = (uint32_t *)(pte->storage + offset);
+	offset = FMOD(address, MEMORY_PAGE_SIZE);
+	q = (uint32_t *)(mem_write_page(mem, address) + offset);
 
 	/* invert ? */
 #	if HOST_ENDIANNESS != TARGET_ENDIANNESS
@@ -717,11 +1479,13 @@ void gliss_mem_write32(gliss_memory_t *memory, gliss_address_t address, uint32_t
 	}
 #	endif
 
-	/* aligned ? */
+	/* aligned or inter-page ? */
 	if((address & 0x00000003) == 0)
 		*q = p->word;
-	else
+	else if(offset + 4 <= MEMORY_PAGE_SIZE)
 		memcpy(q, p->bytes, 4);
+	else
+		gliss_mem_write(memory, address, p->bytes, 4);
 }
 
 
@@ -742,10 +1506,8 @@ void gliss_mem_write64(gliss_memory_t *memory, gliss_address_t address, uint64_t
 	uint64_t *q;
 
 	/* compute address */
-	memory_page_table_entry_t *pte;
-	offset = address % MEMORY_PAGE_SIZE;
-	pte = mem_get_page(mem, address);
-	q = (uint64_t *)(pte->storage + offset);
+	offset = FMOD(address, MEMORY_PAGE_SIZE);
+	q = (uint64_t *)(mem_write_page(mem, address) + offset);
 
 	/* invert ? */
 #	if HOST_ENDIANNESS != TARGET_ENDIANNESS
@@ -765,11 +1527,13 @@ void gliss_mem_write64(gliss_memory_t *memory, gliss_address_t address, uint64_t
 	}
 #	endif
 
-	/* aligned ? */
+	/* aligned or inter-page ? */
 	if((address & 0x00000007) == 0)
 		*q = p->dword;
-	else
+	else if(offset + 8 <= MEMORY_PAGE_SIZE)
 		memcpy(q, p->bytes, 8);
+	else
+		gliss_mem_write(memory, address, p->bytes, 8);
 }
 
 
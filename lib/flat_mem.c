@@ -0,0 +1,1008 @@
+/*
+ *	flat_mem module implementation
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2008, IRIT UPS.
+ *
+ *	GLISS is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	GLISS is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// swap commands
+#if defined(__APPLE__)
+#	include <libkern/OSByteOrder.h>
+#	define bswap_16(x) OSSwapInt16(x)
+#	define bswap_32(x) OSSwapInt32(x)
+#	define bswap_64(x) OSSwapInt64(x)
+#else
+#	include <byteswap.h>
+#endif
+
+/**
+ * @page flat_mem	flat_mem module
+ *
+ * This memory module is dedicated to 32-bit targets simulated on a 64-bit host.
+ * The whole 4 GiB memory space of the target is reserved at once in the
+ * host address space (without reserving swap space) and the host kernel
+ * allocates the pages lazily, filled with zeroes, at their first access.
+ * Hence, each access is just an access to base + address, without any
+ * lookup in a page table.
+ *
+ * As for the fast_mem module, the memory contains the bytes in the target
+ * order and values are swapped at access time if the endianness of the host
+ * and of the target differ.
+ *
+ * The function gliss_mem_resident() returns the size of host memory really
+ * allocated to the target memory.
+ *
+ * To copy a memory without scanning the whole space, the writes mark the
+ * chunk of FLAT_MEM_CHUNK bytes they are performed in. They also mark their
+ * page of FLAT_MEM_WATCH bytes as dirty until the next call to
+ * gliss_mem_clear_dirty() so that incremental checkpoints only save the pages
+ * written since the previous one.
+ */
+
+#define little	0
+#define big		1
+#include <gliss/config.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <gliss/mem.h>
+
+//#define GLISS_MEM_SPY		// define it to get memory action spy feature
+
+#ifndef NDEBUG
+#	define assertp(c, m)	\
+		if(!(c)) { \
+			fprintf(stderr, "assertiion failure %s:%d: %s", __FILE__, __LINE__, m); \
+			abort(); }
+#else
+#	define assertp(c, m)
+#endif
+
+#ifndef TARGET_ENDIANNESS
+#	error "TARGET_ENDIANNESS must be defined !"
+#endif
+
+#ifndef HOST_ENDIANNESS
+#	error "HOST_ENDIANNESS must be defined !"
+#endif
+
+#ifndef MAP_NORESERVE
+#	define MAP_NORESERVE 0
+#endif
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#	define MAP_ANONYMOUS MAP_ANON
+#endif
+
+
+/* size of the target memory space */
+#define FLAT_MEM_SIZE	((size_t)1 << 32)
+/* size of the host reservation */
+#define FLAT_MEM_MAP	FLAT_MEM_SIZE
+/* test if an access overlaps the end of the memory */
+#define WRAPS(a, n)		((size_t)(a) > FLAT_MEM_SIZE - (n))
+/* written chunks */
+#define FLAT_MEM_CHUNK_BITS	16
+#define FLAT_MEM_CHUNK		(1 << FLAT_MEM_CHUNK_BITS)
+#define FLAT_MEM_CHUNKS		(FLAT_MEM_SIZE >> FLAT_MEM_CHUNK_BITS)
+#define MARK(m, a)			((m)->written[(gliss_address_t)(a) >> FLAT_MEM_CHUNK_BITS] = (m)->dirty[WPAGE(a)] = 1)
+/* watched and dirty pages */
+#define FLAT_MEM_WATCH_BITS	12
+#define FLAT_MEM_WATCH		(1 << FLAT_MEM_WATCH_BITS)
+#define FLAT_MEM_WATCHES	(FLAT_MEM_SIZE >> FLAT_MEM_WATCH_BITS)
+#define WPAGE(a)			((gliss_address_t)(a) >> FLAT_MEM_WATCH_BITS)
+#define WATCH(m, a, n)		if((m)->watched != NULL && ((m)->watched[WPAGE(a)] | (m)->watched[WPAGE((a) + (n) - 1)])) \
+								mem_watched_write(m, a, n)
+/* checkpoint records */
+#define FLAT_MEM_RECORD		(sizeof(uint64_t) + sizeof(uint32_t))
+#define FLAT_MEM_RUN		((size_t)1 << 30)
+
+struct gliss_memory_t {
+	void* image_link; /* link to a generic image data resource of the memory
+	                     it permits to fetch informations about image structure
+	                     via an optionnal external system */
+	uint8_t *base;				/* base of the target memory in the host */
+	uint8_t written[FLAT_MEM_CHUNKS];	/* written chunks */
+	uint8_t *dirty;				/* pages written since gliss_mem_clear_dirty() */
+	uint8_t *watched;			/* watched pages (allocated at the first watch) */
+	uint32_t watch_stamp;		/* count of writes to watched pages */
+	struct memory_watcher_t *watchers;	/* functions called on these writes */
+#ifdef GLISS_MEM_SPY
+	gliss_mem_spy_t spy_fun;	/** spy function */
+	void *spy_data;				/** spy data */
+#endif
+};
+
+
+/* function called at the first write to a watched page */
+typedef struct memory_watcher_t {
+	struct memory_watcher_t *next;
+	gliss_mem_watcher_t fun;
+	void *data;
+} memory_watcher_t;
+
+
+#ifdef GLISS_MEM_SPY
+/**
+ * Default spy function: do nothing.
+ */
+static void gliss_mem_default_spy(gliss_memory_t *mem, gliss_address_t addr, gliss_size_t size, gliss_access_t access, void *data) {
+}
+#endif
+
+
+/**
+ * Build a new memory handler.
+ * @return	Memory handler or NULL if there is not enough memory
+ * 			(or no enough host address space).
+ * @ingroup memory
+ */
+gliss_memory_t *gliss_mem_new(void) {
+	gliss_memory_t *mem;
+
+	/* allocate the handler */
+	mem = (gliss_memory_t *)calloc(sizeof(gliss_memory_t), 1);
+	if(mem == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* reserve the memory space */
+	mem->base = (uint8_t *)mmap(NULL, FLAT_MEM_MAP, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(mem->base == (uint8_t *)MAP_FAILED) {
+		free(mem);
+		errno = ENOMEM;
+		return NULL;
+	}
+	mem->dirty = (uint8_t *)calloc(FLAT_MEM_WATCHES, 1);
+	if(mem->dirty == NULL) {
+		munmap(mem->base, FLAT_MEM_MAP);
+		free(mem);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* initialize spy */
+#	ifdef GLISS_MEM_SPY
+		mem->spy_fun = gliss_mem_default_spy;
+		mem->spy_data = 0;
+#	endif
+
+	return mem;
+}
+
+
+#ifdef GLISS_MEM_SPY
+/**
+ * Set the spy function on the given memory. This function will be called
+ * at each memory access with the details of the memory transaction.
+ * @param mem	Current memory.
+ * @param fun	Function called at each memory access.
+ * @param data	Data passed as the last argument when function fun is called.
+ */
+void gliss_mem_set_spy(gliss_memory_t *mem, gliss_mem_spy_t fun, void *data) {
+	assert(mem);
+	if(!fun) {
+		mem->spy_fun = gliss_mem_default_spy;
+		mem->spy_data = 0;
+	}
+	else {
+		mem->spy_fun = fun;
+		mem->spy_data = data;
+	}
+}
+#endif
+
+
+/**
+ * Free and delete the given memory.
+ * @param memory	Memory to delete.
+ * @ingroup memory
+ */
+void gliss_mem_delete(gliss_memory_t *memory) {
+	if(memory == NULL)
+		return;
+	munmap(memory->base, FLAT_MEM_MAP);
+	free(memory->dirty);
+	free(memory->watched);
+	while(memory->watchers != NULL) {
+		memory_watcher_t *w = memory->watchers;
+		memory->watchers = w->next;
+		free(w);
+	}
+	free(memory);
+}
+
+
+/**
+ * Called before a write on watched pages: the watch of the written pages
+ * is ended and the watchers are called.
+ * @param memory	Current memory.
+ * @param address	Written address.
+ * @param size		Written size.
+ */
+static void mem_watched_write(gliss_memory_t *memory, gliss_address_t address, size_t size) {
+	gliss_address_t p = WPAGE(address), last = WPAGE(address + size - 1);
+	while(1) {
+		if(memory->watched[p]) {
+			memory_watcher_t *w;
+			memory->watched[p] = 0;
+			memory->watch_stamp++;
+			for(w = memory->watchers; w != NULL; w = w->next)
+				w->fun(memory, p << FLAT_MEM_WATCH_BITS, FLAT_MEM_WATCH, w->data);
+		}
+		if(p == last)
+			break;
+		p = (p + 1) & (FLAT_MEM_WATCHES - 1);
+	}
+}
+
+
+/**
+ * Watch the writes to the page containing the given address: the next
+ * write to this page increments the watch stamp of the memory, calls
+ * the watchers with the page and ends the watch.
+ * @param memory	Memory to work on.
+ * @param address	Address in the watched page.
+ * @ingroup memory
+ */
+void gliss_mem_watch(gliss_memory_t *memory, gliss_address_t address) {
+	if(memory->watched == NULL) {
+		memory->watched = (uint8_t *)calloc(FLAT_MEM_WATCHES, 1);
+		assertp(memory->watched != NULL, "Failed to allocate memory in gliss_mem_watch\n");
+	}
+	memory->watched[WPAGE(address)] = 1;
+}
+
+
+/**
+ * Get the watch stamp of the memory, incremented at each first write
+ * to a page watched by gliss_mem_watch().
+ * @param memory	Memory to work on.
+ * @return			Current watch stamp.
+ * @ingroup memory
+ */
+uint32_t gliss_mem_watch_stamp(gliss_memory_t *memory) {
+	return memory->watch_stamp;
+}
+
+
+/**
+ * Add a function called at the first write to a page watched by
+ * gliss_mem_watch(), with the address and the size of the page.
+ * The function is called before the write is performed.
+ * @param memory	Memory to work on.
+ * @param fun		Called function.
+ * @param data		Data passed to the function.
+ * @ingroup memory
+ */
+void gliss_mem_add_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data) {
+	memory_watcher_t *w = (memory_watcher_t *)malloc(sizeof(memory_watcher_t));
+	assertp(w != NULL, "Failed to allocate memory in gliss_mem_add_watcher\n");
+	w->fun = fun;
+	w->data = data;
+	w->next = memory->watchers;
+	memory->watchers = w;
+}
+
+
+/**
+ * Remove a function added by gliss_mem_add_watcher().
+ * @param memory	Memory to work on.
+ * @param fun		Removed function.
+ * @param data		Data passed to the function.
+ * @ingroup memory
+ */
+void gliss_mem_remove_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data) {
+	memory_watcher_t **p;
+	for(p = &memory->watchers; *p != NULL; p = &(*p)->next)
+		if((*p)->fun == fun && (*p)->data == data) {
+			memory_watcher_t *w = *p;
+			*p = w->next;
+			free(w);
+			return;
+		}
+}
+
+
+/**
+ * Get the size of host memory really allocated to the target memory,
+ * that is, the size of the resident host pages.
+ * @param memory	Memory to look at.
+ * @return			Resident size in bytes (0 if it cannot be computed).
+ * @ingroup memory
+ */
+size_t gliss_mem_resident(gliss_memory_t *memory) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t n = FLAT_MEM_MAP / page, i, size = 0;
+	unsigned char *vec = (unsigned char *)malloc(n);
+	if(vec == NULL)
+		return 0;
+	if(mincore(memory->base, FLAT_MEM_MAP, (void *)vec) == 0)
+		for(i = 0; i < n; i++)
+			if(vec[i] & 1)
+				size += page;
+	free(vec);
+	return size;
+}
+
+
+/**
+ * Copy the current memory. Only the non-null host pages of the written
+ * chunks (and of the chunks following them) are copied.
+ * @param memory	Memory to copy.
+ * @return			Copied memory or null if there is not enough memory.
+ * @ingroup memory
+ */
+gliss_memory_t *gliss_mem_copy(gliss_memory_t *memory) {
+	size_t page = sysconf(_SC_PAGESIZE), i, off, j;
+	gliss_memory_t *target = gliss_mem_new();
+	if(target == NULL)
+		return NULL;
+
+	for(i = 0; i < FLAT_MEM_CHUNKS; i++)
+		if(memory->written[i] || (i > 0 && memory->written[i - 1])) {
+			target->written[i] = memory->written[i];
+			for(off = i << FLAT_MEM_CHUNK_BITS; off < ((i + 1) << FLAT_MEM_CHUNK_BITS); off += page) {
+				const uint64_t *p = (const uint64_t *)(memory->base + off);
+				for(j = 0; j < page / sizeof(uint64_t) && p[j] == 0; j++);
+				if(j < page / sizeof(uint64_t))
+					memcpy(target->base + off, memory->base + off, page);
+			}
+		}
+
+#	ifdef GLISS_MEM_SPY
+		target->spy_fun = memory->spy_fun;
+		target->spy_data = memory->spy_data;
+#	endif
+	return target;
+}
+
+
+/**
+ * Map a part of a file in the memory as a private copy-on-write mapping:
+ * the file pages are shared until they are written by the simulation.
+ * The address, the offset and the size must be multiple of the host page size.
+ * @param memory	Memory to map in.
+ * @param address	Target address of the mapping.
+ * @param fd		File descriptor (open for reading).
+ * @param offset	Offset in the file.
+ * @param size		Size to map.
+ * @return			0 for success, -1 for error (EINVAL if not aligned,
+ * 					or error code of mmap() in errno).
+ * @ingroup memory
+ */
+int gliss_mem_map(gliss_memory_t *memory, gliss_address_t address, int fd, off_t offset, size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE), i;
+	assert(memory);
+	if((address & (page - 1)) != 0 || (offset & (page - 1)) != 0
+	|| (size & (page - 1)) != 0 || size > FLAT_MEM_SIZE - address) {
+		errno = EINVAL;
+		return -1;
+	}
+	if(size == 0)
+		return 0;
+	if(memory->watched != NULL)
+		mem_watched_write(memory, address, size);
+	if(mmap(memory->base + address, size, PROT_READ | PROT_WRITE,
+	MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED)
+		return -1;
+	for(i = 0; i < size; i += FLAT_MEM_WATCH)
+		MARK(memory, address + i);
+	MARK(memory, address + size - 1);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, size, gliss_access_write, memory->spy_data);
+#	endif
+	return 0;
+}
+
+
+/**
+ * Write a page record of a memory checkpoint.
+ * @param out		Stream to write to.
+ * @param addr		Address of the page.
+ * @param buf		Page content (in target byte order).
+ * @param size		Page size.
+ * @return			0 for success, -1 for error.
+ */
+static int mem_save_record(FILE *out, uint64_t addr, const void *buf, uint32_t size) {
+	if(fwrite(&addr, sizeof(addr), 1, out) != 1
+	|| fwrite(&size, sizeof(size), 1, out) != 1
+	|| (size != 0 && fwrite(buf, size, 1, out) != 1))
+		return -1;
+	return 0;
+}
+
+
+/**
+ * Write a run of consecutive pages of a memory checkpoint. If the stream
+ * is seekable, a padding record is inserted before to align the content
+ * of the pages in the file (they can be then mapped by gliss_mem_restore_map()).
+ * @param out		Stream to write to.
+ * @param addr		Address of the first page.
+ * @param buf		Pages content.
+ * @param size		Size of the run.
+ * @param page		Page size.
+ * @return			0 for success, -1 for error.
+ */
+static int mem_save_pages(FILE *out, uint64_t addr, const void *buf, uint32_t size, size_t page) {
+	long pos = ftell(out);
+	if(pos >= 0 && (pos + FLAT_MEM_RECORD) % page != 0) {
+		uint64_t pad = (page - (pos + 2 * FLAT_MEM_RECORD) % page) % page;
+		if(pad == 0)
+			pad = page;		/* a padding record must not be null */
+		if(mem_save_record(out, pad, NULL, 0) != 0)
+			return -1;
+		for(; pad != 0; pad--)
+			if(fputc(0, out) == EOF)
+				return -1;
+	}
+	return mem_save_record(out, addr, buf, size);
+}
+
+
+/**
+ * Test if a page is only made of zeroes (such pages are not saved).
+ * @param buf	Page content.
+ * @param size	Page size (multiple of 8).
+ * @return		Non-zero if the page is null.
+ */
+static int mem_is_null(const void *buf, size_t size) {
+	const uint64_t *p = (const uint64_t *)buf;
+	size_t i;
+	for(i = 0; i < size / sizeof(uint64_t); i++)
+		if(p[i] != 0)
+			return 0;
+	return 1;
+}
+
+
+/**
+ * Save the non-null pages of the memory (used for checkpoints): only the
+ * pages of the written chunks (and of the chunks following them) are looked.
+ * The pages are stored as a sequence of records (address, size, content)
+ * ended by a record of null size and null address
+ * (a record of null size and non-null address is a padding of address bytes).
+ * @param memory	Memory to save.
+ * @param out		Stream to write to.
+ * @return			0 for success, -1 for error.
+ * @ingroup memory
+ */
+int gliss_mem_save(gliss_memory_t *memory, FILE *out) {
+	size_t page = sysconf(_SC_PAGESIZE), i, off, start = 0, size = 0;
+
+	for(i = 0; i < FLAT_MEM_CHUNKS; i++)
+		if(memory->written[i] || (i > 0 && memory->written[i - 1]))
+			for(off = i << FLAT_MEM_CHUNK_BITS; off < ((i + 1) << FLAT_MEM_CHUNK_BITS); off += page)
+				if(!mem_is_null(memory->base + off, page)) {
+					if(size != 0 && start + size == off && size < FLAT_MEM_RUN)
+						size += page;
+					else {
+						if(size != 0 && mem_save_pages(out, start, memory->base + start, size, page) != 0)
+							return -1;
+						start = off;
+						size = page;
+					}
+				}
+	if(size != 0 && mem_save_pages(out, start, memory->base + start, size, page) != 0)
+		return -1;
+	return mem_save_record(out, 0, NULL, 0);
+}
+
+
+/**
+ * Save the pages written since the last call to gliss_mem_clear_dirty()
+ * (or since the creation of the memory), null or not, in the same format
+ * as gliss_mem_save() (incremental checkpoints). The page following a dirty
+ * page is also saved as it may have been written by an access overlapping
+ * both pages.
+ * @param memory	Memory to save.
+ * @param out		Stream to write to.
+ * @return			0 for success, -1 for error.
+ * @ingroup memory
+ */
+int gliss_mem_save_dirty(gliss_memory_t *memory, FILE *out) {
+	size_t page = sysconf(_SC_PAGESIZE), i, p, start = 0, size = 0;
+
+	for(i = 0; i < FLAT_MEM_CHUNKS; i++)
+		if(memory->written[i] || (i > 0 && memory->written[i - 1]))
+			for(p = i << (FLAT_MEM_CHUNK_BITS - FLAT_MEM_WATCH_BITS); p < (i + 1) << (FLAT_MEM_CHUNK_BITS - FLAT_MEM_WATCH_BITS); p++)
+				if(memory->dirty[p] || (p > 0 && memory->dirty[p - 1])) {
+					size_t off = p << FLAT_MEM_WATCH_BITS;
+					if(size != 0 && start + size == off && size < FLAT_MEM_RUN)
+						size += FLAT_MEM_WATCH;
+					else {
+						if(size != 0 && mem_save_pages(out, start, memory->base + start, size, page) != 0)
+							return -1;
+						start = off;
+						size = FLAT_MEM_WATCH;
+					}
+				}
+	if(size != 0 && mem_save_pages(out, start, memory->base + start, size, page) != 0)
+		return -1;
+	return mem_save_record(out, 0, NULL, 0);
+}
+
+
+/**
+ * Start a new dirty period: the pages are marked as not written.
+ * @param memory	Memory to work on.
+ * @ingroup memory
+ */
+void gliss_mem_clear_dirty(gliss_memory_t *memory) {
+	memset(memory->dirty, 0, FLAT_MEM_WATCHES);
+}
+
+
+/**
+ * Restore the pages saved by gliss_mem_save() (possibly by another memory module).
+ * The pages are written over the current content of the memory.
+ * @param memory	Memory to restore to.
+ * @param in		Stream to read from.
+ * @return			0 for success, -1 for error (truncated or invalid stream).
+ * @ingroup memory
+ */
+int gliss_mem_restore(gliss_memory_t *memory, FILE *in) {
+	uint64_t addr;
+	uint32_t size;
+	uint8_t *buf = NULL;
+	uint32_t buf_size = 0;
+
+	while(1) {
+		if(fread(&addr, sizeof(addr), 1, in) != 1
+		|| fread(&size, sizeof(size), 1, in) != 1)
+			break;
+		if(size == 0 && addr == 0) {
+			free(buf);
+			return 0;
+		}
+		if(size == 0) {
+			if(fseek(in, addr, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+		if(size > buf_size) {
+			uint8_t *nbuf = (uint8_t *)realloc(buf, size);
+			if(nbuf == NULL)
+				break;
+			buf = nbuf;
+			buf_size = size;
+		}
+		if(fread(buf, size, 1, in) != 1)
+			break;
+		gliss_mem_write(memory, (gliss_address_t)addr, buf, size);
+	}
+	free(buf);
+	return -1;
+}
+
+
+/**
+ * Restore the pages saved by gliss_mem_save() as gliss_mem_restore() but,
+ * if the stream is a file, the aligned pages are mapped as copy-on-write pages
+ * instead of being read. The file must not be modified while the memory is used.
+ * @param memory	Memory to restore to.
+ * @param in		Stream to read from.
+ * @return			0 for success, -1 for error (truncated or invalid stream).
+ * @ingroup memory
+ */
+int gliss_mem_restore_map(gliss_memory_t *memory, FILE *in) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	uint64_t addr;
+	uint32_t size;
+	uint8_t *buf = NULL;
+	uint32_t buf_size = 0;
+	long pos;
+
+	while(1) {
+		if(fread(&addr, sizeof(addr), 1, in) != 1
+		|| fread(&size, sizeof(size), 1, in) != 1)
+			break;
+		if(size == 0 && addr == 0) {
+			free(buf);
+			return 0;
+		}
+		if(size == 0) {
+			if(fseek(in, addr, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+
+		/* map the pages */
+		pos = ftell(in);
+		if(pos >= 0 && (pos & (page - 1)) == 0
+		&& gliss_mem_map(memory, (gliss_address_t)addr, fileno(in), pos, size) == 0) {
+			if(fseek(in, size, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+
+		/* or read them */
+		if(size > buf_size) {
+			uint8_t *nbuf = (uint8_t *)realloc(buf, size);
+			if(nbuf == NULL)
+				break;
+			buf = nbuf;
+			buf_size = size;
+		}
+		if(fread(buf, size, 1, in) != 1)
+			break;
+		gliss_mem_write(memory, (gliss_address_t)addr, buf, size);
+	}
+	free(buf);
+	return -1;
+}
+
+
+/**
+ * Write a buffer into memory.
+ * @param memory	Memory to write into.
+ * @param address	Address in memory to write to.
+ * @param buffer	Buffer address in host memory.
+ * @param size		Size of the buffer to write.
+ * @ingroup memory
+ */
+void gliss_mem_write(gliss_memory_t *memory, gliss_address_t address, void *buffer, size_t size) {
+	size_t sz = FLAT_MEM_SIZE - address, i;
+	if(memory->watched != NULL && size > 0)
+		mem_watched_write(memory, address, size);
+	if(size > sz) {
+		memcpy(memory->base + address, buffer, sz);
+		memcpy(memory->base, (uint8_t *)buffer + sz, size - sz);
+	}
+	else
+		memcpy(memory->base + address, buffer, size);
+	for(i = 0; i < size; i += FLAT_MEM_WATCH)
+		MARK(memory, address + i);
+	if(size > 0)
+		MARK(memory, address + size - 1);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, size, gliss_access_write, memory->spy_data);
+#	endif
+}
+
+
+/**
+ * Read the memory into the given buffer.
+ * @param memory	Memory to read in.
+ * @param address	Address of the data to read.
+ * @param buffer	Buffer to write data in.
+ * @param size		Size of the data to read.
+ * @ingroup memory
+ */
+void gliss_mem_read(gliss_memory_t *memory, gliss_address_t address, void *buffer, size_t size) {
+	size_t sz = FLAT_MEM_SIZE - address;
+	if(size > sz) {
+		memcpy(buffer, memory->base + address, sz);
+		memcpy((uint8_t *)buffer + sz, memory->base, size - sz);
+	}
+	else
+		memcpy(buffer, memory->base + address, size);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, size, gliss_access_read, memory->spy_data);
+#	endif
+}
+
+
+/*
+ * The integer accesses below are performed with memcpy() on a variable:
+ * this supports unaligned addresses and is compiled as a single load or store.
+ * The accesses overlapping the end of the memory are split as in
+ * gliss_mem_read() and gliss_mem_write(). The other accesses overlapping
+ * two chunks only mark the first one: the copy also scans the chunk
+ * following a written chunk.
+ */
+
+/**
+ * Read bytes overlapping the end of the memory.
+ * @param memory	Memory to read in.
+ * @param address	Address of the data to read.
+ * @param buffer	Buffer to write data in.
+ * @param size		Size of the data to read.
+ */
+static void mem_wrap_read(gliss_memory_t *memory, gliss_address_t address, void *buffer, size_t size) {
+	size_t sz = FLAT_MEM_SIZE - address;
+	memcpy(buffer, memory->base + address, sz);
+	memcpy((uint8_t *)buffer + sz, memory->base, size - sz);
+}
+
+
+/**
+ * Write bytes overlapping the end of the memory.
+ * @param memory	Memory to write into.
+ * @param address	Address in memory to write to.
+ * @param buffer	Buffer address in host memory.
+ * @param size		Size of the buffer to write.
+ */
+static void mem_wrap_write(gliss_memory_t *memory, gliss_address_t address, const void *buffer, size_t size) {
+	size_t sz = FLAT_MEM_SIZE - address;
+	memcpy(memory->base + address, buffer, sz);
+	memcpy(memory->base, (const uint8_t *)buffer + sz, size - sz);
+	MARK(memory, 0);
+}
+
+
+/**
+ * Read an 8-bit integer.
+ * @param memory	Memory to work with.
+ * @param address	Address of integer to read.
+ * @return			Read integer.
+ * @ingroup memory
+ */
+uint8_t gliss_mem_read8(gliss_memory_t *memory, gliss_address_t address) {
+	uint8_t r = memory->base[address];
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(r), gliss_access_read, memory->spy_data);
+#	endif
+	return r;
+}
+
+
+/**
+ * Read a 16-bit integer.
+ * @param memory	Memory to work with.
+ * @param address	Address of integer to read.
+ * @return			Read integer.
+ * @ingroup memory
+ */
+uint16_t gliss_mem_read16(gliss_memory_t *memory, gliss_address_t address) {
+	uint16_t r;
+	if(WRAPS(address, sizeof(r)))
+		mem_wrap_read(memory, address, &r, sizeof(r));
+	else
+		memcpy(&r, memory->base + address, sizeof(r));
+#	if HOST_ENDIANNESS != TARGET_ENDIANNESS
+		r = bswap_16(r);
+#	endif
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(r), gliss_access_read, memory->spy_data);
+#	endif
+	return r;
+}
+
+
+/**
+ * Read a 32-bit integer.
+ * @param memory	Memory to work with.
+ * @param address	Address of integer to read.
+ * @return			Read integer.
+ * @ingroup memory
+ */
+uint32_t gliss_mem_read32(gliss_memory_t *memory, gliss_address_t address) {
+	uint32_t r;
+	if(WRAPS(address, sizeof(r)))
+		mem_wrap_read(memory, address, &r, sizeof(r));
+	else
+		memcpy(&r, memory->base + address, sizeof(r));
+#	if HOST_ENDIANNESS != TARGET_ENDIANNESS
+		r = bswap_32(r);
+#	endif
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(r), gliss_access_read, memory->spy_data);
+#	endif
+	return r;
+}
+
+
+/**
+ * Read a 64-bit integer.
+ * @param memory	Memory to work with.
+ * @param address	Address of integer to read.
+ * @return			Read integer.
+ * @ingroup memory
+ */
+uint64_t gliss_mem_read64(gliss_memory_t *memory, gliss_address_t address) {
+	uint64_t r;
+	if(WRAPS(address, sizeof(r)))
+		mem_wrap_read(memory, address, &r, sizeof(r));
+	else
+		memcpy(&r, memory->base + address, sizeof(r));
+#	if HOST_ENDIANNESS != TARGET_ENDIANNESS
+		r = bswap_64(r);
+#	endif
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(r), gliss_access_read, memory->spy_data);
+#	endif
+	return r;
+}
+
+
+/**
+ * Read a float value.
+ * @param memory	Memory to work with.
+ * @param address	Address of float to read.
+ * @return			Read float.
+ * @ingroup memory
+ */
+float gliss_mem_readf(gliss_memory_t *memory, gliss_address_t address) {
+	union {
+		uint32_t i;
+		float f;
+	} val;
+	val.i = gliss_mem_read32(memory, address);
+	return val.f;
+}
+
+
+/**
+ * Read a double float value.
+ * @param memory	Memory to work with.
+ * @param address	Address of float to read.
+ * @return			Read float.
+ * @ingroup memory
+ */
+double gliss_mem_readd(gliss_memory_t *memory, gliss_address_t address) {
+	union {
+		uint64_t i;
+		double f;
+	} val;
+	val.i = gliss_mem_read64(memory, address);
+	return val.f;
+}
+
+
+/**
+ * Read a long double float value.
+ * @param memory	Memory to work with.
+ * @param address	Address of float to read.
+ * @return			Read float.
+ * @ingroup memory
+ */
+long double gliss_mem_readld(gliss_memory_t *memory, gliss_address_t address) {
+	assertp(0, "not implemented !");
+	return 0.;
+}
+
+
+/**
+ * Write an 8-bit integer in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write integer to.
+ * @param val		Integer to write.
+ * @ingroup memory
+ */
+void gliss_mem_write8(gliss_memory_t *memory, gliss_address_t address, uint8_t val) {
+	WATCH(memory, address, sizeof(val));
+	memory->base[address] = val;
+	MARK(memory, address);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(val), gliss_access_write, memory->spy_data);
+#	endif
+}
+
+
+/**
+ * Write a 16-bit integer in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write integer to.
+ * @param val		Integer to write.
+ * @ingroup memory
+ */
+void gliss_mem_write16(gliss_memory_t *memory, gliss_address_t address, uint16_t val) {
+	uint16_t v = val;
+#	if HOST_ENDIANNESS != TARGET_ENDIANNESS
+		v = bswap_16(v);
+#	endif
+	WATCH(memory, address, sizeof(v));
+	if(WRAPS(address, sizeof(v)))
+		mem_wrap_write(memory, address, &v, sizeof(v));
+	else
+		memcpy(memory->base + address, &v, sizeof(v));
+	MARK(memory, address);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(val), gliss_access_write, memory->spy_data);
+#	endif
+}
+
+
+/**
+ * Write a 32-bit integer in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write integer to.
+ * @param val		Integer to write.
+ * @ingroup memory
+ */
+void gliss_mem_write32(gliss_memory_t *memory, gliss_address_t address, uint32_t val) {
+	uint32_t v = val;
+#	if HOST_ENDIANNESS != TARGET_ENDIANNESS
+		v = bswap_32(v);
+#	endif
+	WATCH(memory, address, sizeof(v));
+	if(WRAPS(address, sizeof(v)))
+		mem_wrap_write(memory, address, &v, sizeof(v));
+	else
+		memcpy(memory->base + address, &v, sizeof(v));
+	MARK(memory, address);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(val), gliss_access_write, memory->spy_data);
+#	endif
+}
+
+
+/**
+ * Write a 64-bit integer in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write integer to.
+ * @param val		Integer to write.
+ * @ingroup memory
+ */
+void gliss_mem_write64(gliss_memory_t *memory, gliss_address_t address, uint64_t val) {
+	uint64_t v = val;
+#	if HOST_ENDIANNESS != TARGET_ENDIANNESS
+		v = bswap_64(v);
+#	endif
+	WATCH(memory, address, sizeof(v));
+	if(WRAPS(address, sizeof(v)))
+		mem_wrap_write(memory, address, &v, sizeof(v));
+	else
+		memcpy(memory->base + address, &v, sizeof(v));
+	MARK(memory, address);
+#	ifdef GLISS_MEM_SPY
+		memory->spy_fun(memory, address, sizeof(val), gliss_access_write, memory->spy_data);
+#	endif
+}
+
+
+/**
+ * Write a float in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write float to.
+ * @param val		Float to write.
+ * @ingroup memory
+ */
+void gliss_mem_writef(gliss_memory_t *memory, gliss_address_t address, float val) {
+	union {
+		uint32_t i;
+		float f;
+	} v;
+	v.f = val;
+	gliss_mem_write32(memory, address, v.i);
+}
+
+
+/**
+ * Write a double float in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write float to.
+ * @param val		Float to write.
+ * @ingroup memory
+ */
+void gliss_mem_writed(gliss_memory_t *memory, gliss_address_t address, double val) {
+	union {
+		uint64_t i;
+		double f;
+	} v;
+	v.f = val;
+	gliss_mem_write64(memory, address, v.i);
+}
+
+
+/**
+ * Write a long double float in memory.
+ * @param memory	Memory to write in.
+ * @param address	Address to write float to.
+ * @param val		Float to write.
+ * @ingroup memory
+ */
+void gliss_mem_writeld(gliss_memory_t *memory, gliss_address_t address, long double val) {
+	assertp(0, "not implemented");
+}
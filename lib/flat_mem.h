@@ -0,0 +1,104 @@
+/*
+ *	flat_mem module interface
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2008, IRIT UPS.
+ *
+ *	GLISS is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	GLISS is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef GLISS_FLAT_MEM_H
+#define GLISS_FLAT_MEM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "config.h"
+
+#if defined(__cplusplus)
+    extern  "C" {
+#endif
+
+#define GLISS_MEM_STATE
+#define GLISS_MEM_INIT(s)
+#define GLISS_MEM_DESTROY(s)
+#define GLISS_MEM_COPY(s, src)
+#define GLISS_MEM_CHECKPOINT
+#define GLISS_MEM_MAP
+#define GLISS_MEM_WATCH
+
+#define GLISS_FLAT_MEM
+
+typedef uint32_t gliss_address_t;
+typedef uint32_t gliss_size_t;
+typedef struct gliss_memory_t gliss_memory_t;
+
+/* creation function */
+gliss_memory_t *gliss_mem_new(void);
+void gliss_mem_delete(gliss_memory_t *memory);
+gliss_memory_t *gliss_mem_copy(gliss_memory_t *memory);
+
+/* file mapping */
+int gliss_mem_map(gliss_memory_t *memory, gliss_address_t address, int fd, off_t offset, size_t size);
+int gliss_mem_restore_map(gliss_memory_t *memory, FILE *in);
+
+/* checkpoint functions */
+int gliss_mem_save(gliss_memory_t *memory, FILE *out);
+int gliss_mem_restore(gliss_memory_t *memory, FILE *in);
+int gliss_mem_save_dirty(gliss_memory_t *memory, FILE *out);
+void gliss_mem_clear_dirty(gliss_memory_t *memory);
+
+/* write watch of code pages */
+typedef void (*gliss_mem_watcher_t)(gliss_memory_t *memory, gliss_address_t address, uint32_t size, void *data);
+void gliss_mem_watch(gliss_memory_t *memory, gliss_address_t address);
+uint32_t gliss_mem_watch_stamp(gliss_memory_t *memory);
+void gliss_mem_add_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data);
+void gliss_mem_remove_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data);
+
+/* read functions */
+uint8_t gliss_mem_read8(gliss_memory_t *, gliss_address_t);
+uint16_t gliss_mem_read16(gliss_memory_t *, gliss_address_t);
+uint32_t gliss_mem_read32(gliss_memory_t *, gliss_address_t);
+uint64_t gliss_mem_read64(gliss_memory_t *, gliss_address_t);
+float gliss_mem_readf(gliss_memory_t *, gliss_address_t);
+double gliss_mem_readd(gliss_memory_t *, gliss_address_t);
+long double gliss_mem_readld(gliss_memory_t *, gliss_address_t);
+void gliss_mem_read(gliss_memory_t *memory, gliss_address_t, void *buf, size_t size);
+
+
+/* write functions */
+void gliss_mem_write8(gliss_memory_t *, gliss_address_t, uint8_t);
+void gliss_mem_write16(gliss_memory_t *, gliss_address_t, uint16_t);
+void gliss_mem_write32(gliss_memory_t *, gliss_address_t, uint32_t);
+void gliss_mem_write64(gliss_memory_t *, gliss_address_t, uint64_t);
+void gliss_mem_writef(gliss_memory_t *, gliss_address_t, float);
+void gliss_mem_writed(gliss_memory_t *, gliss_address_t, double);
+void gliss_mem_writeld(gliss_memory_t *, gliss_address_t, long double);
+void gliss_mem_write(gliss_memory_t *memory, gliss_address_t, void *buf, size_t size);
+
+/* statistics */
+size_t gliss_mem_resident(gliss_memory_t *memory);
+
+#ifdef GLISS_MEM_SPY
+typedef enum { gliss_access_read, gliss_access_write } gliss_access_t;
+typedef void (*gliss_mem_spy_t)(gliss_memory_t *mem, gliss_address_t addr, gliss_size_t size, gliss_access_t access, void *data);
+void gliss_mem_set_spy(gliss_memory_t *mem, gliss_mem_spy_t fun, void *data);
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif	/* GLISS_FLAT_MEM_H */
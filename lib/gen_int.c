@@ -86,6 +86,29 @@ static uint32_t get_bit_n(struct mask_t *mask, int n)
 }*/
 
 
+/* return len bits (32 max) of a mask starting at bit pos, right justified,
+ * bits after the end of the mask are read as 0 */
+static inline uint32_t get_bits(struct mask_t *mask, int pos, int len)
+{
+	int idx = pos >> 5;
+	int off = pos & 31;
+	uint64_t w;
+
+	/* out of range part */
+	if (pos + len > mask->bit_length) {
+		if (pos >= mask->bit_length)
+			return 0;
+		return get_bits(mask, pos, mask->bit_length - pos) << (pos + len - mask->bit_length);
+	}
+
+	/* read the one or two chunks containing the bits */
+	w = (uint64_t)mask->mask[idx] << 32;
+	if (off + len > 32)
+		w |= mask->mask[idx + 1];
+	return (uint32_t)((w << off) >> (64 - len));
+}
+
+
 /* returns the bits in a value inst, only those whose position is set in mask,
  * the selected bits are then concatenated to produce a single 32 bit max number
  * inst->bit_length should be >= to mask->bit_length. we hope the result is 32 bit max as
@@ -97,6 +120,15 @@ uint32_t value_on_mask(struct mask_t *inst, struct mask_t *mask)
 	int k = 0;
 	int i;
 	
+	/* generated mask: one access per run */
+	if (mask->runs != NULL) {
+		uint64_t r = 0;
+		struct mask_run_t *run;
+		for (run = mask->runs; run->len; run++)
+			r = (r << run->len) | get_bits(inst, run->pos, run->len);
+		return (uint32_t)r;
+	}
+
 	if (mask->bit_length == 0)
 		return 0;
 	for (i = 0; i < mask->bit_length; i++) {
@@ -121,6 +153,14 @@ uint64_t extract_mask(struct mask_t *inst, struct mask_t *mask)
 	int k = 0;
 	int i;
 	
+	/* generated mask: one access per run */
+	if (mask->runs != NULL) {
+		struct mask_run_t *run;
+		for (run = mask->runs; run->len; run++)
+			res = (res << run->len) | get_bits(inst, run->pos, run->len);
+		return res;
+	}
+
 	if (mask->bit_length == 0)
 		return 0;
 	for (i = 0; i < mask->bit_length; i++) {
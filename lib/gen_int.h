@@ -13,12 +13,20 @@ extern  "C"
 #define GLISS_GEN_INT_STATE
 #define GLISS_GEN_INT_INIT(s)
 #define GLISS_GEN_INT_DESTROY(s)
+#define GLISS_GEN_INT_COPY(s, src)
+
+/* run of consecutive set bits of a mask (computed by gep for each generated mask) */
+struct mask_run_t {
+	int pos;	/* index of the first bit (0 is the msb of the first chunk) */
+	int len;	/* number of bits (32 max, a null length ends the list) */
+};
 
 /* struct used to store masks and as buffer for instruction codes or any binary value which cannot fit into an uintN_t */
 /* chunks are arranged in the same order as in memory, msb first, lsb last */
 struct mask_t {
 	uint32_t *mask;
 	int bit_length;
+	struct mask_run_t *runs;	/* runs of a generated mask, NULL else */
 };
 
 uint64_t extract_mask(struct mask_t *inst, struct mask_t *mask);
@@ -29,6 +29,7 @@
 #define GLISS_GRT_STATE
 #define GLISS_GRT_INIT(s)
 #define GLISS_GRT_DESTROY(s)
+#define GLISS_GRT_COPY(s, src)
 
 /* compatibility */
 #ifndef INLINE
@@ -13,6 +13,7 @@ extern  "C"
 #define GLISS_INST_SIZE_STATE
 #define GLISS_INST_SIZE_INIT(s)
 #define GLISS_INST_SIZE_DESTROY(s)
+#define GLISS_INST_SIZE_COPY(s, src)
 
 #if defined(__cplusplus)
 }
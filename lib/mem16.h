@@ -12,6 +12,7 @@
 #define GLISS_MEM_STATE
 #define GLISS_MEM_INIT(s)
 #define GLISS_MEM_DESTROY(s)
+#define GLISS_MEM_COPY(s, src)
 
 #define GLISS_MEM16
 
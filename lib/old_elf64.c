@@ -30,6 +30,10 @@
 #include <string.h>
 #include <assert.h>
 #include <gliss/loader.h>
+#if !defined(__WIN32) && !defined(__WIN64) && !defined(GLISS_NO_ELF_MMAP)
+#	define ELF_MMAP
+#	include <sys/mman.h>
+#endif
 
 
 #ifndef NDEBUG
@@ -117,6 +121,8 @@ typedef int64_t		Elf64_Sxword;
 #define ET_LOPROC	0xff00		/* Processor-specific */
 #define ET_HIPROC	0xffff		/* Processor-specific */
 
+#define SHN_UNDEF	0		/* Undefined section */
+
 #define SHT_NULL	0		/* Section header table entry unused */
 #define SHT_PROGBITS	1		/* Program data */
 #define SHT_SYMTAB	2		/* Symbol table */
@@ -288,8 +294,8 @@ struct data_info {
 };
 
 
-/* Global data */
-static Elf_Tables Initial_Tables = {
+/* initial value of the tables */
+static const Elf_Tables Initial_Tables = {
 	0,
 	NULL,
 	-1,
@@ -306,11 +312,30 @@ static Elf_Tables Initial_Tables = {
 	0,
 	NULL
 };
-static Elf_Tables Tables;
-static struct text_info Text;
-static struct data_info Data;
-static Elf64_Ehdr Ehdr;
-static int Is_Elf_Little = 0;
+
+/* entry of the address index of the symbols */
+typedef struct {
+	Elf64_Addr value;
+	int32_t index;
+} Elf_SymAddr;
+
+/* loader instance: all ELF tables live here so that several loaders
+   may be used concurrently from different threads */
+struct gliss_loader_t {
+	Elf_Tables Tables;
+	struct text_info Text;
+	struct data_info Data;
+	Elf64_Ehdr Ehdr;
+	int Is_Elf_Little;
+	uint8_t *map;		/* mapping of the file (sections bytes point in it) */
+	size_t map_size;
+	int fd;				/* file descriptor (kept open while mapped) */
+	int32_t sym_hash_size;	/* number of buckets of the symbol name index (power of 2) */
+	int32_t *sym_hash;		/* first symbol of each bucket (-1 for none) */
+	int32_t *sym_next;		/* next symbol in the same bucket */
+	int32_t sym_addr_cnt;	/* number of code and data symbols */
+	Elf_SymAddr *sym_addr;	/* code and data symbols sorted by address */
+};
 
 static int is_host_little(void) {
     uint32_t x;
@@ -375,21 +400,91 @@ static void ConvertElfHeader(Elf64_Ehdr *Ehdr) {
 	Ehdr->e_shstrndx = ConvertByte2(Ehdr->e_shstrndx);
 }
 
-static int ElfReadHeader(int fd, Elf64_Ehdr *Ehdr){
-	int foffset;
+/**
+ * Read a part of the ELF file, from the mapping of the file if any.
+ * @param loader	Current loader.
+ * @param fd		File descriptor.
+ * @param offset	Offset in the file.
+ * @param buf		Buffer to read in.
+ * @param size		Size to read.
+ * @return			0 for success, -1 for error (EBADF in errno).
+ */
+static int ElfGet(gliss_loader_t *loader, int fd, uint64_t offset, void *buf, size_t size) {
+#	ifdef ELF_MMAP
+		if(loader->map != NULL) {
+			if(size > loader->map_size || offset > loader->map_size - size) {
+				errno = EBADF;
+				return -1;
+			}
+			memcpy(buf, loader->map + offset, size);
+			return 0;
+		}
+#	endif
+	if(lseek(fd, offset, SEEK_SET) == (off_t)-1
+	|| read(fd, buf, size) != size) {
+		errno = EBADF;
+		return -1;
+	}
+	return 0;
+}
+
+
+/**
+ * Get the bytes of a section: they are either pointed in the mapping
+ * of the file (no copy), or read in an allocated buffer.
+ * @param loader	Current loader.
+ * @param fd		File descriptor.
+ * @param offset	Offset of the section in the file.
+ * @param size		Size of the section.
+ * @return			Section bytes or null (error in errno).
+ */
+static uint8_t *ElfGetBytes(gliss_loader_t *loader, int fd, uint64_t offset, size_t size) {
+	uint8_t *bytes;
+#	ifdef ELF_MMAP
+		if(loader->map != NULL) {
+			if(size > loader->map_size || offset > loader->map_size - size) {
+				errno = EBADF;
+				return NULL;
+			}
+			return loader->map + offset;
+		}
+#	endif
+	bytes = (uint8_t *)malloc(size);
+	if(bytes == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	if(ElfGet(loader, fd, offset, bytes, size) != 0) {
+		free(bytes);
+		return NULL;
+	}
+	return bytes;
+}
+
+
+/**
+ * Release section bytes got with ElfGetBytes().
+ * @param loader	Current loader.
+ * @param bytes		Bytes to release.
+ */
+static void ElfFreeBytes(gliss_loader_t *loader, uint8_t *bytes) {
+	if(loader->map == NULL
+	|| bytes < loader->map || bytes >= loader->map + loader->map_size)
+		free(bytes);
+}
+
+static int ElfReadHeader(gliss_loader_t *loader, int fd, Elf64_Ehdr *Ehdr){
 	TRACE;
-	foffset = lseek(fd, 0, SEEK_CUR);
-	lseek(fd, 0, SEEK_SET);
-	if(read(fd, Ehdr, sizeof(Elf64_Ehdr)) != sizeof(Elf64_Ehdr))
+	if(ElfGet(loader, fd, 0, Ehdr, sizeof(Elf64_Ehdr)) != 0)
 		return -1;
 	if(memcmp(Ehdr->e_ident, ELFMAG, 4)) {
 		errno = EBADF;
 		return -1;
 	}
     if(Ehdr->e_ident[EI_DATA] == ELFDATA2LSB)
-		Is_Elf_Little = 1;
+		loader->Is_Elf_Little = 1;
     else if(Ehdr->e_ident[EI_DATA] == ELFDATA2MSB)
-		Is_Elf_Little = 0;
+		loader->Is_Elf_Little = 0;
     else {
 		errno = EBADF;
 		return -1;
@@ -398,8 +493,7 @@ static int ElfReadHeader(int fd, Elf64_Ehdr *Ehdr){
 		errno = EBADF;
 		return -1;
 	}
-	lseek(fd, foffset, SEEK_SET);
-	if (is_host_little() != Is_Elf_Little)
+	if (is_host_little() != loader->Is_Elf_Little)
 		ConvertElfHeader(Ehdr);
 	return 0;
 }
@@ -425,28 +519,24 @@ static void ConvertPgmHeader(Elf64_Phdr *Ephdr) {
 	Ephdr->p_align = ConvertByte8(Ephdr->p_align);
 }
 
-static int ElfReadPgmHdrTbl(int fd,const Elf64_Ehdr *Ehdr) {
+static int ElfReadPgmHdrTbl(gliss_loader_t *loader, int fd,const Elf64_Ehdr *Ehdr) {
 	int32_t i;
 	TRACE;
 	if(Ehdr->e_phoff == 0) {
 		errno = EBADF;
 		return -1;
 	}
-    lseek(fd, Ehdr->e_phoff,SEEK_SET);
-    Tables.pgm_hdr_tbl_size = Ehdr->e_phnum;
-    Tables.pgm_header_tbl = (Elf64_Phdr *)malloc(Ehdr->e_phnum * sizeof(Elf64_Phdr));
-    if(Tables.pgm_header_tbl == NULL) {
+    loader->Tables.pgm_hdr_tbl_size = Ehdr->e_phnum;
+    loader->Tables.pgm_header_tbl = (Elf64_Phdr *)malloc(Ehdr->e_phnum * sizeof(Elf64_Phdr));
+    if(loader->Tables.pgm_header_tbl == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
-	if(read(fd,Tables.pgm_header_tbl,(Ehdr->e_phnum*sizeof(Elf64_Phdr)))
-	!= (Ehdr->e_phnum*sizeof(Elf64_Phdr))) {
-		errno = EBADF;
+	if(ElfGet(loader, fd, Ehdr->e_phoff, loader->Tables.pgm_header_tbl, Ehdr->e_phnum * sizeof(Elf64_Phdr)) != 0)
 		return -1;
-	}
-	if (is_host_little() != Is_Elf_Little)
+	if (is_host_little() != loader->Is_Elf_Little)
     	for(i=0; i < Ehdr->e_phnum; ++i)
-			ConvertPgmHeader(&Tables.pgm_header_tbl[i]);
+			ConvertPgmHeader(&loader->Tables.pgm_header_tbl[i]);
    return 0;
 }
 
@@ -463,63 +553,48 @@ static void ConvertSecHeader(Elf64_Shdr *Eshdr) {
 	Eshdr->sh_entsize = ConvertByte8(Eshdr->sh_entsize);
 }
 
-static int ElfReadSecHdrTbl(int fd, const Elf64_Ehdr *Ehdr) {
-	int32_t i, foffset;
+static int ElfReadSecHdrTbl(gliss_loader_t *loader, int fd, const Elf64_Ehdr *Ehdr) {
+	int32_t i;
 	TRACE;
 	if(Ehdr->e_shoff == 0) {
 		errno = EBADF;
 		return -1;
 	}
-	foffset = lseek(fd, 0, SEEK_CUR);
-	lseek(fd, Ehdr->e_shoff,SEEK_SET);
-	Tables.sechdr_tbl_size = Ehdr->e_shnum;
-	Tables.sec_header_tbl = (Elf64_Shdr *)malloc(Ehdr->e_shnum * sizeof(Elf64_Shdr));
-    if(Tables.sec_header_tbl == NULL) {
+	loader->Tables.sechdr_tbl_size = Ehdr->e_shnum;
+	loader->Tables.sec_header_tbl = (Elf64_Shdr *)malloc(Ehdr->e_shnum * sizeof(Elf64_Shdr));
+    if(loader->Tables.sec_header_tbl == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
-	if(read(fd,Tables.sec_header_tbl,(Ehdr->e_shnum*sizeof(Elf64_Shdr)))
-	!= (Ehdr->e_shnum*sizeof(Elf64_Shdr))) {
-		errno = EBADF;
+	if(ElfGet(loader, fd, Ehdr->e_shoff, loader->Tables.sec_header_tbl, Ehdr->e_shnum * sizeof(Elf64_Shdr)) != 0)
 		return -1;
-	}
-	if (is_host_little() != Is_Elf_Little)
+	if (is_host_little() != loader->Is_Elf_Little)
 		for(i=0;i<Ehdr->e_shnum;++i)
-			ConvertSecHeader(&Tables.sec_header_tbl[i]);
-	lseek(fd,foffset,SEEK_SET);
+			ConvertSecHeader(&loader->Tables.sec_header_tbl[i]);
 	return 0;
 }
 
-static int ElfReadSecNameTbl(int fd, const Elf64_Ehdr *Ehdr) {
-	int foffset;
+static int ElfReadSecNameTbl(gliss_loader_t *loader, int fd, const Elf64_Ehdr *Ehdr) {
 	Elf64_Shdr Eshdr;
 	TRACE;
-	if(Ehdr->e_shoff == 0 || Tables.secnmtbl_ndx == 0) {
+	if(Ehdr->e_shoff == 0 || loader->Tables.secnmtbl_ndx == 0) {
 		errno = EBADF;
 		return -1;
 	}
-	if(Tables.secnmtbl_ndx > 0)
+	if(loader->Tables.secnmtbl_ndx > 0)
 		return 0;
-	Tables.secnmtbl_ndx = Ehdr->e_shstrndx;
-	foffset = lseek(fd, 0, SEEK_CUR);
-	lseek(fd,Ehdr->e_shoff + Ehdr->e_shstrndx * Ehdr->e_shentsize, SEEK_SET);
-    if(read(fd,&Eshdr, sizeof(Eshdr)) != sizeof(Eshdr)) {
-		errno = EBADF;
+	loader->Tables.secnmtbl_ndx = Ehdr->e_shstrndx;
+	if(ElfGet(loader, fd, Ehdr->e_shoff + Ehdr->e_shstrndx * Ehdr->e_shentsize, &Eshdr, sizeof(Eshdr)) != 0)
 		return -1;
-	}
-	if (is_host_little() != Is_Elf_Little)
+	if (is_host_little() != loader->Is_Elf_Little)
 		ConvertSecHeader(&Eshdr);
-	Tables.sec_name_tbl = (char *)malloc(Eshdr.sh_size);
-    if(Tables.sec_name_tbl == NULL) {
+	loader->Tables.sec_name_tbl = (char *)malloc(Eshdr.sh_size);
+    if(loader->Tables.sec_name_tbl == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
-	lseek(fd,Eshdr.sh_offset,SEEK_SET);
-	if(read(fd,Tables.sec_name_tbl,Eshdr.sh_size) != Eshdr.sh_size) {
-		errno = EBADF;
+	if(ElfGet(loader, fd, Eshdr.sh_offset, loader->Tables.sec_name_tbl, Eshdr.sh_size) != 0)
 		return -1;
-	}
-	lseek(fd, foffset, SEEK_SET);
 	return 0;
 }
 
@@ -530,57 +605,46 @@ static void ConvertSymTblEnt(Elf64_Sym *Esym) {
 	Esym->st_size = ConvertByte8(Esym->st_size);
 }
 
-static int ElfReadSymTbl(int fd, const Elf64_Ehdr *Ehdr) {
-	int32_t i, j, foffset;
+static int ElfReadSymTbl(gliss_loader_t *loader, int fd, const Elf64_Ehdr *Ehdr) {
+	int32_t i, j;
 	TRACE;
 	if(Ehdr->e_shoff == 0) {
 		errno = EBADF;
 		return -1;
 	}
-	if(Tables.symtbl_ndx == 0) {
+	if(loader->Tables.symtbl_ndx == 0) {
 		errno = EBADF;
 		return -1;
 	}
-	if(Tables.symtbl_ndx > 0)
+	if(loader->Tables.symtbl_ndx > 0)
 		return 0; /* already done */
-	foffset = lseek(fd,0,SEEK_CUR);
-	lseek(fd,Ehdr->e_shoff,SEEK_SET);
 	for(i=0; i < Ehdr->e_shnum; ++i)
-		if(Tables.sec_header_tbl[i].sh_type == SHT_SYMTAB)
+		if(loader->Tables.sec_header_tbl[i].sh_type == SHT_SYMTAB)
 			break;
     if(Ehdr->e_shnum == i) {
 		errno = EBADF;
 		return -1;
 	}
-	Tables.symtbl_ndx = i;
-	lseek(fd,Tables.sec_header_tbl[i].sh_offset,SEEK_SET);
-	Tables.sym_tbl = (Elf64_Sym *)malloc(Tables.sec_header_tbl[i].sh_size);
-	if(Tables.sym_tbl == NULL) {
+	loader->Tables.symtbl_ndx = i;
+	loader->Tables.sym_tbl = (Elf64_Sym *)malloc(loader->Tables.sec_header_tbl[i].sh_size);
+	if(loader->Tables.sym_tbl == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
-    if(read(fd,Tables.sym_tbl,Tables.sec_header_tbl[i].sh_size)
-	!= Tables.sec_header_tbl[i].sh_size) {
-		errno = EBADF;
+	if(ElfGet(loader, fd, loader->Tables.sec_header_tbl[i].sh_offset, loader->Tables.sym_tbl, loader->Tables.sec_header_tbl[i].sh_size) != 0)
 		return -1;
-	}
-	if(is_host_little() != Is_Elf_Little)
-		for(j=0;j<(Tables.sec_header_tbl[i].sh_size/Tables.sec_header_tbl[i].sh_entsize);++j)
-			ConvertSymTblEnt(&Tables.sym_tbl[j]);
+	if(is_host_little() != loader->Is_Elf_Little)
+		for(j=0;j<(loader->Tables.sec_header_tbl[i].sh_size/loader->Tables.sec_header_tbl[i].sh_entsize);++j)
+			ConvertSymTblEnt(&loader->Tables.sym_tbl[j]);
 	/* Got Symbol table now reading string table for it */
-	i = Tables.sec_header_tbl[i].sh_link;
-	Tables.symstr_tbl = (char *)malloc(Tables.sec_header_tbl[i].sh_size);
-	if(Tables.symstr_tbl == NULL) {
+	i = loader->Tables.sec_header_tbl[i].sh_link;
+	loader->Tables.symstr_tbl = (char *)malloc(loader->Tables.sec_header_tbl[i].sh_size);
+	if(loader->Tables.symstr_tbl == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
-	lseek(fd,Tables.sec_header_tbl[i].sh_offset,SEEK_SET);
-	if(read(fd,(char *)Tables.symstr_tbl,Tables.sec_header_tbl[i].sh_size)
-	!= Tables.sec_header_tbl[i].sh_size) {
-		errno = EBADF;
+	if(ElfGet(loader, fd, loader->Tables.sec_header_tbl[i].sh_offset, loader->Tables.symstr_tbl, loader->Tables.sec_header_tbl[i].sh_size) != 0)
 		return -1;
-	}
-	lseek(fd,foffset,SEEK_SET);
 	return 0;
 }
 
@@ -589,49 +653,39 @@ static void LoadString(char *buf, char *src, int n) {
 	buf[n - 1] = '\0';
 }
 
-static int ElfReadTextSecs(int fd, const Elf64_Ehdr *Ehdr) {
-	int32_t i,foffset;
+static int ElfReadTextSecs(gliss_loader_t *loader, int fd, const Elf64_Ehdr *Ehdr) {
+	int32_t i;
 	struct text_secs *txt_sec, **ptr, *ptr1;
 	TRACE;
     if(Ehdr->e_shoff == 0) {
 		errno = EBADF;
 		return -1;
 	}
-	foffset = lseek(fd,0,SEEK_CUR);
-	lseek(fd,Ehdr->e_shoff,SEEK_SET);
 
 	TRACE;
 	for(i=0; i<Ehdr->e_shnum; ++i) {
-		if((Tables.sec_header_tbl[i].sh_type == SHT_PROGBITS)
-		&& (Tables.sec_header_tbl[i].sh_flags & SHF_ALLOC)
-		&& (Tables.sec_header_tbl[i].sh_flags & SHF_EXECINSTR)) {
+		if((loader->Tables.sec_header_tbl[i].sh_type == SHT_PROGBITS)
+		&& (loader->Tables.sec_header_tbl[i].sh_flags & SHF_ALLOC)
+		&& (loader->Tables.sec_header_tbl[i].sh_flags & SHF_EXECINSTR)) {
 			txt_sec = (struct text_secs *)malloc(sizeof(struct text_secs));
 			if(txt_sec == NULL) {
 				errno = ENOMEM;
 				return -1;
 			}
-			LoadString(txt_sec->name, &Tables.sec_name_tbl[Tables.sec_header_tbl[i].sh_name], sizeof(txt_sec->name));
+			LoadString(txt_sec->name, &loader->Tables.sec_name_tbl[loader->Tables.sec_header_tbl[i].sh_name], sizeof(txt_sec->name));
 			if(!strcmp(txt_sec->name,".text"))
-				Text.txt_index = i;
-			txt_sec->offset = Tables.sec_header_tbl[i].sh_offset;
-			txt_sec->address = Tables.sec_header_tbl[i].sh_addr;
-			txt_sec->size = Tables.sec_header_tbl[i].sh_size;
+				loader->Text.txt_index = i;
+			txt_sec->offset = loader->Tables.sec_header_tbl[i].sh_offset;
+			txt_sec->address = loader->Tables.sec_header_tbl[i].sh_addr;
+			txt_sec->size = loader->Tables.sec_header_tbl[i].sh_size;
 			txt_sec->next = NULL;
-			txt_sec->bytes= (uint8_t *)malloc(txt_sec->size *sizeof(uint8_t));
-            if(txt_sec->bytes==NULL) {
+			txt_sec->bytes = ElfGetBytes(loader, fd, txt_sec->offset, txt_sec->size);
+            if(txt_sec->bytes == NULL) {
 				free(txt_sec);
-				errno = ENOMEM;
-				return -1;
-			}
-			lseek(fd,txt_sec->offset,SEEK_SET);
-			if(read(fd,txt_sec->bytes,txt_sec->size) != txt_sec->size) {
-				free(txt_sec->bytes);
-				free(txt_sec);
-				errno = EBADF;
 				return -1;
 			}
 			/* set next ptr */
-			ptr = &Text.secs;
+			ptr = &loader->Text.secs;
 			while(*ptr != NULL){
 				if((*ptr)->address > txt_sec->address){
 					txt_sec->next = *ptr;
@@ -644,80 +698,78 @@ static int ElfReadTextSecs(int fd, const Elf64_Ehdr *Ehdr) {
 				*ptr = txt_sec;
 		}
 	}
-    if(Text.secs == NULL) {
+    if(loader->Text.secs == NULL) {
 		errno = EBADF;
 		return -1;
 	}
 
     /* ??? */
     TRACE;
-	Text.address = Text.secs->address;
-	ptr1 = Text.secs;
+	loader->Text.address = loader->Text.secs->address;
+	ptr1 = loader->Text.secs;
 	while(ptr1->next != NULL)
         ptr1 = ptr1->next;
-	Text.size = ptr1->address + ptr1->size - Text.address;
-	Text.bytes = (uint8_t *)malloc(Text.size);
-	if(Text.bytes == NULL) {
-		errno = ENOMEM;
-		return -1;
+	loader->Text.size = ptr1->address + ptr1->size - loader->Text.address;
+
+	/* the whole text image is only built without file mapping */
+	if(loader->map == NULL) {
+		loader->Text.bytes = (uint8_t *)malloc(loader->Text.size);
+		if(loader->Text.bytes == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		memset(loader->Text.bytes,0,loader->Text.size);
 	}
-	memset(Text.bytes,0,Text.size);
 
 	TRACE;
-	ptr1 = Text.secs;
+	ptr1 = loader->Text.secs;
 	while(ptr1 != NULL){
 		if(!strcmp(ptr1->name,".text")){
-			Text.txt_addr = ptr1->address;
-			Text.txt_size = ptr1->size;
-		}
-		lseek(fd,ptr1->offset,SEEK_SET);
-		if(read(fd,&Text.bytes[ptr1->address-Text.address],ptr1->size)
-		!= ptr1->size) {
-			errno = EBADF;
-			return -1;
+			loader->Text.txt_addr = ptr1->address;
+			loader->Text.txt_size = ptr1->size;
 		}
+		if(loader->Text.bytes != NULL)
+			memcpy(&loader->Text.bytes[ptr1->address-loader->Text.address], ptr1->bytes, ptr1->size);
 		ptr1 = ptr1->next;
 	}
-	lseek(fd,foffset,SEEK_SET);
-	Text.txt_addr = Ehdr->e_entry; // modification par Tahiry l'entre du programme est entry et non le debut du segment de prog
+	loader->Text.txt_addr = Ehdr->e_entry; // modification par Tahiry l'entre du programme est entry et non le debut du segment de prog
 
 	TRACE;
     return 0;
 }
 
-static int ElfInsertDataSec(const Elf64_Shdr *hdr,int fd) {
+static int ElfInsertDataSec(gliss_loader_t *loader, const Elf64_Shdr *hdr,int fd) {
 	struct data_secs *data_sec,**ptr;
 	data_sec = (struct data_secs *)malloc(sizeof(struct data_secs));
 	if(data_sec == NULL) {
 		errno = ENOMEM;
 		return -1;
 	}
-	LoadString(data_sec->name, &Tables.sec_name_tbl[hdr->sh_name], sizeof(data_sec->name));
+	LoadString(data_sec->name, &loader->Tables.sec_name_tbl[hdr->sh_name], sizeof(data_sec->name));
 	data_sec->offset = hdr->sh_offset;
 	data_sec->address = hdr->sh_addr;
 	data_sec->size = hdr->sh_size;
 	data_sec->type = hdr->sh_type;
 	data_sec->flags = hdr->sh_flags;
 	data_sec->next = NULL;
-	data_sec->bytes=(uint8_t *)malloc(data_sec->size);
-    if(data_sec->bytes==NULL) {
-		free(data_sec);
-		errno = ENOMEM;
-		return -1;
-	}
     if(strcmp(data_sec->name,".bss") != 0
 	&& strcmp(data_sec->name,".sbss")) {
-		lseek(fd,data_sec->offset,SEEK_SET);
-		if(read(fd,data_sec->bytes,data_sec->size)!=data_sec->size) {
-			free(data_sec->bytes);
+		data_sec->bytes = ElfGetBytes(loader, fd, data_sec->offset, data_sec->size);
+		if(data_sec->bytes == NULL) {
 			free(data_sec);
-			errno = EBADF;
 			return -1;
 		}
     }
-	else
+	else {
+		data_sec->bytes = (uint8_t *)malloc(data_sec->size);
+		if(data_sec->bytes == NULL) {
+			free(data_sec);
+			errno = ENOMEM;
+			return -1;
+		}
 		memset(data_sec->bytes,0,data_sec->size);
-	ptr = &Data.secs;
+	}
+	ptr = &loader->Data.secs;
 	while(*ptr != NULL){
 		if((*ptr)->address > data_sec->address){
 			data_sec->next = *ptr;
@@ -731,112 +783,198 @@ static int ElfInsertDataSec(const Elf64_Shdr *hdr,int fd) {
 	return 0;
 }
 
-static int ElfReadDataSecs(int fd, const Elf64_Ehdr *Ehdr) {
-	int32_t i,foffset;
-	foffset = lseek(fd,0,SEEK_CUR);
+static int ElfReadDataSecs(gliss_loader_t *loader, int fd, const Elf64_Ehdr *Ehdr) {
+	int32_t i;
 	for(i=0;i<Ehdr->e_shnum;++i){
 		int res = 0;
-		if(Tables.sec_header_tbl[i].sh_type == SHT_PROGBITS){
-			if(Tables.sec_header_tbl[i].sh_flags == (SHF_ALLOC | SHF_WRITE))
-				res = ElfInsertDataSec(&Tables.sec_header_tbl[i],fd);
-			else if(Tables.sec_header_tbl[i].sh_flags == (SHF_ALLOC))
-				res = ElfInsertDataSec(&Tables.sec_header_tbl[i],fd);
+		if(loader->Tables.sec_header_tbl[i].sh_type == SHT_PROGBITS){
+			if(loader->Tables.sec_header_tbl[i].sh_flags == (SHF_ALLOC | SHF_WRITE))
+				res = ElfInsertDataSec(loader, &loader->Tables.sec_header_tbl[i],fd);
+			else if(loader->Tables.sec_header_tbl[i].sh_flags == (SHF_ALLOC))
+				res = ElfInsertDataSec(loader, &loader->Tables.sec_header_tbl[i],fd);
         }
-		else if(Tables.sec_header_tbl[i].sh_type == SHT_NOBITS
-		&& Tables.sec_header_tbl[i].sh_flags == (SHF_ALLOC | SHF_WRITE))
-			res = ElfInsertDataSec(&Tables.sec_header_tbl[i],fd);
+		else if(loader->Tables.sec_header_tbl[i].sh_type == SHT_NOBITS
+		&& loader->Tables.sec_header_tbl[i].sh_flags == (SHF_ALLOC | SHF_WRITE))
+			res = ElfInsertDataSec(loader, &loader->Tables.sec_header_tbl[i],fd);
 		if(res != 0)
 			return -1;
     }
-    if(Data.secs != NULL)
-		Data.address = Data.secs->address;
+    if(loader->Data.secs != NULL)
+		loader->Data.address = loader->Data.secs->address;
 	else
-		Data.address = 0;
-	lseek(fd,foffset,SEEK_SET);
+		loader->Data.address = 0;
     return 0;
 }
 
-static int ElfRead(int elf){
-	if(ElfReadHeader(elf,&Ehdr) == 0
-	&& ElfCheckExec(&Ehdr) == 0
-	&& ElfReadPgmHdrTbl(elf,&Ehdr) == 0
-	&& ElfReadSecHdrTbl(elf,&Ehdr) == 0
-	&& ElfReadSecNameTbl(elf,&Ehdr) == 0
-	&& ElfReadSymTbl(elf,&Ehdr) == 0
-	&& ElfReadTextSecs(elf,&Ehdr) == 0
-	&& ElfReadDataSecs(elf,&Ehdr) == 0)
+/**
+ * Compute the hash of a symbol name (ELF standard hash function).
+ * @param name	Name to hash.
+ * @return		Hash value.
+ */
+static uint32_t ElfHash(const char *name) {
+	uint32_t h = 0, g;
+	while(*name) {
+		h = (h << 4) + (unsigned char)*name++;
+		g = h & 0xf0000000;
+		if(g)
+			h ^= g >> 24;
+		h &= ~g;
+	}
+	return h;
+}
+
+static int ElfCompareSymAddr(const void *p1, const void *p2) {
+	const Elf_SymAddr *s1 = (const Elf_SymAddr *)p1, *s2 = (const Elf_SymAddr *)p2;
+	if(s1->value != s2->value)
+		return s1->value < s2->value ? -1 : 1;
+	else
+		return s1->index - s2->index;
+}
+
+/**
+ * Build the symbol indexes: a hash table on the names and
+ * the defined code and data symbols sorted by address.
+ * @param loader	Current loader.
+ * @return			0 for success, -1 for error (ENOMEM in errno).
+ */
+static int ElfBuildSymIndex(gliss_loader_t *loader) {
+	int32_t n = gliss_loader_count_syms(loader), i;
+	uint32_t b;
+	Elf64_Sym *s;
+	TRACE;
+
+	/* build the name index (reverse order to get the first symbol of a name first) */
+	for(loader->sym_hash_size = 16; loader->sym_hash_size < n; loader->sym_hash_size <<= 1);
+	loader->sym_hash = (int32_t *)malloc(loader->sym_hash_size * sizeof(int32_t));
+	loader->sym_next = (int32_t *)malloc((n ? n : 1) * sizeof(int32_t));
+	loader->sym_addr = (Elf_SymAddr *)malloc((n ? n : 1) * sizeof(Elf_SymAddr));
+	if(loader->sym_hash == NULL || loader->sym_next == NULL || loader->sym_addr == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memset(loader->sym_hash, 0xff, loader->sym_hash_size * sizeof(int32_t));
+	for(i = n - 1; i >= 0; i--) {
+		b = ElfHash(loader->Tables.symstr_tbl + loader->Tables.sym_tbl[i].st_name) & (loader->sym_hash_size - 1);
+		loader->sym_next[i] = loader->sym_hash[b];
+		loader->sym_hash[b] = i;
+	}
+
+	/* build the address index */
+	loader->sym_addr_cnt = 0;
+	for(i = 0; i < n; i++) {
+		s = &loader->Tables.sym_tbl[i];
+		if(s->st_shndx != SHN_UNDEF
+		&& (ELF64_ST_TYPE(s->st_info) == STT_FUNC || ELF64_ST_TYPE(s->st_info) == STT_OBJECT)) {
+			loader->sym_addr[loader->sym_addr_cnt].value = s->st_value;
+			loader->sym_addr[loader->sym_addr_cnt].index = i;
+			loader->sym_addr_cnt++;
+		}
+	}
+	qsort(loader->sym_addr, loader->sym_addr_cnt, sizeof(Elf_SymAddr), ElfCompareSymAddr);
+	return 0;
+}
+
+static int ElfRead(gliss_loader_t *loader, int elf){
+	if(ElfReadHeader(loader, elf, &loader->Ehdr) == 0
+	&& ElfCheckExec(&loader->Ehdr) == 0
+	&& ElfReadPgmHdrTbl(loader, elf, &loader->Ehdr) == 0
+	&& ElfReadSecHdrTbl(loader, elf, &loader->Ehdr) == 0
+	&& ElfReadSecNameTbl(loader, elf, &loader->Ehdr) == 0
+	&& ElfReadSymTbl(loader, elf, &loader->Ehdr) == 0
+	&& ElfBuildSymIndex(loader) == 0
+	&& ElfReadTextSecs(loader, elf, &loader->Ehdr) == 0
+	&& ElfReadDataSecs(loader, elf, &loader->Ehdr) == 0)
 		return 0;
 	else
 		return -1;
 }
 
-static void ElfCleanup(void) {
+static void ElfCleanup(gliss_loader_t *loader) {
 	struct text_secs *curt, *nextt;
 	struct data_secs *curd, *nextd;
 
-	/* free static tables */
-	if(Tables.pgm_header_tbl != NULL) {
-		free(Tables.pgm_header_tbl);
-		Tables.pgm_header_tbl = NULL;
+	/* free loader tables */
+	if(loader->Tables.pgm_header_tbl != NULL) {
+		free(loader->Tables.pgm_header_tbl);
+		loader->Tables.pgm_header_tbl = NULL;
 	}
-	if(Tables.sec_header_tbl != NULL) {
-		free(Tables.sec_header_tbl);
-		Tables.sec_header_tbl = NULL;
+	if(loader->Tables.sec_header_tbl != NULL) {
+		free(loader->Tables.sec_header_tbl);
+		loader->Tables.sec_header_tbl = NULL;
 	}
-	if(Tables.sec_name_tbl != NULL) {
-		free(Tables.sec_name_tbl);
-		Tables.sec_name_tbl = NULL;
+	if(loader->Tables.sec_name_tbl != NULL) {
+		free(loader->Tables.sec_name_tbl);
+		loader->Tables.sec_name_tbl = NULL;
 	}
-	if(Tables.sym_tbl != NULL) {
-		free(Tables.sym_tbl);
-		Tables.sym_tbl = NULL;
+	if(loader->Tables.sym_tbl != NULL) {
+		free(loader->Tables.sym_tbl);
+		loader->Tables.sym_tbl = NULL;
 	}
-	if(Tables.symstr_tbl != NULL) {
-		free(Tables.symstr_tbl);
-		Tables.symstr_tbl = NULL;
+	if(loader->Tables.symstr_tbl != NULL) {
+		free(loader->Tables.symstr_tbl);
+		loader->Tables.symstr_tbl = NULL;
 	}
-	if(Text.bytes != NULL) {
-		free(Text.bytes);
-		Text.bytes = NULL;
+	if(loader->Text.bytes != NULL) {
+		free(loader->Text.bytes);
+		loader->Text.bytes = NULL;
 	}
 
+	/* free symbol indexes */
+	free(loader->sym_hash);
+	free(loader->sym_next);
+	free(loader->sym_addr);
+	loader->sym_hash = NULL;
+	loader->sym_next = NULL;
+	loader->sym_addr = NULL;
+
 	/* free text sections */
-	for(curt = Text.secs; curt != NULL; curt = nextt) {
+	for(curt = loader->Text.secs; curt != NULL; curt = nextt) {
 		nextt = curt->next;
-		free(curt->bytes);
+		ElfFreeBytes(loader, curt->bytes);
 		free(curt);
 	}
-	Text.secs = NULL;
+	loader->Text.secs = NULL;
 
 	/* free data sections */
-	for(curd = Data.secs; curd != NULL; curd = nextd) {
+	for(curd = loader->Data.secs; curd != NULL; curd = nextd) {
 		nextd = curd->next;
-		free(curd->bytes);
+		ElfFreeBytes(loader, curd->bytes);
 		free(curd);
 	}
-	Data.secs = NULL;
+	loader->Data.secs = NULL;
+
+	/* release the file mapping */
+#	ifdef ELF_MMAP
+		if(loader->map != NULL) {
+			munmap(loader->map, loader->map_size);
+			loader->map = NULL;
+		}
+#	endif
+	if(loader->fd >= 0) {
+		close(loader->fd);
+		loader->fd = -1;
+	}
 }
 
-static void ElfReset(void) {
-	memcpy(&Tables, &Initial_Tables, sizeof(Tables));
-	memset(&Text, 0, sizeof(Text));
-	memset(&Data, 0, sizeof(Data));
-	memset(&Ehdr, 0, sizeof(Ehdr));
-	Is_Elf_Little = 0;
+static void ElfReset(gliss_loader_t *loader) {
+	memcpy(&loader->Tables, &Initial_Tables, sizeof(Elf_Tables));
+	memset(&loader->Text, 0, sizeof(loader->Text));
+	memset(&loader->Data, 0, sizeof(loader->Data));
+	memset(&loader->Ehdr, 0, sizeof(loader->Ehdr));
+	loader->Is_Elf_Little = 0;
+	loader->map = NULL;
+	loader->map_size = 0;
+	loader->fd = -1;
+	loader->sym_hash_size = 0;
+	loader->sym_hash = NULL;
+	loader->sym_next = NULL;
+	loader->sym_addr_cnt = 0;
+	loader->sym_addr = NULL;
 }
 
 
 /*********************** loader interface ********************************/
 
-/* types */
-struct gliss_loader_t {
-	Elf_Tables Tables;
-	struct text_info Text;
-	struct data_info Data;
-	Elf64_Ehdr Ehdr;
-	int Is_Elf_Little;
-};
-
 /**
  * Open an ELF file.
  * @param path	Path to the file.
@@ -870,32 +1008,34 @@ gliss_loader_t *gliss_loader_open(const char *path) {
 		return NULL;
 	}
 
+	/* map the file (the descriptor is kept for segment mapping) */
+	TRACE;
+	ElfReset(loader);
+#	ifdef ELF_MMAP
+	{
+		struct stat st;
+		if(fstat(elf, &st) == 0 && st.st_size > 0) {
+			void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, elf, 0);
+			if(map != MAP_FAILED) {
+				loader->map = (uint8_t *)map;
+				loader->map_size = st.st_size;
+				loader->fd = elf;
+			}
+		}
+	}
+#	endif
+
 	/* load the ELF */
 	TRACE;
-	ElfReset();
-	res = ElfRead(elf);
-	assert(Text.secs != NULL);
-	close(elf);
+	res = ElfRead(loader, elf);
+	if(loader->fd < 0)
+		close(elf);
 	if(res != 0) {
-		//!!DEBUG!!
-		printf("res!=0\n");
-		ElfCleanup();
+		ElfCleanup(loader);
 		free(loader);
 		return NULL;
 	}
-
-	/* record data */
-	TRACE;
-	loader->Tables = Tables;
-	loader->Text = Text;
-	loader->Data = Data;
-	loader->Ehdr = Ehdr;
-	loader->Is_Elf_Little = Is_Elf_Little;
-
-	/* !!TODO!! after data stored into loader,
-	clean the globals of Elf_Tables (just a shallow clean,
-	real clean will be done by loader when destroyed) */
-	ElfReset();
+	assert(loader->Text.secs != NULL);
 
 	return loader;
 }
@@ -908,51 +1048,90 @@ gliss_loader_t *gliss_loader_open(const char *path) {
 void gliss_loader_close(gliss_loader_t *loader)
 {
 	assert(loader);
-	/*gliss_loader_t *backup = malloc(sizeof(gliss_loader_t));*/
-
-	/* backup globals */
-	/*backup->Tables = Tables;
-	backup->Text = Text;
-	backup->Data = Data;
-	backup->Ehdr = Ehdr;
-	backup->Is_Elf_Little = Is_Elf_Little;*/
-
-	/* replace globals by loader's data */
-	Tables = loader->Tables;
-	Text = loader->Text;
-	Data = loader->Data;
-	Ehdr = loader->Ehdr;
-	Is_Elf_Little = loader->Is_Elf_Little;
-
-	/* destroy loader's data */
-	ElfCleanup();
-
-	/* restore previous globals */
-	/*Tables = backup->Tables;
-	Text = backup->Text;
-	Data = backup->Data;
-	Ehdr = backup->Ehdr;
-	Is_Elf_Little = backup->Is_Elf_Little;*/
-
-	/* destroy loader */
+	ElfCleanup(loader);
 	free(loader);
 }
 
 
+#ifdef ELF_MMAP
 /**
- * Load the opened ELF program into the given platform (main memory chosen).
- * @param loader	program ELF loader
- * @param memory	memory to load in
+ * Load the PT_LOAD segments of the program from the file mapping.
+ * If the memory supports it (GLISS_MEM_MAP), the whole pages of the file part
+ * of the segments are mapped as private copy-on-write pages.
+ * @param loader	Current loader.
+ * @param memory	Memory to load in.
+ * @return			0 for success, -1 if the segments cannot be used
+ * 					(and nothing has been loaded).
  */
-void gliss_loader_load(gliss_loader_t *loader, gliss_platform_t *pf) {
+static int ElfLoadSegments(gliss_loader_t *loader, gliss_memory_t *memory) {
+	static uint8_t zeros[4096];
+	Elf64_Phdr *seg;
+	uint64_t done, size;
+	int i, found = 0;
+#	ifdef GLISS_MEM_MAP
+		uint64_t page = sysconf(_SC_PAGESIZE), head;
+#	endif
+
+	/* check the segments */
+	for(i = 0; i < loader->Tables.pgm_hdr_tbl_size; i++) {
+		seg = &loader->Tables.pgm_header_tbl[i];
+		if(seg->p_type != PT_LOAD)
+			continue;
+		if(seg->p_filesz > seg->p_memsz
+		|| (uint64_t)seg->p_filesz > loader->map_size
+		|| (uint64_t)seg->p_offset > loader->map_size - seg->p_filesz)
+			return -1;
+		found = 1;
+	}
+	if(!found)
+		return -1;
+
+	/* load them */
+	for(i = 0; i < loader->Tables.pgm_hdr_tbl_size; i++) {
+		seg = &loader->Tables.pgm_header_tbl[i];
+		if(seg->p_type != PT_LOAD)
+			continue;
+		TRACE;
+
+		/* map the whole pages of the file part */
+		done = 0;
+#		ifdef GLISS_MEM_MAP
+			head = (page - seg->p_vaddr % page) % page;
+			if((seg->p_vaddr - seg->p_offset) % page == 0 && head < seg->p_filesz) {
+				size = (seg->p_filesz - head) & ~(page - 1);
+				if(size != 0
+				&& gliss_mem_map(memory, seg->p_vaddr + head, loader->fd, seg->p_offset + head, size) == 0) {
+					gliss_mem_write(memory, seg->p_vaddr, loader->map + seg->p_offset, head);
+					done = head + size;
+				}
+			}
+#		endif
+
+		/* copy the rest of the file part */
+		if(done < seg->p_filesz)
+			gliss_mem_write(memory, seg->p_vaddr + done, loader->map + seg->p_offset + done, seg->p_filesz - done);
+
+		/* clear the memory part */
+		for(done = seg->p_filesz; done < seg->p_memsz; done += size) {
+			size = seg->p_memsz - done;
+			if(size > sizeof(zeros))
+				size = sizeof(zeros);
+			gliss_mem_write(memory, seg->p_vaddr + done, zeros, size);
+		}
+	}
+	return 0;
+}
+#endif
+
+
+/**
+ * Load the text and data sections of the program.
+ * @param loader	Current loader.
+ * @param memory	Memory to load in.
+ */
+static void ElfLoadSections(gliss_loader_t *loader, gliss_memory_t *memory) {
     struct data_secs* ptr;
     struct text_secs* ptr_tex;
-    uint8_t*          rbuffer;
-    unsigned int i;
-	assert(loader->Text.secs != NULL);
-
-	/* adapt the next line if you have an harvard mem archi */
-	gliss_memory_t *memory = gliss_get_memory(pf, GLISS_MAIN_MEMORY);
 
 	/* load text part */
 	TRACE;
@@ -975,6 +1154,30 @@ void gliss_loader_load(gliss_loader_t *loader, gliss_platform_t *pf) {
 			gliss_mem_write(memory, ptr->address, ptr->bytes, ptr->size);
 		ptr = ptr->next;
 	}
+}
+
+
+/**
+ * Load the opened ELF program into the given platform (main memory chosen).
+ * With the file mapping, the program is loaded from its PT_LOAD segments;
+ * else (or if the segments are not usable) from its sections.
+ * @param loader	program ELF loader
+ * @param memory	memory to load in
+ */
+void gliss_loader_load(gliss_loader_t *loader, gliss_platform_t *pf) {
+    unsigned int i;
+	assert(loader->Text.secs != NULL);
+
+	/* adapt the next line if you have an harvard mem archi */
+	gliss_memory_t *memory = gliss_get_memory(pf, GLISS_MAIN_MEMORY);
+
+	/* load the program */
+#	ifdef ELF_MMAP
+		if(loader->map == NULL || ElfLoadSegments(loader, memory) != 0)
+			ElfLoadSections(loader, memory);
+#	else
+		ElfLoadSections(loader, memory);
+#	endif
 
 	/* initialize BSS part */
 #	ifdef GLISS_NOBITS_INIT
@@ -1104,6 +1307,52 @@ void gliss_loader_sym(gliss_loader_t *loader, int sym, gliss_loader_sym_t *data)
 }
 
 
+/**
+ * Find a symbol by its name (using a hash table built at opening).
+ * @param loader	Current loader.
+ * @param name		Name of the looked symbol.
+ * @return			Index of the first symbol with this name, -1 if not found.
+ */
+int gliss_loader_find_sym(gliss_loader_t *loader, const char *name) {
+	int32_t i;
+	assert(loader);
+	assert(name);
+	for(i = loader->sym_hash[ElfHash(name) & (loader->sym_hash_size - 1)]; i >= 0; i = loader->sym_next[i])
+		if(strcmp(loader->Tables.symstr_tbl + loader->Tables.sym_tbl[i].st_name, name) == 0)
+			return i;
+	return -1;
+}
+
+
+/**
+ * Find the code or data symbol the nearest preceding or at the given address
+ * (binary search in an index built at opening). When several symbols
+ * have the same address, the first one in the symbol table is returned.
+ * @param loader	Current loader.
+ * @param addr		Looked address.
+ * @return			Index of the symbol, -1 if there is no symbol before the address.
+ */
+int gliss_loader_find_sym_at(gliss_loader_t *loader, gliss_address_t addr) {
+	int32_t l = 0, h = loader->sym_addr_cnt, m;
+	assert(loader);
+
+	/* look for the first symbol after the address */
+	while(l < h) {
+		m = (l + h) / 2;
+		if(loader->sym_addr[m].value <= addr)
+			l = m + 1;
+		else
+			h = m;
+	}
+	if(l == 0)
+		return -1;
+
+	/* go back to the first symbol of this address */
+	for(l--; l > 0 && loader->sym_addr[l - 1].value == loader->sym_addr[l].value; l--);
+	return loader->sym_addr[l].index;
+}
+
+
 /* MEMORY_PAGE_SIZE gotten from mem.c,
 !!WARNING!! value could change between archis and between systems */
 #define MEMORY_PAGE_SIZE 4096
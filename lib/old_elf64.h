@@ -33,6 +33,7 @@
 #define GLISS_LOADER_STATE
 #define GLISS_LOADER_INIT(s)
 #define GLISS_LOADER_DESTROY(s)
+#define GLISS_LOADER_COPY(s, src)
 
 /* gliss_loader_t type */
 typedef struct gliss_loader_t gliss_loader_t;
@@ -83,6 +84,8 @@ typedef struct {
 } gliss_loader_sym_t;
 int gliss_loader_count_syms(gliss_loader_t *loader);
 void gliss_loader_sym(gliss_loader_t *loader, int sym, gliss_loader_sym_t *data);
+int gliss_loader_find_sym(gliss_loader_t *loader, const char *name);
+int gliss_loader_find_sym_at(gliss_loader_t *loader, gliss_address_t addr);
 
 
 
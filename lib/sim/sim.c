@@ -20,6 +20,7 @@
  */
 
 #include <stdarg.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -38,6 +39,9 @@ void *alloca(size_t);
 #include <gliss/macros.h>
 #include <gliss/loader.h>
 #include <gliss/id.h>
+#ifdef GLISS_MEM_SPY
+#	include <gliss/mem.h>
+#endif
 
 /* interrupt handler */
 static gliss_sim_t *sim;
@@ -63,11 +67,17 @@ void usage(const char *prog_name) {
 			"  -exit=<hexa_address>] : simulation exit address (default symbol _exit)\n"
 			"  -f, -fast             : Step by step simulation is disable and straightforward execution is prefered (through run_sim())\n"
 			"  -h, -help             : display usage message\n"
+			"  -image=<dir>          : preloaded image cache, the loaded program is saved in <dir> and reused\n"
+			"                          by next runs with the same executable, arguments and environment\n"
             "  -s                    : display user statistics\n"
             "  -more-stats           : display more statistics \n"
             "  -p, -profile=<path>   : generate the file <exec_name>.profile wich contains a statistical array of called instructions.\n"
             "                          Results are added to the file <exec_name>.profile. If the file does not exists it will be created.\n"
             "                          By default <exec_name>.profile is loaded and saved from the caller's current directory\n"
+			"  -sample=<period>:<window> : sampling simulation, fast functional simulation interleaved\n"
+			"                          every <period> instructions with a window of <window> instructions\n"
+			"                          simulated with the detailed options (-p, -v, -V)\n"
+			"  -sample-out=<path>    : output of the per-window statistics (default stderr)\n"
 			"  -start=<hexa_address> : simulation start address (default symbol _start)\n"
 			"  -t time               : stop the simulation after time seconds\n"
 			"  -v, -verbose          : display simulated instructions\n"
@@ -513,6 +523,217 @@ int make_envp(char *path, init_options *options) {
 }
 
 
+/* detailed simulation configuration */
+typedef struct detail_t {
+	int verbose;		/* display the instructions */
+	int *inst_stat;		/* profile counters (or NULL) */
+	int *win_stat;		/* window counters (or NULL) */
+	FILE *vout;			/* validation output (or NULL) */
+} detail_t;
+
+
+/**
+ * Run the simulation with the detailed options (disassembly, profiling,
+ * validation output).
+ * @param sim		Simulator.
+ * @param state		Simulated state.
+ * @param max		Maximum number of instructions to simulate.
+ * @param detail	Detailed options.
+ * @return			Number of simulated instructions.
+ */
+uint64_t run_detailed(gliss_sim_t *sim, gliss_state_t *state, uint64_t max, detail_t *detail) {
+	gliss_inst_t *inst;
+	char buffer[256];
+	uint64_t cnt = 0;
+
+	while(cnt < max && !gliss_is_sim_ended(sim)) {
+		inst = gliss_next_inst(sim);
+		if(detail->inst_stat)
+			detail->inst_stat[inst->ident]++;
+		if(detail->win_stat)
+			detail->win_stat[inst->ident]++;
+		if(detail->verbose) {
+			gliss_disasm(buffer, inst);
+			fprintf(stderr, "%08x: %s\n", gliss_next_addr(sim),  buffer);
+		}
+		if(detail->vout)
+			gliss_output_state_valid(state, detail->vout);
+		gliss_free_inst(inst);
+		gliss_step(sim);
+		cnt++;
+	}
+	return cnt;
+}
+
+
+#ifdef GLISS_MEM_SPY
+/* memory accesses of a sampling window */
+typedef struct mem_count_t {
+	uint64_t reads, writes;
+} mem_count_t;
+
+/**
+ * Spy function counting the memory accesses.
+ */
+static void count_spy(gliss_memory_t *mem, gliss_address_t addr, gliss_size_t size, gliss_access_t access, void *data) {
+	mem_count_t *cnt = (mem_count_t *)data;
+	if(access == gliss_access_read)
+		cnt->reads++;
+	else
+		cnt->writes++;
+}
+#endif
+
+
+/**
+ * Perform a sampling simulation: windows of instructions are simulated with
+ * the detailed options at regular periods and the remaining instructions are
+ * simulated by the fast functional loop. The statistics of each window are
+ * output to sout.
+ * @param sim		Simulator.
+ * @param state		Simulated state.
+ * @param period	Sampling period (in instructions).
+ * @param window	Window size (in instructions).
+ * @param detail	Detailed options.
+ * @param sout		Statistics output.
+ * @return			Number of simulated instructions.
+ */
+uint64_t run_sampling(gliss_sim_t *sim, gliss_state_t *state, uint64_t period, uint64_t window, detail_t *detail, FILE *sout) {
+	int win_stat[GLISS_INSTRUCTIONS_NB];
+	uint64_t cnt = 0, fast_cnt = 0, n;
+	int win = 0, i, top, kinds;
+	struct timeval start, end, delay;
+	gliss_stop_t reason;
+#	ifdef GLISS_MEM_SPY
+		mem_count_t mcnt;
+		gliss_memory_t *mem = gliss_get_memory(gliss_platform(state), GLISS_MAIN_MEMORY);
+#	endif
+
+	detail->win_stat = win_stat;
+	fprintf(sout, "# window\tstart\tcount\ttime (us)\tkinds\ttop instruction");
+#	ifdef GLISS_MEM_SPY
+		fprintf(sout, "\treads\twrites");
+#	endif
+	fputc('\n', sout);
+
+	while(!gliss_is_sim_ended(sim)) {
+
+		/* fast-forward */
+		n = gliss_run_n(sim, period - window, &reason);
+		cnt += n;
+		fast_cnt += n;
+		if(reason != GLISS_STOP_BUDGET)
+			continue;
+
+		/* detailed window */
+		memset(win_stat, 0, sizeof(win_stat));
+#		ifdef GLISS_MEM_SPY
+			mcnt.reads = mcnt.writes = 0;
+			gliss_mem_set_spy(mem, count_spy, &mcnt);
+#		endif
+		gettimeofday(&start, NULL);
+		n = run_detailed(sim, state, window, detail);
+		gettimeofday(&end, NULL);
+#		ifdef GLISS_MEM_SPY
+			gliss_mem_set_spy(mem, NULL, NULL);
+#		endif
+
+		/* window statistics */
+		timersub(&end, &start, &delay);
+		for(i = 0, top = 0, kinds = 0; i < GLISS_INSTRUCTIONS_NB; i++) {
+			if(win_stat[i] != 0)
+				kinds++;
+			if(win_stat[i] > win_stat[top])
+				top = i;
+		}
+		fprintf(sout, "%d\t%lu\t%lu\t%lu\t%d\t%s",
+			win, (unsigned long)cnt, (unsigned long)n,
+			(unsigned long)(delay.tv_sec * 1000000 + delay.tv_usec),
+			kinds, gliss_get_string_ident(top));
+#		ifdef GLISS_MEM_SPY
+			fprintf(sout, "\t%lu\t%lu", (unsigned long)mcnt.reads, (unsigned long)mcnt.writes);
+#		endif
+		fputc('\n', sout);
+		cnt += n;
+		win++;
+	}
+
+	fprintf(sout, "# %d windows, %lu detailed instructions, %lu fast instructions\n",
+		win, (unsigned long)(cnt - fast_cnt), (unsigned long)fast_cnt);
+	detail->win_stat = NULL;
+	return cnt;
+}
+
+
+/* FNV-1a hashing of the image keys */
+#define IMAGE_KEY_INIT	0xcbf29ce484222325ULL
+#define IMAGE_KEY_PRIME	0x100000001b3ULL
+
+static uint64_t image_hash(uint64_t h, const void *buf, size_t size) {
+	const unsigned char *p = (const unsigned char *)buf;
+	for(; size != 0; size--, p++)
+		h = (h ^ *p) * IMAGE_KEY_PRIME;
+	return h;
+}
+
+
+/**
+ * Compute the key of the preloaded image of a program: hash of the
+ * simulator build, of the executable content, of the arguments and
+ * of the environment.
+ * @param path		Executable path.
+ * @param options	Arguments and environment.
+ * @param key		Computed key.
+ * @return			0 for success, -1 if the executable cannot be read.
+ */
+static int image_key(const char *path, init_options *options, uint64_t *key) {
+	const char *build = GLISS_PROC_NAME " " __DATE__ " " __TIME__;
+	uint64_t h = image_hash(IMAGE_KEY_INIT, build, strlen(build) + 1);
+	char buf[4096];
+	size_t size;
+	int i;
+
+	/* executable */
+	FILE *in = fopen(path, "rb");
+	if(in == NULL)
+		return -1;
+	while((size = fread(buf, 1, sizeof(buf), in)) != 0)
+		h = image_hash(h, buf, size);
+	fclose(in);
+
+	/* arguments and environment */
+	h = image_hash(h, &options->argc, sizeof(options->argc));
+	for(i = 0; i < options->argc; i++)
+		h = image_hash(h, options->argv[i], strlen(options->argv[i]) + 1);
+	for(i = 0; options->envp[i] != NULL; i++)
+		h = image_hash(h, options->envp[i], strlen(options->envp[i]) + 1);
+
+	*key = h;
+	return 0;
+}
+
+
+/**
+ * Build the path of the preloaded image of a program.
+ * @param dir		Image directory.
+ * @param path		Executable path.
+ * @param key		Image key.
+ * @return			Allocated path (to free).
+ */
+static char *image_name(const char *dir, const char *path, uint64_t key) {
+	const char *base = strrchr(path, '/');
+	char *name;
+	base = base == NULL ? path : base + 1;
+	name = (char *)malloc(strlen(dir) + strlen(base) + 32);
+	if(name == NULL) {
+		error("ERROR: cannot allocate memory\n");
+		exit(2);
+	}
+	sprintf(name, "%s/%s-%016llx.img", dir, base, (unsigned long long)key);
+	return name;
+}
+
+
 int main(int argc, char **argv) {
     gliss_state_t *state = 0;
     gliss_platform_t *platform = 0;
@@ -545,6 +766,14 @@ int main(int argc, char **argv) {
     int more_stat = 0;
     int valid = 0;
 	const char *valid_path = NULL;
+	uint64_t sample_period = 0, sample_window = 0;
+	const char *sample_path = NULL;
+	const char *image_dir = NULL;
+	char *image_path = NULL;
+	uint64_t key = 0;
+	gliss_address_t image_exit;
+	int image_loaded = 0;
+	detail_t detail = { 0, NULL, NULL, NULL };
 	uint64_t inst_cnt = 0;
 	uint64_t start_time=0, end_time, delay = 0;
 	uint64_t start_sys_time=0, end_sys_time, sys_delay = 0;
@@ -609,6 +838,23 @@ int main(int argc, char **argv) {
 		else if(strcmp(argv[i], "-s") == 0)
 			stats = 1;
 
+		/* -sample=<period>:<window> option */
+		else if(strncmp(argv[i], "-sample=", 8) == 0) {
+			sample_period = strtoull(argv[i] + 8, &c_ptr, 10);
+			if(*c_ptr == ':')
+				sample_window = strtoull(c_ptr + 1, &c_ptr, 10);
+			if(*c_ptr != '\0' || sample_window == 0 || sample_window > sample_period) {
+				syntax_error(argv[0], "bad sampling specified : %s, <period>:<window> with 0 < window <= period required\n", argv[i]);
+				return 2;
+			}
+		}
+		else if(strncmp(argv[i], "-sample-out=", 12) == 0)
+			sample_path = argv[i] + 12;
+
+		/* -image=<dir> option */
+		else if(strncmp(argv[i], "-image=", 7) == 0)
+			image_dir = argv[i] + 7;
+
 		/* -t option */
 		else if(strcmp(argv[i], "-t") == 0) {
 			i++;
@@ -650,44 +896,6 @@ int main(int argc, char **argv) {
 		return 2;
 	}
 
-	/* open the exec file */
-    loader = gliss_loader_open(argv[prog_index]);
-	if(loader == NULL) {
-		fprintf(stderr, "ERROR: cannot open program %s\n", argv[prog_index]);
-		return 2;
-	}
-
-	/* find the _start symbol if no start address is given */
-	if(!is_start_given)
-        addr_start = gliss_loader_start(loader);
-	if(verbose)
-		printf("START=%08x\n", addr_start);
-
-	/* find the _exit symbol if no exit address is given */
-	if (!is_exit_given) {
-		int found = 0;
-
-		/* search symbol _exit */
-        for(sym_exit = 0; sym_exit < gliss_loader_count_syms(loader); sym_exit++) {
-            gliss_loader_sym_t data;
-            gliss_loader_sym(loader, sym_exit, &data);
-			if(strcmp(data.name, "_exit") == 0) {
-				/* we found _exit */
-				addr_exit = data.value;
-				found = 1;
-				break;
-			}
-		}
-
-		/* check for error */
-		if(!found) {
-			syntax_error(argv[0], "ERROR: cannot find the \"_exit\" symbol and no exit address is given.\n");
-			return 2;
-		}
-	}
-	if(verbose)
-		printf("EXIT=%08x\n", addr_exit);
-
 	options.argv = options.envp = 0;
 
 	/* prepare the simulated argv */
@@ -700,9 +908,6 @@ int main(int argc, char **argv) {
 	if(make_envp(buffer, &options) < 0)
 		return 1;
 
-	/* close loader file */
-    gliss_loader_close(loader);
-
 	/* make the platform */
     platform = gliss_new_platform();
 	if (platform == NULL)  {
@@ -710,19 +915,78 @@ int main(int argc, char **argv) {
 		return 2;
 	}
 
-	/* initialize system options */
-    copy_options_to_gliss_env(gliss_get_sys_env(platform), &options);
+	/* look for a preloaded image */
+	if(image_dir != NULL) {
+		if(image_key(argv[prog_index], &options, &key) != 0) {
+			fprintf(stderr, "ERROR: cannot open program %s\n", argv[prog_index]);
+			return 2;
+		}
+		image_path = image_name(image_dir, argv[prog_index], key);
+		if(gliss_load_image(platform, image_path, key, &image_exit) == 0)
+			image_loaded = 1;
+		else {
 
-	/* load the image in the platform */
-    if (gliss_load_platform(platform, argv[prog_index]) == -1) {
-		error("ERROR: cannot load the given executable : %s.\n", argv[i]);
-		return 2;
+			/* may be partially loaded: restart from a fresh platform */
+			gliss_unlock_platform(platform);
+			platform = gliss_new_platform();
+			if (platform == NULL)  {
+				fprintf(stderr, "ERROR: cannot create platform\n");
+				return 2;
+			}
+		}
+	}
+
+	/* load the executable */
+	if(!image_loaded) {
+
+		/* open the exec file */
+		loader = gliss_loader_open(argv[prog_index]);
+		if(loader == NULL) {
+			fprintf(stderr, "ERROR: cannot open program %s\n", argv[prog_index]);
+			return 2;
+		}
+
+		/* find the _start symbol if no start address is given */
+		if(!is_start_given)
+			addr_start = gliss_loader_start(loader);
+
+		/* search symbol _exit */
+		image_exit = 0;
+		sym_exit = gliss_loader_find_sym(loader, "_exit");
+		if(sym_exit >= 0) {
+			gliss_loader_sym_t data;
+			gliss_loader_sym(loader, sym_exit, &data);
+			image_exit = data.value;
+		}
+
+		/* initialize system options */
+		copy_options_to_gliss_env(gliss_get_sys_env(platform), &options);
+
+		/* load the image in the platform */
+		gliss_load(platform, loader);
+
+		/* close loader file */
+		gliss_loader_close(loader);
+
+		/* record the preloaded image */
+		if(image_path != NULL && gliss_save_image(platform, image_path, key, image_exit) != 0)
+			fprintf(stderr, "WARNING: cannot save the image %s: %s\n", image_path, strerror(errno));
+	}
+
+	/* use the _exit symbol if no exit address is given */
+	if(!is_exit_given) {
+		if(image_exit == 0) {
+			syntax_error(argv[0], "ERROR: cannot find the \"_exit\" symbol and no exit address is given.\n");
+			return 2;
+		}
+		addr_exit = image_exit;
 	}
 
 	/* free argv and envp once copied to simulator's memory */
 	if(!argv_str)
 		options.argv = NULL;
 	free_options(&options);
+	free(image_path);
 
 	/* make the state depending on the platform */
     state = gliss_new_state(platform);
@@ -731,6 +995,14 @@ int main(int argc, char **argv) {
 		return 2;
 	}
 
+	/* the start address of a preloaded image is the entry of the platform */
+	if(addr_start == 0)
+		addr_start = state->GLISS_PC_NAME;
+	if(verbose) {
+		printf("START=%08x\n", addr_start);
+		printf("EXIT=%08x\n", addr_exit);
+	}
+
 	/* make the simulator */
     sim = gliss_new_sim(state, addr_start, addr_exit);
 	if (sim == NULL) {
@@ -788,7 +1060,7 @@ int main(int argc, char **argv) {
 #	endif
 
 	/* full speed simulation */
-    if(!verbose && !profile && !valid)
+    if(!verbose && !profile && !valid && !sample_period)
     {
 
 			if(fast_sim)
@@ -805,11 +1077,10 @@ int main(int argc, char **argv) {
 
 	}
 
-	/* verbose simulation */
+	/* verbose or sampling simulation */
 	else
 	{
-        gliss_inst_t *inst;
-		FILE *vout = stderr;
+		FILE *vout = stderr, *sout = stderr;
 
 		/* prepare validation output */
         if(valid) {
@@ -821,22 +1092,26 @@ int main(int argc, char **argv) {
 				}
 			}
 			gliss_output_header_valid(vout);
+			detail.vout = vout;
 		}
+		detail.verbose = verbose;
+		if(profile)
+			detail.inst_stat = inst_stat;
 
 		/* perform the simulation */
-        while(!gliss_is_sim_ended(sim)) {
-            inst = gliss_next_inst(sim);
-            if( profile )
-                inst_stat[inst->ident]++;
-            if(verbose) {
-                gliss_disasm(buffer, inst);
-                fprintf(stderr, "%08x: %s\n", gliss_next_addr(sim),  buffer);
-            }
-            if(valid)
-				gliss_output_state_valid(state, vout);
-            gliss_free_inst(inst);
-            gliss_step(sim);
-			inst_cnt++;
+		if(!sample_period)
+			inst_cnt += run_detailed(sim, state, (uint64_t)-1, &detail);
+		else {
+			if(sample_path != NULL) {
+				sout = fopen(sample_path, "w");
+				if(sout == NULL) {
+					fprintf(stderr, "ERROR: %s cannot be opened!\n", sample_path);
+					exit(EXIT_FAILURE);
+				}
+			}
+			inst_cnt += run_sampling(sim, state, sample_period, sample_window, &detail, sout);
+			if(sout != stderr)
+				fclose(sout);
 		}
 		
 		/* close the valid output */
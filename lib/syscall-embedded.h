@@ -31,6 +31,7 @@
 #define GLISS_SYSCALL_STATE
 #define GLISS_SYSCALL_INIT(pf)
 #define GLISS_SYSCALL_DESTROY(pf)
+#define GLISS_SYSCALL_COPY(pf, src)
 
 void gliss_syscall(gliss_inst_t *inst, gliss_state_t *state);
 void gliss_set_brk(gliss_platform_t *pf, gliss_address_t address);
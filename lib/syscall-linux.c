@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -363,6 +364,139 @@ void gliss_syscall_destroy(gliss_platform_t *pf) {
 }
 
 
+/**
+ * Initialize the system call state of a forked platform from the state
+ * of the original platform: opened FDs are duplicated.
+ * @param pf	Forked platform.
+ * @param src	Original platform.
+ */
+void gliss_syscall_copy(gliss_platform_t *pf, gliss_platform_t *src) {
+	int i;
+
+	/* FD copy */
+	for(i = 0; i < GLISS_FD_COUNT; i++)
+		pf->fds[i] = src->fds[i] == -1 ? -1 : dup(src->fds[i]);
+
+	/* BRK base and running copy */
+	pf->brk_base = src->brk_base;
+	pf->running = src->running;
+}
+
+
+/* kinds of saved FD */
+#define FD_CLOSED	0	/* not opened */
+#define FD_KEPT		1	/* not a regular file: the FD of the restored platform is kept */
+#define FD_FILE		2	/* regular file: re-opened at restore */
+
+/**
+ * Save the system call state for a checkpoint: the FDs of regular files
+ * are saved as path, opening flags and offset.
+ * @param pf	Saved platform.
+ * @param out	Stream to write to.
+ * @return		0 for success, -1 for error.
+ */
+int gliss_syscall_save(gliss_platform_t *pf, FILE *out) {
+	uint64_t brk = pf->brk_base;
+	int32_t header[2];
+	char link[32], path[PATH_MAX];
+	struct stat st;
+	int64_t offset;
+	ssize_t len;
+	uint32_t size;
+	int i;
+
+	if(fwrite(&brk, sizeof(brk), 1, out) != 1
+	|| fwrite(&pf->running, sizeof(pf->running), 1, out) != 1)
+		return -1;
+	for(i = 0; i < GLISS_FD_COUNT; i++) {
+
+		/* find the kind */
+		header[0] = FD_CLOSED;
+		header[1] = 0;
+		len = -1;
+		if(pf->fds[i] != -1) {
+			header[0] = FD_KEPT;
+			snprintf(link, sizeof(link), "/proc/self/fd/%d", pf->fds[i]);
+			if(fstat(pf->fds[i], &st) == 0 && S_ISREG(st.st_mode)
+			&& (len = readlink(link, path, sizeof(path))) > 0 && len < sizeof(path)) {
+				header[0] = FD_FILE;
+				header[1] = fcntl(pf->fds[i], F_GETFL);
+			}
+		}
+		if(fwrite(header, sizeof(header), 1, out) != 1)
+			return -1;
+
+		/* save the file */
+		if(header[0] == FD_FILE) {
+			size = len;
+			offset = lseek(pf->fds[i], 0, SEEK_CUR);
+			if(fwrite(&offset, sizeof(offset), 1, out) != 1
+			|| fwrite(&size, sizeof(size), 1, out) != 1
+			|| fwrite(path, size, 1, out) != 1)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * Restore the system call state saved by gliss_syscall_save(). The regular
+ * files are re-opened (without creation or truncation) at their saved offset;
+ * FDs that cannot be re-opened are closed.
+ * @param pf	Restored platform.
+ * @param in	Stream to read from.
+ * @return		0 for success, -1 for error.
+ */
+int gliss_syscall_restore(gliss_platform_t *pf, FILE *in) {
+	uint64_t brk;
+	int32_t header[2];
+	char path[PATH_MAX];
+	int64_t offset;
+	uint32_t size;
+	int i, fd;
+
+	if(fread(&brk, sizeof(brk), 1, in) != 1
+	|| fread(&pf->running, sizeof(pf->running), 1, in) != 1)
+		return -1;
+	pf->brk_base = brk;
+	for(i = 0; i < GLISS_FD_COUNT; i++) {
+		if(fread(header, sizeof(header), 1, in) != 1)
+			return -1;
+		switch(header[0]) {
+		case FD_KEPT:
+			break;
+		case FD_CLOSED:
+			if(pf->fds[i] != -1) {
+				close(pf->fds[i]);
+				fd_delete(pf, i);
+			}
+			break;
+		case FD_FILE:
+			if(fread(&offset, sizeof(offset), 1, in) != 1
+			|| fread(&size, sizeof(size), 1, in) != 1
+			|| size >= sizeof(path)
+			|| fread(path, size, 1, in) != 1)
+				return -1;
+			path[size] = '\0';
+			if(pf->fds[i] != -1) {
+				close(pf->fds[i]);
+				fd_delete(pf, i);
+			}
+			fd = open(path, header[1] & ~(O_CREAT | O_TRUNC | O_EXCL));
+			if(fd >= 0) {
+				lseek(fd, offset, SEEK_SET);
+				pf->fds[i] = fd;
+			}
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
 // some global variables for syscall
 static BOOL swap = FALSE;
 
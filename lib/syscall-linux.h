@@ -22,6 +22,7 @@
 #ifndef GLISS_SYSCALL_LINUX_H
 #define GLISS_SYSCALL_LINUX_H
 
+#include <stdio.h>
 #include "api.h"
 #include "mem.h"
 
@@ -40,9 +41,15 @@
 
 #define GLISS_SYSCALL_INIT(pf)		gliss_syscall_init(pf)
 #define GLISS_SYSCALL_DESTROY(pf)	gliss_syscall_destroy(pf)
+#define GLISS_SYSCALL_COPY(pf, src)	gliss_syscall_copy(pf, src)
+#define GLISS_SYSCALL_SAVE(pf, out)	gliss_syscall_save(pf, out)
+#define GLISS_SYSCALL_RESTORE(pf, in)	gliss_syscall_restore(pf, in)
 
 void gliss_syscall_init(gliss_platform_t *pf);
 void gliss_syscall_destroy(gliss_platform_t *pf);
+void gliss_syscall_copy(gliss_platform_t *pf, gliss_platform_t *src);
+int gliss_syscall_save(gliss_platform_t *pf, FILE *out);
+int gliss_syscall_restore(gliss_platform_t *pf, FILE *in);
 void gliss_syscall(gliss_inst_t *inst, gliss_state_t *state);
 void gliss_set_brk(gliss_platform_t *pf, gliss_address_t address);
 
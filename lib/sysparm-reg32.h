@@ -32,6 +32,7 @@
 #define GLISS_SYSPARM_STATE
 #define GLISS_SYSPARM_INIT(s)
 #define GLISS_SYSPARM_DESTROY(s)
+#define GLISS_SYSPARM_COPY(s, src)
 
 /* gliss_sysparm_t structure */
 typedef int gliss_sysparm_t;
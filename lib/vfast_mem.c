@@ -166,6 +166,8 @@ typedef struct page_entry_t
     gliss_address_t      addr;
     struct page_entry_t* next;
     uint8_t*             storage;//[MEM_PAGE_SIZE];// ça change quoi de faire un tableau
+    int                  watched;	/* watched by gliss_mem_watch() */
+    int                  dirty;		/* written since gliss_mem_clear_dirty() */
 
 } page_entry_t;
 
@@ -189,8 +191,191 @@ typedef struct gliss_memory_t
 	gliss_mem_spy_t spy_fun;	/** spy function */
 	void *spy_data;				/** spy data */
 #endif
+	struct memory_chunk_t *chunks;	/* allocated pages */
+	uint32_t watch_stamp;			/* count of writes to watched pages */
+	struct memory_watcher_t *watchers;	/* functions called on these writes */
 } memory_64_t;
 
+/* function called at the first write to a watched page */
+typedef struct memory_watcher_t {
+	struct memory_watcher_t *next;
+	gliss_mem_watcher_t fun;
+	void *data;
+} memory_watcher_t;
+
+/* PAGE POOL */
+
+/*
+ * Pages are not allocated one by one but by chunks of MEMORY_CHUNK_PAGES
+ * pages: a chunk contains the page descriptors and a page-aligned block
+ * of storage. The chunks of a memory are released at once when the memory
+ * is deleted and up to MEMORY_POOL_KEEP chunks are kept in a free list
+ * to be reused by the next memories, avoiding to go back to the system
+ * allocator when platforms are repeatedly created and deleted.
+ */
+
+/* number of pages in a chunk */
+#ifndef MEMORY_CHUNK_PAGES
+#	define MEMORY_CHUNK_PAGES	64
+#endif
+/* maximal number of chunks kept in the free list */
+#ifndef MEMORY_POOL_KEEP
+#	define MEMORY_POOL_KEEP	256
+#endif
+
+typedef struct memory_chunk_t {
+	struct memory_chunk_t *next;
+	int used;						/* number of used pages */
+	void *block;					/* allocated storage block */
+	uint8_t *storage;				/* page-aligned storage */
+	page_entry_t entries[MEMORY_CHUNK_PAGES];
+} memory_chunk_t;
+
+/* free chunks */
+static memory_chunk_t *mem_free_chunks = NULL;
+/* pool statistics */
+static gliss_mem_pool_stats_t mem_pool_stats = { 0, 0, 0, 0, MEMORY_CHUNK_PAGES };
+/* lock of the pool (shared by the memories of all threads) */
+static char mem_pool_locked = 0;
+
+
+/**
+ * Acquire the lock of the page pool.
+ */
+static inline void mem_pool_lock(void) {
+	while(__atomic_test_and_set(&mem_pool_locked, __ATOMIC_ACQUIRE))
+		;
+}
+
+
+/**
+ * Release the lock of the page pool.
+ */
+static inline void mem_pool_unlock(void) {
+	__atomic_clear(&mem_pool_locked, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Get a new chunk, from the free list or from the system.
+ * Must be called with the pool lock.
+ * @return	Allocated chunk (NULL if there is not enough memory).
+ */
+static memory_chunk_t *mem_alloc_chunk(void) {
+	memory_chunk_t *chunk = mem_free_chunks;
+
+	/* reuse a free chunk */
+	if(chunk != NULL) {
+		mem_free_chunks = chunk->next;
+		mem_pool_stats.free_chunks--;
+		mem_pool_stats.reused_chunks++;
+	}
+
+	/* allocate a new chunk */
+	else {
+		chunk = (memory_chunk_t *)malloc(sizeof(memory_chunk_t));
+		if(chunk == NULL)
+			return NULL;
+		chunk->block = malloc(MEMORY_CHUNK_PAGES * MEM_PAGE_SIZE + MEM_PAGE_SIZE);
+		if(chunk->block == NULL) {
+			free(chunk);
+			return NULL;
+		}
+		chunk->storage = (uint8_t *)(((uintptr_t)chunk->block + MEM_PAGE_SIZE - 1) & ~(uintptr_t)(MEM_PAGE_SIZE - 1));
+		mem_pool_stats.system_chunks++;
+	}
+
+	chunk->used = 0;
+	return chunk;
+}
+
+
+/**
+ * Allocate a page descriptor and its storage.
+ * @param mem	Memory to allocate for.
+ * @return		Allocated page entry.
+ */
+static page_entry_t *mem_alloc_page(memory_64_t *mem) {
+	memory_chunk_t *chunk = mem->chunks;
+	page_entry_t *pte;
+	mem_pool_lock();
+
+	/* need a new chunk ? */
+	if(chunk == NULL || chunk->used == MEMORY_CHUNK_PAGES) {
+		chunk = mem_alloc_chunk();
+		assertp(chunk != NULL, "Failed to allocate memory in mem_alloc_page\n");
+		chunk->next = mem->chunks;
+		mem->chunks = chunk;
+	}
+
+	/* allocate the page */
+	pte = &chunk->entries[chunk->used];
+	pte->storage = chunk->storage + chunk->used * MEM_PAGE_SIZE;
+	pte->watched = 0;
+	pte->dirty = 0;
+	chunk->used++;
+	mem_pool_stats.pages++;
+	mem_pool_unlock();
+#	ifndef GLISS_NO_PAGE_INIT
+		memset(pte->storage, 0, MEM_PAGE_SIZE);
+#	endif
+	return pte;
+}
+
+
+/**
+ * Release the chunks of the given memory.
+ * @param mem	Memory to work on.
+ */
+static void mem_free_pages(memory_64_t *mem) {
+	memory_chunk_t *chunk, *next;
+	mem_pool_lock();
+	for(chunk = mem->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		mem_pool_stats.pages -= chunk->used;
+		if(mem_pool_stats.free_chunks < MEMORY_POOL_KEEP) {
+			chunk->next = mem_free_chunks;
+			mem_free_chunks = chunk;
+			mem_pool_stats.free_chunks++;
+		}
+		else {
+			free(chunk->block);
+			free(chunk);
+		}
+	}
+	mem->chunks = NULL;
+	mem_pool_unlock();
+}
+
+
+/**
+ * Get the statistics of the page pool (shared by all memories).
+ * @param stats	Filled with the statistics.
+ * @ingroup memory
+ */
+void gliss_mem_pool_stats(gliss_mem_pool_stats_t *stats) {
+	mem_pool_lock();
+	*stats = mem_pool_stats;
+	mem_pool_unlock();
+}
+
+
+/**
+ * Give back the free chunks of the page pool to the system.
+ * @ingroup memory
+ */
+void gliss_mem_pool_release(void) {
+	mem_pool_lock();
+	while(mem_free_chunks != NULL) {
+		memory_chunk_t *chunk = mem_free_chunks;
+		mem_free_chunks = chunk->next;
+		free(chunk->block);
+		free(chunk);
+	}
+	mem_pool_stats.free_chunks = 0;
+	mem_pool_unlock();
+}
+
 // Functions ----------------------------------------------------------------------------
 
 #ifdef GLISS_MEM_SPY
@@ -253,13 +438,10 @@ void gliss_mem_set_spy(gliss_memory_t *mem, gliss_mem_spy_t fun, void *data) {
  */
 void gliss_mem_delete(gliss_memory_t *memory)
 {
-    int i;
-    page_entry_t* current;
-    page_entry_t* tmp;
-
 	// dump statistics if activated
 #	ifdef STATS
 	{
+		int i;
 		int sum_pages = memory->stats_pages[0],
 			sum_accesses = memory->stats_accesses[0],
 			max_pages = memory->stats_pages[0],
@@ -284,16 +466,11 @@ void gliss_mem_delete(gliss_memory_t *memory)
     // get right type
 	memory_64_t *mem64 = (memory_64_t *)memory;
 
-    for (i=0; i<HASHTABLE_SIZE; i++)
-    {
-        current = mem64->hashtable[i];
-        while ( current != NULL )
-        {
-            free(current->storage);
-            tmp     = current;
-            current = current->next;
-            free(tmp);
-        }
+    mem_free_pages(mem64); // freeing the pages
+	while(mem64->watchers != NULL) {
+		memory_watcher_t *w = mem64->watchers;
+		mem64->watchers = w->next;
+		free(w);
 	}
     free(mem64); // freeing the primary hash table
 }
@@ -319,11 +496,7 @@ static page_entry_t* mem_get_page(memory_64_t* mem, gliss_address_t addr)
 
     if( entry == NULL )
     {
-        entry = (page_entry_t*)malloc( sizeof(page_entry_t) );
-        entry->storage = (uint8_t*)malloc(sizeof(uint8_t) * MEM_PAGE_SIZE);
-#		ifndef GLISS_NO_PAGE_INIT
-        	memset(entry->storage, 0, sizeof(uint8_t) * MEM_PAGE_SIZE); // TODO : Est-ton obligé de garantir ça ??
-#		endif
+        entry = mem_alloc_page(mem);
         entry->next = NULL;
         entry->addr = addr;
         h[hash1] = entry;
@@ -350,11 +523,7 @@ static page_entry_t* mem_get_page(memory_64_t* mem, gliss_address_t addr)
         return entry;
     else
     {
-        tmp = (page_entry_t*)malloc( sizeof(page_entry_t) );
-        tmp->storage = (uint8_t*)malloc(sizeof(uint8_t) * MEM_PAGE_SIZE);
-#		ifndef GLISS_NO_PAGE_INIT
-        	memset(tmp->storage, 0, sizeof(uint8_t) * MEM_PAGE_SIZE); // TODO : Est-ton obligé de garantir ça ??
-#		endif
+        tmp = mem_alloc_page(mem);
         entry->next = tmp;
         tmp->next   = NULL;
         tmp->addr   = addr;
@@ -369,6 +538,91 @@ static page_entry_t* mem_get_page(memory_64_t* mem, gliss_address_t addr)
 }
 
 
+/**
+ * Get the page matching the given address for writing: the page is marked
+ * dirty and the watchers are called if the page is watched.
+ * @param mem	Memory to work on.
+ * @param addr	Address of the page.
+ */
+static inline page_entry_t *mem_get_write_page(memory_64_t *mem, gliss_address_t addr) {
+	page_entry_t *pte = mem_get_page(mem, addr);
+	pte->dirty = 1;
+	if(pte->watched) {
+		memory_watcher_t *w;
+		pte->watched = 0;
+		mem->watch_stamp++;
+		for(w = mem->watchers; w != NULL; w = w->next)
+			w->fun(mem, pte->addr, MEM_PAGE_SIZE, w->data);
+	}
+	return pte;
+}
+
+
+/**
+ * Watch the writes to the page containing the given address: the next
+ * write to this page increments the watch stamp of the memory, calls
+ * the watchers with the page and ends the watch.
+ * @param memory	Memory to work on.
+ * @param address	Address in the watched page.
+ * @ingroup memory
+ */
+void gliss_mem_watch(gliss_memory_t *memory, gliss_address_t address) {
+	mem_get_page((memory_64_t *)memory, address)->watched = 1;
+}
+
+
+/**
+ * Get the watch stamp of the memory, incremented at each first write
+ * to a page watched by gliss_mem_watch().
+ * @param memory	Memory to work on.
+ * @return			Current watch stamp.
+ * @ingroup memory
+ */
+uint32_t gliss_mem_watch_stamp(gliss_memory_t *memory) {
+	return ((memory_64_t *)memory)->watch_stamp;
+}
+
+
+/**
+ * Add a function called at the first write to a page watched by
+ * gliss_mem_watch(), with the address and the size of the page.
+ * The function is called before the write is performed.
+ * @param memory	Memory to work on.
+ * @param fun		Called function.
+ * @param data		Data passed to the function.
+ * @ingroup memory
+ */
+void gliss_mem_add_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data) {
+	memory_64_t *mem = (memory_64_t *)memory;
+	memory_watcher_t *w = (memory_watcher_t *)malloc(sizeof(memory_watcher_t));
+	assertp(w != NULL, "Failed to allocate memory in gliss_mem_add_watcher\n");
+	w->fun = fun;
+	w->data = data;
+	w->next = mem->watchers;
+	mem->watchers = w;
+}
+
+
+/**
+ * Remove a function added by gliss_mem_add_watcher().
+ * @param memory	Memory to work on.
+ * @param fun		Removed function.
+ * @param data		Data passed to the function.
+ * @ingroup memory
+ */
+void gliss_mem_remove_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data) {
+	memory_64_t *mem = (memory_64_t *)memory;
+	memory_watcher_t **p;
+	for(p = &mem->watchers; *p != NULL; p = &(*p)->next)
+		if((*p)->fun == fun && (*p)->data == data) {
+			memory_watcher_t *w = *p;
+			*p = w->next;
+			free(w);
+			return;
+		}
+}
+
+
 /**
  * Copy the current memory.
  * @param   memory	Memory to copy.
@@ -401,6 +655,153 @@ gliss_memory_t* gliss_mem_copy(gliss_memory_t* memory)
 }
 
 
+/**
+ * Write a page record of a memory checkpoint.
+ * @param out		Stream to write to.
+ * @param addr		Address of the page.
+ * @param buf		Page content (in target byte order).
+ * @param size		Page size.
+ * @return			0 for success, -1 for error.
+ */
+static int mem_save_record(FILE *out, uint64_t addr, const void *buf, uint32_t size) {
+	if(fwrite(&addr, sizeof(addr), 1, out) != 1
+	|| fwrite(&size, sizeof(size), 1, out) != 1
+	|| (size != 0 && fwrite(buf, size, 1, out) != 1))
+		return -1;
+	return 0;
+}
+
+
+/**
+ * Test if a page is only made of zeroes (such pages are not saved).
+ * @param buf	Page content.
+ * @param size	Page size (multiple of 8).
+ * @return		Non-zero if the page is null.
+ */
+static int mem_is_null(const void *buf, size_t size) {
+	const uint64_t *p = (const uint64_t *)buf;
+	size_t i;
+	for(i = 0; i < size / sizeof(uint64_t); i++)
+		if(p[i] != 0)
+			return 0;
+	return 1;
+}
+
+
+/**
+ * Save the non-null pages of the memory (used for checkpoints).
+ * The pages are stored in target byte order as a sequence of records
+ * (address, size, content) ended by a record of null size and null address
+ * (a record of null size and non-null address is a padding of address bytes).
+ * @param memory	Memory to save.
+ * @param out		Stream to write to.
+ * @return			0 for success, -1 for error.
+ * @ingroup memory
+ */
+int gliss_mem_save(gliss_memory_t *memory, FILE *out)
+{
+    int i;
+    page_entry_t *pte;
+    uint64_t buf[MEM_PAGE_SIZE / sizeof(uint64_t)];
+
+    for(i = 0; i < HASHTABLE_SIZE; i++)
+        for(pte = memory->hashtable[i]; pte != NULL; pte = pte->next)
+        {
+            gliss_mem_read(memory, pte->addr, buf, MEM_PAGE_SIZE);
+            if(!mem_is_null(buf, MEM_PAGE_SIZE)
+            && mem_save_record(out, pte->addr, buf, MEM_PAGE_SIZE) != 0)
+                return -1;
+        }
+    return mem_save_record(out, 0, NULL, 0);
+}
+
+
+/**
+ * Save the pages written since the last call to gliss_mem_clear_dirty()
+ * (or since the creation of the memory), null or not, in the same format
+ * as gliss_mem_save() (incremental checkpoints).
+ * @param memory	Memory to save.
+ * @param out		Stream to write to.
+ * @return			0 for success, -1 for error.
+ * @ingroup memory
+ */
+int gliss_mem_save_dirty(gliss_memory_t *memory, FILE *out)
+{
+    int i;
+    page_entry_t *pte;
+    uint64_t buf[MEM_PAGE_SIZE / sizeof(uint64_t)];
+
+    for(i = 0; i < HASHTABLE_SIZE; i++)
+        for(pte = memory->hashtable[i]; pte != NULL; pte = pte->next)
+            if(pte->dirty)
+            {
+                gliss_mem_read(memory, pte->addr, buf, MEM_PAGE_SIZE);
+                if(mem_save_record(out, pte->addr, buf, MEM_PAGE_SIZE) != 0)
+                    return -1;
+            }
+    return mem_save_record(out, 0, NULL, 0);
+}
+
+
+/**
+ * Start a new dirty period: the pages are marked as not written.
+ * @param memory	Memory to work on.
+ * @ingroup memory
+ */
+void gliss_mem_clear_dirty(gliss_memory_t *memory)
+{
+    int i;
+    page_entry_t *pte;
+
+    for(i = 0; i < HASHTABLE_SIZE; i++)
+        for(pte = memory->hashtable[i]; pte != NULL; pte = pte->next)
+            pte->dirty = 0;
+}
+
+
+/**
+ * Restore the pages saved by gliss_mem_save() (possibly by another memory module).
+ * The pages are written over the current content of the memory.
+ * @param memory	Memory to restore to.
+ * @param in		Stream to read from.
+ * @return			0 for success, -1 for error (truncated or invalid stream).
+ * @ingroup memory
+ */
+int gliss_mem_restore(gliss_memory_t *memory, FILE *in) {
+	uint64_t addr;
+	uint32_t size;
+	uint8_t *buf = NULL;
+	uint32_t buf_size = 0;
+
+	while(1) {
+		if(fread(&addr, sizeof(addr), 1, in) != 1
+		|| fread(&size, sizeof(size), 1, in) != 1)
+			break;
+		if(size == 0 && addr == 0) {
+			free(buf);
+			return 0;
+		}
+		if(size == 0) {
+			if(fseek(in, addr, SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+		if(size > buf_size) {
+			uint8_t *nbuf = (uint8_t *)realloc(buf, size);
+			if(nbuf == NULL)
+				break;
+			buf = nbuf;
+			buf_size = size;
+		}
+		if(fread(buf, size, 1, in) != 1)
+			break;
+		gliss_mem_write(memory, (gliss_address_t)addr, buf, size);
+	}
+	free(buf);
+	return -1;
+}
+
+
 /**
  * Write a buffer into memory.
  * @param memory	Memory to write into.
@@ -416,7 +817,7 @@ void gliss_mem_write(gliss_memory_t* memory, gliss_address_t address, void* buff
     uint32_t      offset = FMOD(address , MEM_PAGE_SIZE);
     uint32_t      sz     = MEM_PAGE_SIZE - offset;
     memory_64_t*  mem    = (memory_64_t *)memory;
-    page_entry_t* pte    = mem_get_page(mem, address);;
+    page_entry_t* pte    = mem_get_write_page(mem, address);;
 
     if(size > sz)
     {
@@ -428,7 +829,7 @@ void gliss_mem_write(gliss_memory_t* memory, gliss_address_t address, void* buff
 
         while(size >= MEM_PAGE_SIZE)
         {
-            pte = mem_get_page(mem, address);
+            pte = mem_get_write_page(mem, address);
             memcpy(pte->storage, buffer, MEM_PAGE_SIZE);
             size    -= MEM_PAGE_SIZE;
             address += MEM_PAGE_SIZE;
@@ -437,7 +838,7 @@ void gliss_mem_write(gliss_memory_t* memory, gliss_address_t address, void* buff
 
         if(size > 0)
         {
-            pte = mem_get_page(mem, address);
+            pte = mem_get_write_page(mem, address);
             memcpy(pte->storage, buffer, size);
         }
 #       else
@@ -449,7 +850,7 @@ void gliss_mem_write(gliss_memory_t* memory, gliss_address_t address, void* buff
 
             if( sz == 0)
             {
-                pte = mem_get_page(mem, address);
+                pte = mem_get_write_page(mem, address);
                 sz  = MEM_PAGE_SIZE;
             }
         }
@@ -752,7 +1153,7 @@ void gliss_mem_write8(gliss_memory_t* mem, gliss_address_t address, uint8_t val)
 {
     gliss_address_t offset;
     page_entry_t*   pte;
-    pte    = mem_get_page(mem, address);
+    pte    = mem_get_write_page(mem, address);
     offset = FMOD(address, MEM_PAGE_SIZE);
 
 
@@ -782,7 +1183,7 @@ void gliss_mem_write16(gliss_memory_t* mem, gliss_address_t address, uint16_t va
 
 	/* compute address */
     page_entry_t* pte;
-    pte = mem_get_page(mem, address);
+    pte = mem_get_write_page(mem, address);
     offset = FMOD(address, MEM_PAGE_SIZE);
 
 #   if HOST_ENDIANNESS != TARGET_ENDIANNESS
@@ -821,7 +1222,7 @@ void gliss_mem_write32(gliss_memory_t* mem, gliss_address_t address, uint32_t va
     page_entry_t*   pte;
 
 	/* compute address */
-    pte    = mem_get_page(mem, address);
+    pte    = mem_get_write_page(mem, address);
     offset = FMOD(address, MEM_PAGE_SIZE);
 
 #   if HOST_ENDIANNESS != TARGET_ENDIANNESS
@@ -861,7 +1262,7 @@ void gliss_mem_write64(gliss_memory_t *mem, gliss_address_t address, uint64_t va
 
 	/* compute address */
     page_entry_t *pte;
-    pte = mem_get_page(mem, address);
+    pte = mem_get_write_page(mem, address);
     offset = FMOD(address, MEM_PAGE_SIZE);
 
 #   if HOST_ENDIANNESS != TARGET_ENDIANNESS
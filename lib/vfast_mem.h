@@ -23,6 +23,7 @@
 #define GLISS_VFAST_MEM_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stddef.h>
 #include "config.h"
 
@@ -33,6 +34,9 @@
 #define GLISS_MEM_STATE
 #define GLISS_MEM_INIT(s)
 #define GLISS_MEM_DESTROY(s)
+#define GLISS_MEM_COPY(s, src)
+#define GLISS_MEM_CHECKPOINT
+#define GLISS_MEM_WATCH
 
 #define GLISS_VFAST_MEM
 #ifdef GLISS_NO_PAGE_INIT
@@ -48,6 +52,19 @@ gliss_memory_t *gliss_mem_new(void);
 void gliss_mem_delete(gliss_memory_t *memory);
 gliss_memory_t *gliss_mem_copy(gliss_memory_t *memory);
 
+/* checkpoint functions */
+int gliss_mem_save(gliss_memory_t *memory, FILE *out);
+int gliss_mem_restore(gliss_memory_t *memory, FILE *in);
+int gliss_mem_save_dirty(gliss_memory_t *memory, FILE *out);
+void gliss_mem_clear_dirty(gliss_memory_t *memory);
+
+/* write watch of code pages */
+typedef void (*gliss_mem_watcher_t)(gliss_memory_t *memory, gliss_address_t address, uint32_t size, void *data);
+void gliss_mem_watch(gliss_memory_t *memory, gliss_address_t address);
+uint32_t gliss_mem_watch_stamp(gliss_memory_t *memory);
+void gliss_mem_add_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data);
+void gliss_mem_remove_watcher(gliss_memory_t *memory, gliss_mem_watcher_t fun, void *data);
+
 /* read functions */
 uint8_t gliss_mem_read8(gliss_memory_t *, gliss_address_t);
 uint16_t gliss_mem_read16(gliss_memory_t *, gliss_address_t);
@@ -69,6 +86,17 @@ void gliss_mem_writed(gliss_memory_t *, gliss_address_t, double);
 void gliss_mem_writeld(gliss_memory_t *, gliss_address_t, long double);
 void gliss_mem_write(gliss_memory_t *memory, gliss_address_t, void *buf, size_t size);
 
+/* page pool */
+typedef struct gliss_mem_pool_stats_t {
+	size_t pages;			/* pages in use */
+	size_t system_chunks;	/* chunks allocated from the system */
+	size_t reused_chunks;	/* chunks reused from the free list */
+	size_t free_chunks;		/* chunks in the free list */
+	size_t chunk_pages;		/* pages by chunk */
+} gliss_mem_pool_stats_t;
+void gliss_mem_pool_stats(gliss_mem_pool_stats_t *stats);
+void gliss_mem_pool_release(void);
+
 #ifdef GLISS_MEM_SPY
 typedef enum { gliss_access_read, gliss_access_write } gliss_access_t;
 typedef void (*gliss_mem_spy_t)(gliss_memory_t *mem, gliss_address_t addr, gliss_size_t size, gliss_access_t access, void *data);
@@ -33,6 +33,7 @@
 #define GLISS_MEM_STATE
 #define GLISS_MEM_INIT(s)
 #define GLISS_MEM_DESTROY(s)
+#define GLISS_MEM_COPY(s, src)
 
 #define GLISS_VFAST_MEM
 #ifdef GLISS_NO_PAGE_INIT
@@ -14,6 +14,7 @@
 #define GLISS_ENV_STATE
 #define GLISS_ENV_INIT(s)
 #define GLISS_ENV_DESTROY(s)
+#define GLISS_ENV_COPY(s, src)
 
 
 /* system initialization (used internally during platform and state initialization) */
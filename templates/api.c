@@ -4,12 +4,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#if defined(__WIN32) || defined(__WIN64)
+#	include <process.h>
+#	define getpid	_getpid
+#else
+#	include <unistd.h>
+#endif
 #include <$(proc)/api.h>
 #include "platform.h"
 #include <$(proc)/env.h>
 #include <$(proc)/macros.h>
 #include <$(proc)/config.h>
-
+$(if GLISS_JIT)#include "jit.h"
+$(end)
 
 static char *$(proc)_string_ident[] = {
 	"$(PROC)_UNKNOWN"$(foreach instructions),
@@ -94,6 +103,150 @@ $(end)
 }
 
 
+/**
+ * Copy the argv, envp and auxv vectors of a system information
+ * in a single block so that a forked platform does not depend
+ * on the lifetime of the vectors of its parent.
+ * @param env	System information to fix (pointers to the original vectors).
+ * @return		Allocated block (to free) or null if there is no more memory.
+ */
+static void *$(proc)_copy_env_vectors($(proc)_env_t *env) {
+	int argc = 0, envc = 0, auxc = 0, i;
+	size_t size, strs = 0;
+	char *p, **argv, **envp;
+	$(proc)_auxv_t *auxv;
+	void *block;
+
+	/* compute the size */
+	if(env->argv != NULL)
+		for(; env->argv[argc] != NULL; argc++)
+			strs += strlen(env->argv[argc]) + 1;
+	if(env->envp != NULL)
+		for(; env->envp[envc] != NULL; envc++)
+			strs += strlen(env->envp[envc]) + 1;
+	if(env->auxv != NULL)
+		for(; env->auxv[auxc].a_type != 0; auxc++);
+	size = (auxc + 1) * sizeof($(proc)_auxv_t) + (argc + envc + 2) * sizeof(char *) + strs;
+	block = malloc(size);
+	if(block == NULL)
+		return NULL;
+
+	/* perform the copy */
+	auxv = ($(proc)_auxv_t *)block;
+	argv = (char **)(auxv + auxc + 1);
+	envp = argv + argc + 1;
+	p = (char *)(envp + envc + 1);
+	if(auxc != 0)
+		memcpy(auxv, env->auxv, auxc * sizeof($(proc)_auxv_t));
+	memset(&auxv[auxc], 0, sizeof($(proc)_auxv_t));
+	for(i = 0; i < argc; i++) {
+		argv[i] = strcpy(p, env->argv[i]);
+		p += strlen(p) + 1;
+	}
+	argv[argc] = NULL;
+	for(i = 0; i < envc; i++) {
+		envp[i] = strcpy(p, env->envp[i]);
+		p += strlen(p) + 1;
+	}
+	envp[envc] = NULL;
+
+	/* fix the system information */
+	if(env->argv != NULL)
+		env->argv = argv;
+	if(env->envp != NULL)
+		env->envp = envp;
+	if(env->auxv != NULL)
+		env->auxv = auxv;
+	return block;
+}
+
+
+/**
+ * Build a copy of the given platform that may be used for an independent
+ * simulation. The memories are copied lazily (copy-on-write if the memory
+ * module supports it), the system information is deeply copied and
+ * the modules copy their state with their $(PROC)_NAME_COPY() macro
+ * (for example, the opened files).
+ * @param platform	Platform to fork.
+ * @return			Forked platform or null for error (see errno):
+ *					ENOMEM if there is no more memory, ENOSYS if a module
+ *					does not provide a $(PROC)_NAME_COPY() macro.
+ * @note To release the platform, use $(proc)_unlock_platform().
+ */
+$(proc)_platform_t *$(proc)_fork_platform($(proc)_platform_t *platform) {
+	$(proc)_platform_t *pf;
+
+	/* a module without copy would lose its state */
+$(foreach modules)
+#ifndef $(PROC)_$(NAME)_COPY
+	errno = ENOSYS;
+	return NULL;
+#endif
+$(end)
+
+	/* allocation */
+	pf = ($(proc)_platform_t *)calloc(1, sizeof($(proc)_platform_t));
+	if(pf == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	pf->usage = 0;
+
+	/* system information copy */
+	pf->entry = platform->entry;
+	pf->sys_env = malloc(sizeof($(proc)_env_t));
+	if(pf->sys_env == NULL) {
+		errno = ENOMEM;
+		free(pf);
+		return NULL;
+	}
+	memcpy(pf->sys_env, platform->sys_env, sizeof($(proc)_env_t));
+	pf->env_copy = $(proc)_copy_env_vectors(pf->sys_env);
+	if(pf->env_copy == NULL) {
+		errno = ENOMEM;
+		goto fail;
+	}
+
+	/* memory copy */
+$(foreach memories)
+	pf->mems.named.$(name) = $(proc)_mem_copy(platform->mems.named.$(name));
+	if(pf->mems.named.$(name) == NULL) {
+		errno = ENOMEM;
+		goto fail;
+	}
+$(end)
+
+	/* module copy */
+$(foreach modules)
+#ifdef $(PROC)_$(NAME)_COPY
+	$(PROC)_$(NAME)_COPY(pf, platform);
+#endif
+$(end)
+
+#ifdef $(PROC)_FLAT_DECODE
+	/* the pre-decoded code is shared */
+	pf->flat_image = $(proc)_share_flat_image(platform->flat_image);
+#endif
+#ifdef $(PROC)_SHARED_DECODE_CACHE
+	/* the decoded instructions are shared */
+	$(proc)_set_decode_cache(pf, platform->decode_cache);
+#endif
+
+	return pf;
+
+fail:
+	/* the not-yet copied memories are null */
+$(foreach memories)
+	if(pf->mems.named.$(name) != NULL)
+		$(proc)_mem_delete(pf->mems.named.$(name));
+$(end)
+	free(pf->env_copy);
+	free(pf->sys_env);
+	free(pf);
+	return NULL;
+}
+
+
 /**
  * Get a memory in the platform.
  * @param platform	Platform to get memory from.
@@ -154,12 +307,22 @@ $(foreach modules)
 	$(PROC)_$(NAME)_DESTROY(platform);
 $(end)
 
+#ifdef $(PROC)_FLAT_DECODE
+	/* free the pre-decoded code */
+	$(proc)_delete_flat_image(platform->flat_image);
+#endif
+#ifdef $(PROC)_SHARED_DECODE_CACHE
+	/* release the decoded instructions */
+	$(proc)_unlock_decode_cache(platform->decode_cache);
+#endif
+
 	/* free the memories */
 $(foreach memories)
 	$(proc)_mem_delete(platform->mems.named.$(name));
 $(end)
 
 	/* free system info */
+	free(platform->env_copy);
 	free(platform->sys_env);
 
 	/* free the platform */
@@ -179,6 +342,12 @@ void $(proc)_load($(proc)_platform_t *platform, $(proc)_loader_t *loader) {
 	/* load in platform's memory */
 	$(proc)_loader_load(loader, platform);
 
+#ifdef $(PROC)_FLAT_DECODE
+	/* pre-decode the code */
+	$(proc)_delete_flat_image(platform->flat_image);
+	platform->flat_image = $(proc)_new_flat_image(platform, loader);
+#endif
+
 	/* initialize system information */
 	platform->entry = $(proc)_loader_start(loader);
 	$(proc)_set_brk(platform, $(proc)_brk_init(loader));
@@ -344,21 +513,19 @@ $(end)$(end)
 
 
 /**
- * Return a copy of a given state which will be intended for a further simulation,
- * both state will share the same memory
+ * Return a copy of a given state which will be intended for a further simulation:
+ * the new state runs on a fork of the platform (see $(proc)_fork_platform())
+ * so that the memory writes of one state are not seen by the other one
  * and each new state's register will have the same value as in the given state.
  *
- * TODO: we want to be able to simulate on this forked state
- * so we should really care about stack pointer and other address registers
- * used to write data in memory, these should have a different value
- * for each state created as we share the same memory
- *
  * @param	state	the state to fork
- * @return		a fresh allocated copy (to be freed by the caller)
+ * @return		a fresh allocated copy (to be freed by the caller with
+ *				$(proc)_delete_state()) or null if there is no more memory
  */
 $(proc)_state_t *$(proc)_fork_state($(proc)_state_t *state)
 {
 	int i;
+	$(proc)_platform_t *platform;
 
 	if (state == NULL)
 		return NULL;
@@ -371,8 +538,13 @@ $(proc)_state_t *$(proc)_fork_state($(proc)_state_t *state)
 		return NULL;
 	}
 
-	/* copy the platform and lock it */
-	new_state->platform = state->platform;
+	/* fork the platform and lock it */
+	platform = $(proc)_fork_platform(state->platform);
+	if(platform == NULL) {
+		free(new_state);
+		return NULL;
+	}
+	new_state->platform = platform;
 	$(proc)_lock_platform(new_state->platform);
 
 	/* copy all the registers */
@@ -382,10 +554,12 @@ $(foreach registers)$(if !aliased)$(if array)
 $(else)
 	new_state->$(name) = state->$(name);
 $(end)$(end)$(end)
-	/* copy the references to the memory */
+	/* use the memories of the forked platform */
 $(foreach memories)$(if !aliased)
-	new_state->$(NAME) = state->$(NAME);
+	new_state->$(NAME) = platform->mems.named.$(name);
 $(end)$(end)
+
+	return new_state;
 }
 
 
@@ -415,6 +589,459 @@ $(end)$(end)$(end)
 }
 
 
+/* checkpoint format */
+#define $(PROC)_CHECKPOINT_MAGIC	"GLISSCKP"
+#define $(PROC)_IMAGE_MAGIC			"GLISSIMG"
+#define $(PROC)_CHECKPOINT_VERSION	3
+#define $(PROC)_CHECKPOINT_REGS(s)	(0$(foreach registers)$(if !aliased) + sizeof((s)->$(name))$(end)$(end))
+
+/* checkpoint header */
+typedef struct $(proc)_checkpoint_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t regs;
+	char proc[16];
+} $(proc)_checkpoint_header_t;
+
+/* saved environment (the host pointers of $(proc)_env_t are not saved) */
+typedef struct $(proc)_checkpoint_env_t {
+	uint64_t entry;
+	int64_t argc;
+	uint64_t argv_addr;
+	uint64_t envp_addr;
+	uint64_t auxv_addr;
+	uint64_t stack_pointer;
+	uint64_t brk_addr;
+} $(proc)_checkpoint_env_t;
+
+/* checkpoint identification (following the header): a full checkpoint
+ * starts a chain of index 0, the incremental ones follow in the chain */
+typedef struct $(proc)_checkpoint_id_t {
+	uint64_t chain;
+	uint64_t index;
+} $(proc)_checkpoint_id_t;
+
+/* image identification (following the header) */
+typedef struct $(proc)_image_id_t {
+	uint64_t key;
+	uint64_t exit;
+} $(proc)_image_id_t;
+
+
+/**
+ * Build the header of a checkpoint or image file.
+ * @param header	Header to fill.
+ * @param magic		Magic of the file.
+ */
+static void $(proc)_checkpoint_header($(proc)_checkpoint_header_t *header, const char *magic) {
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, magic, sizeof(header->magic));
+	header->version = $(PROC)_CHECKPOINT_VERSION;
+	header->regs = $(PROC)_CHECKPOINT_REGS(($(proc)_state_t *)0);
+	strncpy(header->proc, "$(proc)", sizeof(header->proc) - 1);
+}
+
+
+#ifdef $(PROC)_MEM_CHECKPOINT
+/**
+ * Save the platform part of a checkpoint or of an image: the environment,
+ * the memories and the state of the modules.
+ * @param pf		Platform to save.
+ * @param out		Stream to write to.
+ * @param dirty		If non-zero, only save the memory pages written since
+ * 					the previous checkpoint.
+ * @return			0 for success, -1 for error.
+ */
+static int $(proc)_save_platform_part($(proc)_platform_t *pf, FILE *out, int dirty) {
+	$(proc)_checkpoint_env_t env;
+
+	/* environment */
+	env.entry = pf->entry;
+	env.argc = pf->sys_env->argc;
+	env.argv_addr = pf->sys_env->argv_addr;
+	env.envp_addr = pf->sys_env->envp_addr;
+	env.auxv_addr = pf->sys_env->auxv_addr;
+	env.stack_pointer = pf->sys_env->stack_pointer;
+	env.brk_addr = pf->sys_env->brk_addr;
+	if(fwrite(&env, sizeof(env), 1, out) != 1)
+		return -1;
+
+	/* memories */
+$(foreach memories)
+	if((dirty ? $(proc)_mem_save_dirty(pf->mems.named.$(name), out)
+			  : $(proc)_mem_save(pf->mems.named.$(name), out)) != 0)
+		return -1;
+$(end)
+
+	/* modules */
+$(foreach modules)
+#ifdef $(PROC)_$(NAME)_SAVE
+	if($(PROC)_$(NAME)_SAVE(pf, out) != 0)
+		return -1;
+#endif
+$(end)
+
+	return 0;
+}
+
+
+/**
+ * Restore the platform part of a checkpoint or of an image.
+ * @param pf		Platform to restore to.
+ * @param in		Stream to read from.
+ * @param map		If non-zero and supported by the memory ($(PROC)_MEM_MAP),
+ * 					the pages are mapped from the file instead of being read.
+ * @return			0 for success, -1 for error.
+ */
+static int $(proc)_restore_platform_part($(proc)_platform_t *pf, FILE *in, int map) {
+	$(proc)_checkpoint_env_t env;
+
+	/* environment */
+	if(fread(&env, sizeof(env), 1, in) != 1)
+		return -1;
+	pf->entry = env.entry;
+	pf->sys_env->argc = env.argc;
+	pf->sys_env->argv_addr = env.argv_addr;
+	pf->sys_env->envp_addr = env.envp_addr;
+	pf->sys_env->auxv_addr = env.auxv_addr;
+	pf->sys_env->stack_pointer = env.stack_pointer;
+	pf->sys_env->brk_addr = env.brk_addr;
+
+	/* memories */
+$(foreach memories)
+#ifdef $(PROC)_MEM_MAP
+	if(map) {
+		if($(proc)_mem_restore_map(pf->mems.named.$(name), in) != 0)
+			return -1;
+	}
+	else
+#endif
+	if($(proc)_mem_restore(pf->mems.named.$(name), in) != 0)
+		return -1;
+$(end)
+
+	/* modules */
+$(foreach modules)
+#ifdef $(PROC)_$(NAME)_RESTORE
+	if($(PROC)_$(NAME)_RESTORE(pf, in) != 0)
+		return -1;
+#endif
+$(end)
+
+	return 0;
+}
+#endif
+
+
+/**
+ * Record that the platform is in the state of the given checkpoint:
+ * the next incremental checkpoint only saves the pages written from now.
+ * @param pf		Checkpointed platform.
+ * @param id		Checkpoint identification.
+ */
+static void $(proc)_checkpoint_mark($(proc)_platform_t *pf, $(proc)_checkpoint_id_t *id) {
+$(foreach memories)
+	$(proc)_mem_clear_dirty(pf->mems.named.$(name));
+$(end)
+	pf->ckp_chain = id->chain;
+	pf->ckp_index = id->index;
+}
+
+
+/**
+ * Write a checkpoint file. The file is written aside and renamed
+ * so that a checkpoint mapped by $(proc)_load_checkpoint() is never
+ * overwritten in place.
+ * @param state		State to save.
+ * @param path		Path of the checkpoint file.
+ * @param delta		If non-zero, incremental checkpoint.
+ * @return			0 for success, -1 for error (in errno).
+ */
+static int $(proc)_write_checkpoint($(proc)_state_t *state, const char *path, int delta) {
+#ifndef $(PROC)_MEM_CHECKPOINT
+	errno = ENOSYS;
+	return -1;
+#else
+	$(proc)_platform_t *pf = state->platform;
+	$(proc)_checkpoint_header_t header;
+	$(proc)_checkpoint_id_t id;
+	char *tmp;
+	FILE *out;
+
+	/* identification */
+	if(delta) {
+		if(pf->ckp_chain == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		id.chain = pf->ckp_chain;
+		id.index = pf->ckp_index + 1;
+	}
+	else {
+		id.chain = ((uint64_t)time(NULL) << 32) ^ ((uint64_t)getpid() << 16) ^ (uint64_t)(uintptr_t)pf;
+		if(id.chain == 0)
+			id.chain = 1;
+		id.index = 0;
+	}
+
+	/* open the file aside */
+	tmp = (char *)malloc(strlen(path) + 32);
+	if(tmp == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	sprintf(tmp, "%s.%ld.tmp", path, (long)getpid());
+	out = fopen(tmp, "wb");
+	if(out == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	/* header */
+	$(proc)_checkpoint_header(&header, $(PROC)_CHECKPOINT_MAGIC);
+	if(fwrite(&header, sizeof(header), 1, out) != 1
+	|| fwrite(&id, sizeof(id), 1, out) != 1)
+		goto error;
+
+	/* registers */
+$(foreach registers)$(if !aliased)
+	if(fwrite(&state->$(name), sizeof(state->$(name)), 1, out) != 1)
+		goto error;
+$(end)$(end)
+
+	/* environment, memories and modules */
+	if($(proc)_save_platform_part(pf, out, delta) != 0)
+		goto error;
+
+	/* publish the checkpoint */
+	if(fclose(out) != 0 || rename(tmp, path) != 0) {
+		remove(tmp);
+		free(tmp);
+		return -1;
+	}
+	free(tmp);
+	$(proc)_checkpoint_mark(pf, &id);
+	return 0;
+
+error:
+	fclose(out);
+	remove(tmp);
+	free(tmp);
+	return -1;
+#endif
+}
+
+
+/**
+ * Save the full simulator state in a binary checkpoint file: the registers,
+ * the non-null pages of the memories, the environment (entry, stack,
+ * argument addresses, brk) and the state of the modules providing
+ * a $(PROC)_NAME_SAVE() macro (like the opened files of syscall-linux).
+ * The checkpoint is host-dependent (byte order and type sizes).
+ * It starts a chain of incremental checkpoints (see $(proc)_save_delta_checkpoint()).
+ * @param state		State to save.
+ * @param path		Path of the checkpoint file.
+ * @return			0 for success, -1 for error (in errno; ENOSYS if the memory
+ *					module does not support checkpoints).
+ */
+int $(proc)_save_checkpoint($(proc)_state_t *state, const char *path) {
+	return $(proc)_write_checkpoint(state, path, 0);
+}
+
+
+/**
+ * Save an incremental checkpoint: as $(proc)_save_checkpoint() but only
+ * the memory pages written since the previous checkpoint saved or loaded
+ * for this state are saved. It must be restored after the checkpoints
+ * preceding it in the chain.
+ * @param state		State to save.
+ * @param path		Path of the checkpoint file.
+ * @return			0 for success, -1 for error (in errno; EINVAL if no checkpoint
+ *					has been saved or loaded before, ENOSYS if the memory
+ *					module does not support checkpoints).
+ */
+int $(proc)_save_delta_checkpoint($(proc)_state_t *state, const char *path) {
+	return $(proc)_write_checkpoint(state, path, 1);
+}
+
+
+/**
+ * Restore a checkpoint saved by $(proc)_save_checkpoint(). The state and its
+ * platform should be fresh and, if the decoder pre-decodes the code, the
+ * same executable must have been loaded in the platform: the saved pages
+ * are written over the memories and the registers, the environment and
+ * the module states are replaced. The simulator must be created after
+ * the restoration. An incremental checkpoint is restored over the state
+ * restored from the previous checkpoint of its chain.
+ * If the memory module supports it ($(PROC)_MEM_MAP), the pages are
+ * mapped copy-on-write from the file (that must not be modified in place
+ * while the state is used).
+ * @param state		State to restore to.
+ * @param path		Path of the checkpoint file.
+ * @return			0 for success, -1 for error (in errno; EINVAL if the file is not
+ *					a checkpoint of this simulator or does not follow the checkpoint
+ *					of the state, ENOSYS if the memory module does not support checkpoints).
+ */
+int $(proc)_load_checkpoint($(proc)_state_t *state, const char *path) {
+#ifndef $(PROC)_MEM_CHECKPOINT
+	errno = ENOSYS;
+	return -1;
+#else
+	$(proc)_platform_t *pf = state->platform;
+	$(proc)_checkpoint_header_t header, expected;
+	$(proc)_checkpoint_id_t id;
+	struct stat st;
+	FILE *in;
+
+	in = fopen(path, "rb");
+	if(in == NULL)
+		return -1;
+
+	/* header */
+	$(proc)_checkpoint_header(&expected, $(PROC)_CHECKPOINT_MAGIC);
+	if(fread(&header, sizeof(header), 1, in) != 1
+	|| memcmp(&header, &expected, sizeof(header)) != 0
+	|| fread(&id, sizeof(id), 1, in) != 1
+	|| (id.index != 0 && (id.chain != pf->ckp_chain || id.index != pf->ckp_index + 1))) {
+		fclose(in);
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* registers */
+$(foreach registers)$(if !aliased)
+	if(fread(&state->$(name), sizeof(state->$(name)), 1, in) != 1)
+		goto error;
+$(end)$(end)
+
+	/* environment, memories and modules (pages of regular files are mapped) */
+	if($(proc)_restore_platform_part(pf, in,
+	fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode)) != 0)
+		goto error;
+
+	fclose(in);
+	$(proc)_checkpoint_mark(pf, &id);
+	return 0;
+
+error:
+	fclose(in);
+	errno = EINVAL;
+	return -1;
+#endif
+}
+
+
+/**
+ * Save a platform just after the loading of a program (memories, environment
+ * with the stack initialization, brk and module states) in an image file
+ * that may be loaded by $(proc)_load_image() to skip the loading of the same
+ * program with the same arguments. The file is written aside and renamed
+ * so that concurrent simulators never see a partial image.
+ * @param platform	Platform to save.
+ * @param path		Path of the image file.
+ * @param key		Key identifying the program and its arguments (computed by the caller).
+ * @param exit_addr	Exit address of the program.
+ * @return			0 for success, -1 for error (in errno; ENOSYS if the memory
+ *					module does not support checkpoints).
+ */
+int $(proc)_save_image($(proc)_platform_t *platform, const char *path, uint64_t key, $(proc)_address_t exit_addr) {
+#ifndef $(PROC)_MEM_CHECKPOINT
+	errno = ENOSYS;
+	return -1;
+#else
+	$(proc)_checkpoint_header_t header;
+	$(proc)_image_id_t id;
+	char *tmp;
+	FILE *out;
+
+	tmp = (char *)malloc(strlen(path) + 32);
+	if(tmp == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	sprintf(tmp, "%s.%ld.tmp", path, (long)getpid());
+	out = fopen(tmp, "wb");
+	if(out == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	/* header and identification */
+	$(proc)_checkpoint_header(&header, $(PROC)_IMAGE_MAGIC);
+	id.key = key;
+	id.exit = exit_addr;
+	if(fwrite(&header, sizeof(header), 1, out) != 1
+	|| fwrite(&id, sizeof(id), 1, out) != 1
+	|| $(proc)_save_platform_part(platform, out, 0) != 0) {
+		fclose(out);
+		goto error;
+	}
+
+	/* publish the image */
+	if(fclose(out) != 0 || rename(tmp, path) != 0)
+		goto error;
+	free(tmp);
+	return 0;
+
+error:
+	remove(tmp);
+	free(tmp);
+	return -1;
+#endif
+}
+
+
+/**
+ * Load an image saved by $(proc)_save_image() in a fresh platform, in place
+ * of $(proc)_load_platform() (the state must be created after). If the memory
+ * module supports it, the pages are mapped copy-on-write from the image file
+ * (that must not be modified in place while the platform is used).
+ * Not supported if the code is pre-decoded ($(PROC)_FLAT_DECODE) as the
+ * pre-decoding requires the executable.
+ * @param platform	Platform to load in.
+ * @param path		Path of the image file.
+ * @param key		Key identifying the program and its arguments.
+ * @param exit_addr	If not null, set to the exit address of the program.
+ * @return			0 for success, -1 for error (in errno; EINVAL if the file is not
+ *					an image of this simulator for the given key, ENOSYS if not supported).
+ */
+int $(proc)_load_image($(proc)_platform_t *platform, const char *path, uint64_t key, $(proc)_address_t *exit_addr) {
+#if !defined($(PROC)_MEM_CHECKPOINT) || defined($(PROC)_FLAT_DECODE)
+	errno = ENOSYS;
+	return -1;
+#else
+	$(proc)_checkpoint_header_t header, expected;
+	$(proc)_image_id_t id;
+	FILE *in;
+
+	in = fopen(path, "rb");
+	if(in == NULL)
+		return -1;
+
+	/* header and identification */
+	$(proc)_checkpoint_header(&expected, $(PROC)_IMAGE_MAGIC);
+	if(fread(&header, sizeof(header), 1, in) != 1
+	|| memcmp(&header, &expected, sizeof(header)) != 0
+	|| fread(&id, sizeof(id), 1, in) != 1
+	|| id.key != key) {
+		fclose(in);
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* environment, memories and modules */
+	if($(proc)_restore_platform_part(platform, in, 1) != 0) {
+		fclose(in);
+		errno = EINVAL;
+		return -1;
+	}
+	if(exit_addr != NULL)
+		*exit_addr = id.exit;
+	fclose(in);
+	return 0;
+#endif
+}
+
 /**
  * Output the header of a CSV validation output.
  * @param out	File to output to.
@@ -483,70 +1110,329 @@ $(proc)_platform_t *$(proc)_platform($(proc)_state_t *state)
 /* simulation functions */
 
 
-/**
- * Create a new simulator structure with the given state
- * @param	state	the state on which we intend to simulate
- * @param	start_addr	the beginning of the execution (useful for executables compiled with no _start symbol),
- *				if null we leave the PC in its previous state given by the loader
- * @param	exit_addr	the explicitly given last instruction address to simulate, if null we will stop running in another way
- */
-$(proc)_sim_t *$(proc)_new_sim($(proc)_state_t *state, $(proc)_address_t start_addr, $(proc)_address_t exit_addr)
-{
-	$(proc)_sim_t *sim;
+/* breakpoints are recorded in bitmaps of pages of $(PROC)_BRK_PAGE_SIZE bytes */
+#define $(PROC)_BRK_PAGE_BITS	12
+#define $(PROC)_BRK_PAGE_SIZE	(1 << $(PROC)_BRK_PAGE_BITS)
+#define $(PROC)_BRK_PAGE_MASK	($(PROC)_BRK_PAGE_SIZE - 1)
+#define $(PROC)_BRK_HASH_SIZE	64
 
-	if (state == NULL)
-		return NULL;
+/* page containing at least one breakpoint */
+typedef struct $(proc)_brk_page_t {
+	struct $(proc)_brk_page_t *next;
+	$(proc)_address_t page;
+	int cnt;
+	uint32_t bits[$(PROC)_BRK_PAGE_SIZE / 32];
+} $(proc)_brk_page_t;
 
-	/* allocate a new simulator */
-	sim = ($(proc)_sim_t *)malloc(sizeof($(proc)_sim_t));
-	if(sim == NULL)
-	{
-		errno = ENOMEM;
-		return NULL;
-	}
+/* set of breakpoints */
+struct $(proc)_brk_t {
+	$(proc)_brk_page_t *hash[$(PROC)_BRK_HASH_SIZE];
+};
 
-	/* link the state to the new simulator */
-	sim->state = state;
+/* breakpoint page of the current execution of a run function */
+typedef struct $(proc)_brk_cur_t {
+	$(proc)_address_t page;
+	$(proc)_brk_page_t *p;		/* NULL if the page has no breakpoint */
+} $(proc)_brk_cur_t;
 
-	/* create a new decoder */
-	sim->decoder = $(proc)_new_decoder($(proc)_platform(state));
-	$(if is_multi_set)$(proc)_set_cond_state(sim->decoder, state);$(end)
-	if (sim->decoder == NULL)
-		return NULL;
-	sim->addr_exit = exit_addr;
-	if (start_addr)
-		sim->state->$(pc_name) = start_addr;
 
-	/* not ended at start */
-	sim->ended = 0;
-	return sim;
+/**
+ * Find the breakpoint page of the given page number.
+ * @param	brks	breakpoint set
+ * @param	page	page number
+ * @return		found page or NULL
+ */
+static $(proc)_brk_page_t *$(proc)_brk_find($(proc)_brk_t *brks, $(proc)_address_t page)
+{
+	$(proc)_brk_page_t *p;
+	for(p = brks->hash[page & ($(PROC)_BRK_HASH_SIZE - 1)]; p != NULL; p = p->next)
+		if(p->page == page)
+			return p;
+	return NULL;
 }
 
 
-//======================================================================
-#if !defined($(PROC)_TRACE_CACHE) && !defined($(PROC)_DTRACE_CACHE)
-
 /**
- * Return the next instruction to be executed by the given simulator
- *
- * this instruction is pointed by the PC
- *
- * @param	sim	the simulator which we simulate within
- * @return		the next instruction to be executed, fully decoded
+ * Test if the given page contains breakpoints.
+ * @param	brks	breakpoint set
+ * @param	page	page number
+ * @return		non-zero if the page contains at least one breakpoint
  */
-$(proc)_inst_t *$(proc)_next_inst($(proc)_sim_t *sim)
+static inline int $(proc)_brk_in_page($(proc)_brk_t *brks, $(proc)_address_t page)
 {
-	/* retrieving the instruction (which is allocated by the decoder) */
-	/* we let the caller check for error */
-	return $(proc)_decode(sim->decoder, sim->state->$(pc_name));
+	$(proc)_brk_page_t *p = $(proc)_brk_find(brks, page);
+	return p != NULL && p->cnt != 0;
 }
 
 
 /**
- * Execute the next instruction in the given simulator.
- * It doesn't check if we reached the last instruction, so it should be done
- * separately using the function $(proc)_is_sim_ended
- * @param	sim	the simulator which we simulate within
+ * Test if there is a breakpoint at the given address.
+ * @param	brks	breakpoint set
+ * @param	addr	tested address
+ * @return		non-zero if there is a breakpoint
+ */
+static inline int $(proc)_brk_at($(proc)_brk_t *brks, $(proc)_address_t addr)
+{
+	uint32_t off = addr & $(PROC)_BRK_PAGE_MASK;
+	$(proc)_brk_page_t *p = $(proc)_brk_find(brks, addr >> $(PROC)_BRK_PAGE_BITS);
+	return p != NULL && (p->bits[off >> 5] & (1U << (off & 31)));
+}
+
+
+/**
+ * Start the breakpoint cursor of a run function at the given address.
+ * @param	brks	breakpoint set
+ * @param	cur		cursor to initialize
+ * @param	addr	start address of the execution
+ */
+static inline void $(proc)_brk_start($(proc)_brk_t *brks, $(proc)_brk_cur_t *cur, $(proc)_address_t addr)
+{
+	cur->page = addr >> $(PROC)_BRK_PAGE_BITS;
+	cur->p = $(proc)_brk_find(brks, cur->page);
+}
+
+
+/**
+ * Test if the execution reaches a breakpoint at the given address.
+ * The breakpoints are only looked up when the execution enters
+ * another page: on a page without breakpoint, this test costs
+ * a single comparison.
+ * @param	brks	breakpoint set
+ * @param	cur		breakpoint cursor of the execution
+ * @param	addr	reached address
+ * @return		non-zero if there is a breakpoint
+ */
+static inline int $(proc)_brk_hit($(proc)_brk_t *brks, $(proc)_brk_cur_t *cur, $(proc)_address_t addr)
+{
+	uint32_t off;
+	if((addr >> $(PROC)_BRK_PAGE_BITS) != cur->page)
+		$(proc)_brk_start(brks, cur, addr);
+	if(cur->p == NULL)
+		return 0;
+	off = addr & $(PROC)_BRK_PAGE_MASK;
+	return cur->p->bits[off >> 5] & (1U << (off & 31));
+}
+
+
+/**
+ * Test if there is a breakpoint in the given address range,
+ * at page granularity. The range must not be bigger than a page.
+ * @param	brks	breakpoint set
+ * @param	addr	base address of the range
+ * @param	size	size of the range (in bytes)
+ * @return		non-zero if a page of the range contains a breakpoint
+ */
+static inline int $(proc)_brk_in_range($(proc)_brk_t *brks, $(proc)_address_t addr, $(proc)_address_t size)
+{
+	$(proc)_address_t first = addr >> $(PROC)_BRK_PAGE_BITS;
+	$(proc)_address_t last = (addr + size - 1) >> $(PROC)_BRK_PAGE_BITS;
+	return $(proc)_brk_in_page(brks, first)
+		|| (last != first && $(proc)_brk_in_page(brks, last));
+}
+
+
+/**
+ * Set the breakpoint bit of an address.
+ * @param sim		Current simulator.
+ * @param address	Breakpoint address.
+ * @return			0 for success, -1 for error (errno set).
+ */
+static int $(proc)_brk_set($(proc)_sim_t *sim, $(proc)_address_t address)
+{
+	$(proc)_brk_t *brks = sim->brks;
+	$(proc)_address_t page = address >> $(PROC)_BRK_PAGE_BITS;
+	uint32_t off = address & $(PROC)_BRK_PAGE_MASK;
+	$(proc)_brk_page_t *p = $(proc)_brk_find(brks, page);
+
+	/* create the page if needed */
+	if(p == NULL) {
+		p = ($(proc)_brk_page_t *)calloc(1, sizeof($(proc)_brk_page_t));
+		if(p == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		p->page = page;
+		p->next = brks->hash[page & ($(PROC)_BRK_HASH_SIZE - 1)];
+		brks->hash[page & ($(PROC)_BRK_HASH_SIZE - 1)] = p;
+	}
+
+	/* set the bit */
+	if(!(p->bits[off >> 5] & (1U << (off & 31)))) {
+		p->bits[off >> 5] |= 1U << (off & 31);
+		p->cnt++;
+$(if GLISS_JIT)		/* translated blocks must stop at the new breakpoint */
+		$(proc)_jit_flush(sim->jit);
+$(end)	}
+	return 0;
+}
+
+
+/**
+ * Clear the breakpoint bit of an address, if any. The emptied pages
+ * are kept until the simulator is deleted as a running function
+ * may point to them (see $(proc)_brk_hit()).
+ * @param sim		Current simulator.
+ * @param address	Breakpoint address.
+ */
+static void $(proc)_brk_clear($(proc)_sim_t *sim, $(proc)_address_t address)
+{
+	uint32_t off = address & $(PROC)_BRK_PAGE_MASK;
+	$(proc)_brk_page_t *p = $(proc)_brk_find(sim->brks, address >> $(PROC)_BRK_PAGE_BITS);
+
+	if(p == NULL || !(p->bits[off >> 5] & (1U << (off & 31))))
+		return;
+	p->bits[off >> 5] &= ~(1U << (off & 31));
+	p->cnt--;
+$(if GLISS_JIT)	$(proc)_jit_flush(sim->jit);
+$(end)}
+
+
+/**
+ * Add a breakpoint: the run functions stop after executing an instruction
+ * whose next PC is a breakpoint. Only the exit address also ends
+ * the simulation. Breakpoints cost nothing on pages without breakpoint.
+ * A breakpoint added while running (for example by a memory watcher)
+ * may be ignored until the execution leaves the current page.
+ * @param sim		Current simulator.
+ * @param address	Breakpoint address.
+ * @return			0 for success, -1 for error (errno set).
+ */
+int $(proc)_add_breakpoint($(proc)_sim_t *sim, $(proc)_address_t address)
+{
+	if(address == sim->addr_exit) {
+		/* kept when the exit address changes */
+		sim->brk_exit = 0;
+		return 0;
+	}
+	return $(proc)_brk_set(sim, address);
+}
+
+
+/**
+ * Remove a breakpoint. Do nothing if there is no breakpoint at this address.
+ * The exit address remains a breakpoint as long as it is the exit address.
+ * @param sim		Current simulator.
+ * @param address	Breakpoint address.
+ */
+void $(proc)_remove_breakpoint($(proc)_sim_t *sim, $(proc)_address_t address)
+{
+	if(address == sim->addr_exit)
+		sim->brk_exit = 1;
+	else
+		$(proc)_brk_clear(sim, address);
+}
+
+
+/**
+ * Test if there is a breakpoint at the given address.
+ * @param sim		Current simulator.
+ * @param address	Tested address.
+ * @return			Non-zero if there is a breakpoint, 0 else.
+ */
+int $(proc)_is_breakpoint($(proc)_sim_t *sim, $(proc)_address_t address)
+{
+	uint32_t off = address & $(PROC)_BRK_PAGE_MASK;
+	$(proc)_brk_page_t *p = $(proc)_brk_find(sim->brks, address >> $(PROC)_BRK_PAGE_BITS);
+	return p != NULL && (p->bits[off >> 5] & (1U << (off & 31)));
+}
+
+
+/**
+ * Called by the run functions when they reach a breakpoint: the simulation
+ * is ended only if the breakpoint is the exit address.
+ * @param	sim	Current simulator.
+ * @return		Stop reason ($(PROC)_STOP_EXIT or $(PROC)_STOP_BREAKPOINT).
+ */
+static inline $(proc)_stop_t $(proc)_brk_reached($(proc)_sim_t *sim)
+{
+	if(sim->addr_exit == sim->state->$(pc_name)) {
+		sim->ended = 1;
+		return $(PROC)_STOP_EXIT;
+	}
+	return $(PROC)_STOP_BREAKPOINT;
+}
+
+
+/**
+ * Create a new simulator structure with the given state
+ * @param	state	the state on which we intend to simulate
+ * @param	start_addr	the beginning of the execution (useful for executables compiled with no _start symbol),
+ *				if null we leave the PC in its previous state given by the loader
+ * @param	exit_addr	the explicitly given last instruction address to simulate, if null we will stop running in another way
+ */
+$(proc)_sim_t *$(proc)_new_sim($(proc)_state_t *state, $(proc)_address_t start_addr, $(proc)_address_t exit_addr)
+{
+	$(proc)_sim_t *sim;
+
+	if (state == NULL)
+		return NULL;
+
+	/* allocate a new simulator */
+	sim = ($(proc)_sim_t *)malloc(sizeof($(proc)_sim_t));
+	if(sim == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* link the state to the new simulator */
+	sim->state = state;
+	sim->trace = NULL;
+$(if GLISS_JIT)	sim->jit = NULL;
+$(end)
+	/* create a new decoder */
+	sim->decoder = $(proc)_new_decoder($(proc)_platform(state));
+	$(if is_multi_set)$(proc)_set_cond_state(sim->decoder, state);$(end)
+	if (sim->decoder == NULL)
+		return NULL;
+
+	/* build the breakpoint set with the exit address */
+	sim->brks = ($(proc)_brk_t *)calloc(1, sizeof($(proc)_brk_t));
+	if(sim->brks == NULL || $(proc)_brk_set(sim, exit_addr) < 0) {
+		free(sim->brks);
+		$(proc)_delete_decoder(sim->decoder);
+		free(sim);
+		errno = ENOMEM;
+		return NULL;
+	}
+	sim->addr_exit = exit_addr;
+	sim->brk_exit = 1;
+	if (start_addr)
+		sim->state->$(pc_name) = start_addr;
+
+	/* not ended at start */
+	sim->ended = 0;
+$(if GLISS_JIT)
+	/* block translator (interpreter only if not supported) */
+	sim->jit = $(proc)_new_jit(sim);
+$(end)	return sim;
+}
+
+
+//======================================================================
+#if !defined($(PROC)_TRACE_CACHE) && !defined($(PROC)_DTRACE_CACHE)
+
+/**
+ * Return the next instruction to be executed by the given simulator
+ *
+ * this instruction is pointed by the PC
+ *
+ * @param	sim	the simulator which we simulate within
+ * @return		the next instruction to be executed, fully decoded
+ */
+$(proc)_inst_t *$(proc)_next_inst($(proc)_sim_t *sim)
+{
+	/* retrieving the instruction (which is allocated by the decoder) */
+	/* we let the caller check for error */
+	return $(proc)_decode(sim->decoder, sim->state->$(pc_name));
+}
+
+
+/**
+ * Execute the next instruction in the given simulator.
+ * It doesn't check if we reached the last instruction, so it should be done
+ * separately using the function $(proc)_is_sim_ended
+ * @param	sim	the simulator which we simulate within
  */
 void $(proc)_step($(proc)_sim_t *sim)
 {
@@ -580,11 +1466,15 @@ $(if !GLISS_NO_MALLOC)
 #ifndef $(PROC)_INF_DECODE_CACHE
 #ifndef $(PROC)_FIXED_DECODE_CACHE
 #ifndef $(PROC)_LRU_DECODE_CACHE
+#ifndef $(PROC)_FLAT_DECODE
+#ifndef $(PROC)_SHARED_DECODE_CACHE
     /* finally free it */
 	$(proc)_free_inst(inst);
 #endif
 #endif
 #endif
+#endif
+#endif
 $(end)
 
 	/* ended ? */
@@ -592,84 +1482,207 @@ $(end)
 		sim->ended = 1;
 }
 
+$(if GLISS_THREADED_DISPATCH)
+/* threaded dispatch: computed goto with GCC "labels as values", switch else */
+#if defined(__GNUC__) && !defined($(PROC)_NO_COMPUTED_GOTO)
+#	define $(PROC)_TD_BEGIN			goto *labels[inst->ident];
+#	define $(PROC)_TD_END
+#	define $(PROC)_TD_LABEL(id)		$(proc)_td_##id:
+#	define $(PROC)_TD_DISPATCH		goto *labels[inst->ident]
+#else
+#	define $(PROC)_TD_BEGIN			for(;;) switch(inst->ident) {
+#	define $(PROC)_TD_END			}
+#	define $(PROC)_TD_LABEL(id)		case $(PROC)_##id:
+#	define $(PROC)_TD_DISPATCH		continue
+#endif
+
+$(if !GLISS_NO_MALLOC)
+#if !defined($(PROC)_INF_DECODE_CACHE) && !defined($(PROC)_FIXED_DECODE_CACHE) && !defined($(PROC)_LRU_DECODE_CACHE) && !defined($(PROC)_FLAT_DECODE) && !defined($(PROC)_SHARED_DECODE_CACHE)
+#	define $(PROC)_TD_FREE(i)		$(proc)_free_inst(i)
+#endif
+$(end)
+#ifndef $(PROC)_TD_FREE
+#	define $(PROC)_TD_FREE(i)
+#endif
+
+/* end of an instruction: count, check end and dispatch the next one */
+#define $(PROC)_TD_NEXT \
+	{ \
+		$(PROC)_TD_FREE(inst); \
+		cnt++; \
+		if($(proc)_brk_hit(brks, &cur, state->$(pc_name))) { \
+			stop = $(proc)_brk_reached(sim); \
+			goto td_end; \
+		} \
+		if(cnt == budget || sim->ended) \
+			goto td_end; \
+		inst = $(proc)_decode(decoder, state->$(pc_name)); \
+		$(PROC)_TD_DISPATCH; \
+	}
+
 /**
- * Straightforward execution of the simulated programm.
- * It runs and count the number of executed instructions
- * until the programm reached the last instruction.
- * this is the <bold> fastest </bold> way to simulate a programm
- * @param	sim	the simulator which we simulate within
- * @return number of executed instructions
- * */
-uint64_t $(proc)_run_and_count_inst($(proc)_sim_t *sim)
+ * Threaded-code execution engine used by $(proc)_run_n()
+ * when GEP switch GLISS_THREADED_DISPATCH is on.
+ * The semantic of each instruction is inlined as a label of this function
+ * and the end of each instruction dispatches directly to the next one,
+ * avoiding the call to the code table.
+ * @param	sim		the simulator which we simulate within
+ * @param	budget	maximal number of instructions to execute
+ * @param	reason	to store the stop reason
+ * @return	number of executed instructions
+ */
+static uint64_t $(proc)_run_threaded($(proc)_sim_t *sim, uint64_t budget, $(proc)_stop_t *reason)
 {
-	uint64_t i = 0;
-    $(proc)_state_t*   state     = sim->state;
-    $(proc)_decoder_t* decoder   = sim->decoder;
-    $(proc)_address_t  addr_exit = sim->addr_exit;
+	uint64_t cnt = 0;
+	$(proc)_stop_t stop = $(PROC)_STOP_BUDGET;
+	$(proc)_state_t*   state     = sim->state;
+	$(proc)_decoder_t* decoder   = sim->decoder;
+	$(proc)_brk_t*     brks      = sim->brks;
+	$(proc)_brk_cur_t  cur;
 	$(proc)_inst_t* inst;
-	while(!sim->ended) {
-		inst = $(proc)_decode(decoder, state->$(pc_name));
-$(if GLISS_PROFILED_JUMPS)
-		switch(inst->ident)
-		{
-			$(foreach profiled_instructions)
+#if defined(__GNUC__) && !defined($(PROC)_NO_COMPUTED_GOTO)
+	static const void *labels[] = {
+		&&$(proc)_td_UNKNOWN$(foreach instructions),
+		&&$(proc)_td_$(IDENT)$(end)
+	};
+#endif
 
-			case $(PROC)_$(IDENT): {
-			$(gen_code)
-			}
-			break;
-			$(end)
-			default:
-			$(proc)_code_table[inst->ident](state, inst);
+	if(budget == 0 || sim->ended)
+		goto td_end;
+	$(proc)_brk_start(brks, &cur, state->$(pc_name));
+	inst = $(proc)_decode(decoder, state->$(pc_name));
+	$(PROC)_TD_BEGIN
+
+	$(PROC)_TD_LABEL(UNKNOWN)
+		$(proc)_code_table[$(PROC)_UNKNOWN](state, inst);
+		$(PROC)_TD_NEXT
+
+$(foreach mapped_instructions)
+	/* $(syntax) */
+	$(PROC)_TD_LABEL($(IDENT))
+		{
+$(gen_code)
 		}
-$(else)
-		$(proc)_code_table[inst->ident](state, inst);
+		$(PROC)_TD_NEXT
+
+$(end)
+	$(PROC)_TD_END
+
+td_end:
+	if(stop == $(PROC)_STOP_BUDGET && sim->ended)
+		stop = $(PROC)_STOP_ENDED;
+	*reason = stop;
+	return cnt;
+}
 $(end)
+$(if GLISS_JIT)
+/**
+ * Execution engine used by $(proc)_run_n() when GEP option -jit is on
+ * and the block translator is available: the translated blocks are
+ * executed as host code, the other instructions are interpreted.
+ * As the translated blocks stop before breakpoints and the chaining
+ * stops at the end of the simulation, the execution stops as
+ * with the interpreter.
+ * @param	sim		the simulator which we simulate within
+ * @param	budget	maximal number of instructions to execute
+ * @param	reason	to store the stop reason
+ * @return	number of executed instructions
+ */
+static uint64_t $(proc)_run_jit($(proc)_sim_t *sim, uint64_t budget, $(proc)_stop_t *reason)
+{
+	uint64_t cnt = 0, left;
+	$(proc)_stop_t stop = $(PROC)_STOP_BUDGET;
+	$(proc)_state_t*   state     = sim->state;
+	$(proc)_decoder_t* decoder   = sim->decoder;
+	$(proc)_brk_t*     brks      = sim->brks;
+	$(proc)_jit_t*     jit       = sim->jit;
+	$(proc)_jit_block_t* block;
+	$(proc)_brk_cur_t  cur;
+	$(proc)_inst_t* inst;
+
+	$(proc)_brk_start(brks, &cur, state->$(pc_name));
+	while(cnt != budget && !sim->ended) {
+		left = budget - cnt;
+		block = $(proc)_jit_get(jit, state->$(pc_name));
+
+		/* translated block if it fits in the budget */
+		if(block != NULL && left >= (uint64_t)block->n)
+			cnt += $(proc)_jit_exec(jit, block,
+				left > $(PROC)_JIT_BLOCK_MAX ? left - $(PROC)_JIT_BLOCK_MAX : 0);
+
+		/* else interpreted instruction */
+		else {
+			inst = $(proc)_decode(decoder, state->$(pc_name));
+			$(proc)_code_table[inst->ident](state, inst);
 $(if !GLISS_NO_MALLOC)
-#ifndef $(PROC)_INF_DECODE_CACHE
-#ifndef $(PROC)_FIXED_DECODE_CACHE
-#ifndef $(PROC)_LRU_DECODE_CACHE
-    /* finally free it */
-	$(proc)_free_inst(inst);
-#endif
-#endif
+#if !defined($(PROC)_INF_DECODE_CACHE) && !defined($(PROC)_FIXED_DECODE_CACHE) && !defined($(PROC)_LRU_DECODE_CACHE) && !defined($(PROC)_FLAT_DECODE) && !defined($(PROC)_SHARED_DECODE_CACHE)
+			$(proc)_free_inst(inst);
 #endif
 $(end)
-		i++;
-		if(addr_exit == state->$(pc_name))
-			sim->ended = 1;
+			cnt++;
+		}
+
+		if($(proc)_brk_hit(brks, &cur, state->$(pc_name))) {
+			stop = $(proc)_brk_reached(sim);
+			break;
+		}
 	}
-	return i;
+	if(stop == $(PROC)_STOP_BUDGET && sim->ended)
+		stop = $(PROC)_STOP_ENDED;
+	*reason = stop;
+	return cnt;
 }
+$(end)
 
 /**
- * Straightforward execution of the simulated programm.
- * It runs until the programm reached the last instruction.
- * this is the <bold> fastest </bold> way to simulate a programm
- * @param	sim	the simulator which we simulate within
- * */
-void $(proc)_run_sim($(proc)_sim_t *sim)
+ * Execute at most budget instructions with the fast execution loop.
+ * The execution stops before if a breakpoint is reached
+ * or if the simulation is ended.
+ * @param	sim		the simulator which we simulate within
+ * @param	budget	maximal number of instructions to execute
+ * @param	reason	if not NULL, store the stop reason
+ * @return	number of executed instructions
+ */
+uint64_t $(proc)_run_n($(proc)_sim_t *sim, uint64_t budget, $(proc)_stop_t *reason)
 {
-	$(proc)_state_t*   state     = sim->state;
+	$(proc)_stop_t stop = $(PROC)_STOP_BUDGET;
+$(if GLISS_JIT)
+	if(sim->jit != NULL) {
+		uint64_t cnt = $(proc)_run_jit(sim, budget, &stop);
+		if(reason != NULL)
+			*reason = stop;
+		return cnt;
+	}
+$(end)
+$(if GLISS_THREADED_DISPATCH)
+	uint64_t cnt = $(proc)_run_threaded(sim, budget, &stop);
+	if(reason != NULL)
+		*reason = stop;
+	return cnt;
+$(else)
+	uint64_t left = budget;
+    $(proc)_state_t*   state     = sim->state;
     $(proc)_decoder_t* decoder   = sim->decoder;
-    $(proc)_address_t  addr_exit = sim->addr_exit;
+    $(proc)_brk_t*     brks      = sim->brks;
+	$(proc)_brk_cur_t  cur;
 	$(proc)_inst_t* inst;
-	while(!sim->ended) {
+
+	$(proc)_brk_start(brks, &cur, state->$(pc_name));
+	while(left != 0 && !sim->ended) {
 		inst = $(proc)_decode(decoder, state->$(pc_name));
 $(if GLISS_PROFILED_JUMPS)
 		switch(inst->ident)
 		{
-$(foreach profiled_instructions)
-			case $(PROC)_$(IDENT):
-			{
-		$(gen_code)
+			$(foreach profiled_instructions)
 
-			}break;
-$(end)
+			case $(PROC)_$(IDENT): {
+			$(gen_code)
+			}
+			break;
+			$(end)
 			default:
 			$(proc)_code_table[inst->ident](state, inst);
 		}
-
 $(else)
 		$(proc)_code_table[inst->ident](state, inst);
 $(end)
@@ -677,16 +1690,30 @@ $(if !GLISS_NO_MALLOC)
 #ifndef $(PROC)_INF_DECODE_CACHE
 #ifndef $(PROC)_FIXED_DECODE_CACHE
 #ifndef $(PROC)_LRU_DECODE_CACHE
+#ifndef $(PROC)_FLAT_DECODE
+#ifndef $(PROC)_SHARED_DECODE_CACHE
     /* finally free it */
-		$(proc)_free_inst(inst);
+	$(proc)_free_inst(inst);
+#endif
+#endif
 #endif
 #endif
 #endif
 $(end)
-		if(addr_exit == state->$(pc_name))
-			sim->ended = 1;
+		left--;
+		if($(proc)_brk_hit(brks, &cur, state->$(pc_name))) {
+			stop = $(proc)_brk_reached(sim);
+			break;
+		}
 	}
+	if(stop == $(PROC)_STOP_BUDGET && sim->ended)
+		stop = $(PROC)_STOP_ENDED;
+	if(reason != NULL)
+		*reason = stop;
+	return budget - left;
+$(end)
 }
+
 #endif
 //======================================================================
 #ifdef $(PROC)_TRACE_CACHE
@@ -747,77 +1774,35 @@ $(end)
 
 
 /**
- * Straightforward execution of the simulated programm.
- * It runs and count the number of executed instructions
- * until the programm reached the last instruction.
- * this is the <bold> fastest </bold> way to simulate a programm
- * @param	sim	the simulator which we simulate within
- * @return number of executed instructions
- * */
-uint64_t $(proc)_run_and_count_inst($(proc)_sim_t *sim)
-{
-	uint64_t i = 0;
-    uint32_t num_bloc;
-    $(proc)_state_t*   state     = sim->state;
-    $(proc)_decoder_t* decoder   = sim->decoder;
-    $(proc)_address_t  addr_exit = sim->addr_exit;
-    $(proc)_inst_t*    inst, *trace;
-
-	while(!sim->ended)
-	{
-        trace    = $(proc)_decode(decoder, state->$(pc_name));
-        num_bloc = (state->$(pc_name) >> 2) >> TRACE_DEPTH_PW;
-
-        while((((state->$(pc_name) >> 2)>> TRACE_DEPTH_PW) == num_bloc) && (!sim->ended) && (addr_exit != state->$(pc_name)))
-        {
-			inst = trace + ((state->NIA >> 2) & (TRACE_DEPTH-1));
-            $(if GLISS_PROFILED_JUMPS)
-			switch(inst->ident)
-			{
-$(foreach profiled_instructions)
-				case $(PROC)_$(IDENT):
-				{
-				$(gen_code)
-
-				}break;
-$(end)
-				default:
-				$(proc)_code_table[inst->ident](state, inst);
-$(end)
-			}
-			i++;
-		}
-
-		/* ended ? */
-		if(addr_exit == state->$(pc_name))
-			sim->ended = 1;
-	}
-	return i;
-}
-
-/**
- * Straightforward execution of the simulated programm.
- * It runs until the programm reached the last instruction.
- * this is the <bold> fastest </bold> way to simulate a programm
- * @param	sim	the simulator which we simulate within
- * */
-void $(proc)_run_sim($(proc)_sim_t *sim)
+ * Execute at most budget instructions with the fast execution loop.
+ * The execution stops before if a breakpoint is reached
+ * or if the simulation is ended.
+ * @param	sim		the simulator which we simulate within
+ * @param	budget	maximal number of instructions to execute
+ * @param	reason	if not NULL, store the stop reason
+ * @return	number of executed instructions
+ */
+uint64_t $(proc)_run_n($(proc)_sim_t *sim, uint64_t budget, $(proc)_stop_t *reason)
 {
+	uint64_t left = budget;
+	$(proc)_stop_t stop = $(PROC)_STOP_BUDGET;
     uint32_t num_bloc;
     $(proc)_state_t*   state     = sim->state;
     $(proc)_decoder_t* decoder   = sim->decoder;
-    $(proc)_address_t  addr_exit = sim->addr_exit;
+    $(proc)_brk_t*     brks      = sim->brks;
+    $(proc)_brk_cur_t  cur;
     $(proc)_inst_t*    inst, *trace;
 
-	while(addr_exit != state->$(pc_name))
+	$(proc)_brk_start(brks, &cur, state->$(pc_name));
+	while(left != 0 && !sim->ended)
 	{
         trace    = $(proc)_decode(decoder, state->$(pc_name));
         num_bloc = (state->$(pc_name) >> 2) >> TRACE_DEPTH_PW;
 
-        while((((state->$(pc_name) >> 2)>> TRACE_DEPTH_PW) == num_bloc) && (addr_exit != state->$(pc_name)))
+		do
         {
 			inst = trace + ((state->NIA >> 2) & (TRACE_DEPTH-1));
-            $(if GLISS_PROFILED_JUMPS)
+$(if GLISS_PROFILED_JUMPS)
 			switch(inst->ident)
 			{
 $(foreach profiled_instructions)
@@ -830,13 +1815,26 @@ $(end)
 				default:
 				$(proc)_code_table[inst->ident](state, inst);
 			}
-
 $(else)
 		    $(proc)_code_table[inst->ident](state, inst);
 $(end)
-        }
+			left--;
+		}
+        while((((state->$(pc_name) >> 2)>> TRACE_DEPTH_PW) == num_bloc) && (!sim->ended) && (left != 0) && !$(proc)_brk_hit(brks, &cur, state->$(pc_name)));
+
+		/* breakpoint ? */
+		if($(proc)_brk_hit(brks, &cur, state->$(pc_name))) {
+			stop = $(proc)_brk_reached(sim);
+			break;
+		}
 	}
+	if(stop == $(PROC)_STOP_BUDGET && sim->ended)
+		stop = $(PROC)_STOP_ENDED;
+	if(reason != NULL)
+		*reason = stop;
+	return budget - left;
 }
+
 #endif
 //======================================================================
 #ifdef $(PROC)_DTRACE_CACHE
@@ -853,20 +1851,19 @@ $(proc)_inst_t *$(proc)_next_inst($(proc)_sim_t *sim)
 	/* retrieving the instruction (which is allocated by the decoder) */
 	/* we let the caller check for error */
 
-	/* Static variable is an optimisation hack
-	 * in order to cache the current trace */
-	static $(proc)_inst_t*  inst = 0;
-	$(proc)_state_t* state = sim->state;
+	/* the current trace of the simulator is used as a cache
+	 * (it is only advanced by $(proc)_step()) */
+	$(proc)_inst_t*  inst = sim->trace;
 
 	/* retrieving next instruction */
 	if(inst != 0)
 	{
 		inst++;
-		if(inst->ident == -1)
-			inst =  $(proc)_decode(sim->decoder, state->$(pc_name));
+		if(inst->ident == -1 || inst->addr != sim->state->$(pc_name))
+			inst =  $(proc)_decode(sim->decoder, sim->state->$(pc_name));
 	}else
 	{
-		inst =  $(proc)_decode(sim->decoder, state->$(pc_name));
+		inst =  $(proc)_decode(sim->decoder, sim->state->$(pc_name));
 	}
 	return inst;
 }
@@ -880,21 +1877,21 @@ $(proc)_inst_t *$(proc)_next_inst($(proc)_sim_t *sim)
  */
 void $(proc)_step($(proc)_sim_t *sim)
 {
-	/* Static variable is an optimisation hack
-	 * in order to cache the current trace */
-	static $(proc)_inst_t*  inst = 0;
+	/* the current trace of the simulator is used as a cache */
+	$(proc)_inst_t*  inst = sim->trace;
 	$(proc)_state_t* state = sim->state;
 
 	/* retrieving next instruction */
 	if(inst != 0)
 	{
 		inst++;
-		if(inst->ident == -1)
+		if(inst->ident == -1 || inst->addr != state->$(pc_name))
 			inst =  $(proc)_decode(sim->decoder, state->$(pc_name));
 	}else
 	{
 		inst =  $(proc)_decode(sim->decoder, state->$(pc_name));
 	}
+	sim->trace = inst;
 
 
 	/* execute it */
@@ -922,103 +1919,186 @@ $(end)
 }
 
 
+/* maximal address range covered by a dynamic trace */
+#define $(PROC)_DTRACE_SPAN		(TRACE_DEPTH * ($(max_instruction_size) >> 3))
+#if $(PROC)_DTRACE_SPAN > $(PROC)_BRK_PAGE_SIZE
+#	error "a dynamic trace must not be bigger than a breakpoint page"
+#endif
+
 /**
- * Straightforward execution of the simulated programm.
- * It runs and count the number of executed instructions
- * until the programm reached the last instruction.
- * this is the <bold> fastest </bold> way to simulate a programm
- * @param	sim	the simulator which we simulate within
- * @return number of executed instructions
- * */
-uint64_t $(proc)_run_and_count_inst($(proc)_sim_t *sim)
+ * Execute a whole dynamic trace (a block ending with a branch) in one loop.
+ * As instructions of a trace are executed in sequence, breakpoints
+ * only need to be checked when the address range of the trace covers a page
+ * containing breakpoints: for other traces, check is 0 and the loop contains
+ * only the dispatch and the end test of the simulation.
+ * @param	sim			the simulator which we simulate within
+ * @param	inst		first instruction of the trace
+ * @param	check		if non-zero, stop on breakpoints or after max instructions
+ * @param	max			maximal number of instructions to execute if check is set
+ * @return	number of executed instructions
+ */
+static inline uint64_t $(proc)_exec_trace($(proc)_sim_t *sim, $(proc)_inst_t *inst, int check, uint64_t max)
 {
 	uint64_t i = 0;
-    $(proc)_state_t*   state     = sim->state;
-    $(proc)_decoder_t* decoder   = sim->decoder;
-    $(proc)_address_t  addr_exit = sim->addr_exit;
-    $(proc)_inst_t*    inst;
+	$(proc)_state_t* state = sim->state;
 
-	while(!sim->ended)
+	while(inst->ident != -1)
 	{
-        inst = $(proc)_decode(decoder, state->$(pc_name));
-
-        while( (inst->ident != -1) && (!sim->ended) && (addr_exit != state->$(pc_name)))
-        {
-            $(if GLISS_PROFILED_JUMPS)
-			switch(inst->ident)
-			{
+$(if GLISS_PROFILED_JUMPS)
+		switch(inst->ident)
+		{
 $(foreach profiled_instructions)
-				case $(PROC)_$(IDENT):
-				{
-				$(gen_code)
+			case $(PROC)_$(IDENT):
+			{
+			$(gen_code)
 
-				}break;
+			}break;
 $(end)
-				default:
-				$(proc)_code_table[inst->ident](state, inst);
+			default:
+			$(proc)_code_table[inst->ident](state, inst);
 		}
 $(else)
-		    $(proc)_code_table[inst->ident](state, inst);
+		$(proc)_code_table[inst->ident](state, inst);
 $(end)
-			inst++;
-			i++;
-        }
+		inst++;
+		i++;
+		if(sim->ended)
+			break;
+		if(check && (i >= max || $(proc)_brk_at(sim->brks, state->$(pc_name))))
+			break;
+	}
+	return i;
+}
 
-        /* ended ? */
-		if(addr_exit == state->$(pc_name))
-			sim->ended = 1;
 
+/**
+ * Execute at most budget instructions with the fast execution loop.
+ * The execution stops before if a breakpoint is reached
+ * or if the simulation is ended.
+ * @param	sim		the simulator which we simulate within
+ * @param	budget	maximal number of instructions to execute
+ * @param	reason	if not NULL, store the stop reason
+ * @return	number of executed instructions
+ */
+uint64_t $(proc)_run_n($(proc)_sim_t *sim, uint64_t budget, $(proc)_stop_t *reason)
+{
+	uint64_t left = budget;
+	$(proc)_stop_t stop = $(PROC)_STOP_BUDGET;
+    $(proc)_state_t*   state     = sim->state;
+    $(proc)_decoder_t* decoder   = sim->decoder;
+    $(proc)_brk_t*     brks      = sim->brks;
+    $(proc)_inst_t*    trace;
+
+	if(left != 0 && !sim->ended)
+	{
+		trace = $(proc)_decode(decoder, state->$(pc_name));
+		while(1)
+		{
+			/* breakpoints and budget are only checked at block entry,
+			 * inside the block if it covers a breakpoint page or may exhaust the budget */
+			left -= $(proc)_exec_trace(sim, trace,
+				left < TRACE_DEPTH || $(proc)_brk_in_range(brks, state->$(pc_name), $(PROC)_DTRACE_SPAN),
+				left);
+
+			/* breakpoint ? */
+			if($(proc)_brk_at(brks, state->$(pc_name))) {
+				stop = $(proc)_brk_reached(sim);
+				break;
+			}
+			if(left == 0 || sim->ended)
+				break;
+
+			/* follow the trace chain */
+			trace = $(proc)_decode_next(decoder, trace, state->$(pc_name));
+		}
 	}
-	return i;
+	if(stop == $(PROC)_STOP_BUDGET && sim->ended)
+		stop = $(PROC)_STOP_ENDED;
+	if(reason != NULL)
+		*reason = stop;
+
+	/* the trace used by $(proc)_step() is no more the current one */
+	sim->trace = NULL;
+	return budget - left;
+}
+
+#endif
+//======================================================================
+/**
+ * Straightforward execution of the simulated programm.
+ * It runs and count the number of executed instructions
+ * until the programm reached the last instruction (or a breakpoint).
+ * this is the <bold> fastest </bold> way to simulate a programm
+ * @param	sim	the simulator which we simulate within
+ * @return number of executed instructions
+ * */
+uint64_t $(proc)_run_and_count_inst($(proc)_sim_t *sim)
+{
+	return $(proc)_run_n(sim, (uint64_t)-1, NULL);
 }
 
+
 /**
  * Straightforward execution of the simulated programm.
- * It runs until the programm reached the last instruction.
+ * It runs until the programm reached the last instruction (or a breakpoint).
  * this is the <bold> fastest </bold> way to simulate a programm
  * @param	sim	the simulator which we simulate within
  * */
 void $(proc)_run_sim($(proc)_sim_t *sim)
 {
-    uint32_t num_bloc;
-    $(proc)_state_t*   state     = sim->state;
-    $(proc)_decoder_t* decoder   = sim->decoder;
-    $(proc)_address_t  addr_exit = sim->addr_exit;
-    $(proc)_inst_t*    inst;
+	$(proc)_run_n(sim, (uint64_t)-1, NULL);
+}
 
-	while(!sim->ended)
-	{
-        inst = $(proc)_decode(decoder, state->$(pc_name));
 
-        while( (inst->ident != -1) && (addr_exit != state->$(pc_name)))
-        {
-            $(if GLISS_PROFILED_JUMPS)
-			switch(inst->ident)
-			{
-$(foreach profiled_instructions)
-				case $(PROC)_$(IDENT):
-				{
-				$(gen_code)
+/* number of instructions executed between two clock readings of $(proc)_run_time() */
+#ifndef $(PROC)_RUN_TIME_CHUNK
+#	define $(PROC)_RUN_TIME_CHUNK	100000
+#endif
 
-				}break;
-$(end)
-				default:
-				$(proc)_code_table[inst->ident](state, inst);
-		}
-$(else)
-		    $(proc)_code_table[inst->ident](state, inst);
-$(end)
-			inst++;
-        }
+/**
+ * Get the processor time consumed by the calling thread, so that the
+ * simulators run by other threads do not shorten its quantum.
+ * @return	Thread time in micro-seconds.
+ */
+static uint64_t $(proc)_thread_time(void)
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+	/* process time: only accurate with one running simulator */
+	return (uint64_t)((double)clock() * 1000000 / CLOCKS_PER_SEC);
+}
 
-        /* ended ? */
-		if(addr_exit == state->$(pc_name))
-			sim->ended = 1;
-	}
+
+/**
+ * Execute the simulated program during (at least) the given quantum of
+ * processor time of the calling thread. The clock is only read every
+ * $(PROC)_RUN_TIME_CHUNK instructions so that the fast execution loop
+ * is not slowed down.
+ * @param	sim		the simulator which we simulate within
+ * @param	usec	quantum in micro-seconds
+ * @param	reason	if not NULL, store the stop reason
+ * @return	number of executed instructions
+ */
+uint64_t $(proc)_run_time($(proc)_sim_t *sim, uint64_t usec, $(proc)_stop_t *reason)
+{
+	uint64_t end = $(proc)_thread_time() + usec;
+	uint64_t cnt = 0;
+	$(proc)_stop_t stop;
+
+	do
+		cnt += $(proc)_run_n(sim, $(PROC)_RUN_TIME_CHUNK, &stop);
+	while(stop == $(PROC)_STOP_BUDGET && $(proc)_thread_time() < end);
+	if(stop == $(PROC)_STOP_BUDGET)
+		stop = $(PROC)_STOP_TIME;
+	if(reason != NULL)
+		*reason = stop;
+	return cnt;
 }
 
-#endif
-//======================================================================
+
 /**
  * @fn int $(proc)_is_sim_ended($(proc)_sim_t *sim);
  * Indicate if the simulation is finished on the given simulator
@@ -1035,9 +2115,24 @@ void $(proc)_delete_sim($(proc)_sim_t *sim)
 	if (sim == NULL)
 		return;
 
-	/* delete the decoder */
+$(if GLISS_JIT)	/* delete the block translator */
+	$(proc)_delete_jit(sim->jit);
+
+$(end)	/* delete the decoder */
 	$(proc)_delete_decoder(sim->decoder);
 
+	/* delete the breakpoints */
+	if(sim->brks != NULL) {
+		int i;
+		for(i = 0; i < $(PROC)_BRK_HASH_SIZE; i++)
+			while(sim->brks->hash[i] != NULL) {
+				$(proc)_brk_page_t *p = sim->brks->hash[i];
+				sim->brks->hash[i] = p->next;
+				free(p);
+			}
+		free(sim->brks);
+	}
+
 	/* delete the state */
 	$(proc)_delete_state(sim->state);
 
@@ -1073,9 +2168,25 @@ void $(proc)_set_next_address($(proc)_sim_t *sim, $(proc)_address_t address) {
  * Set the exit address for simulation.
  * @param sim		Current simulator.
  * @param address	Exit address.
+ * @return			0 for success, -1 for error (errno set, the exit address is unchanged).
  */
-void $(proc)_set_exit_address($(proc)_sim_t *sim, $(proc)_address_t address) {
+int $(proc)_set_exit_address($(proc)_sim_t *sim, $(proc)_address_t address) {
+	int user;
+
+	if(address == sim->addr_exit)
+		return 0;
+
+	/* set the new exit breakpoint */
+	user = $(proc)_is_breakpoint(sim, address);
+	if($(proc)_brk_set(sim, address) < 0)
+		return -1;
+
+	/* keep the old exit breakpoint if the user also set it */
+	if(sim->brk_exit)
+		$(proc)_brk_clear(sim, sim->addr_exit);
+	sim->brk_exit = !user;
 	sim->addr_exit = address;
+	return 0;
 }
 
 
@@ -50,13 +50,33 @@ $(foreach memories)$(if !aliased)
 $(end)$(end)
 } $(proc)_state_t;
 
+/* $(proc)_stop_t type (reason of the stop of a bounded run) */
+typedef enum $(proc)_stop_t {
+	$(PROC)_STOP_BUDGET = 0,	/* instruction budget exhausted */
+	$(PROC)_STOP_TIME,			/* time quantum elapsed */
+	$(PROC)_STOP_EXIT,			/* exit address reached (simulation ended) */
+	$(PROC)_STOP_BREAKPOINT,	/* other breakpoint reached */
+	$(PROC)_STOP_ENDED			/* simulation ended by other means */
+} $(proc)_stop_t;
+
+/* $(proc)_brk_t type (set of breakpoints) */
+typedef struct $(proc)_brk_t $(proc)_brk_t;
+
 /* $(proc)_sim_t type */
 typedef struct $(proc)_sim_t {
 	$(proc)_state_t *state;
 	$(proc)_decoder_t *decoder;
 	/* on libc stripped programs it is difficult to find the exit point, so we specify it */
 	$(proc)_address_t addr_exit;
-	/* anything else? */
+	/* breakpoints (including the exit address) */
+	$(proc)_brk_t *brks;
+	/* non-zero if the exit breakpoint was only set by the simulator */
+	int brk_exit;
+	/* current instruction in the decoded trace (dynamic trace decoder) */
+	struct $(proc)_inst_t *trace;
+$(if GLISS_JIT)	/* block translator (NULL if not available on this host) */
+	struct $(proc)_jit_t *jit;
+$(end)	/* anything else? */
 	int ended;
 } $(proc)_sim_t;
 
@@ -127,6 +147,7 @@ typedef struct $(proc)_env_t
 /* platform management */
 #define $(PROC)_MAIN_MEMORY		0
 $(proc)_platform_t *$(proc)_new_platform(void);
+$(proc)_platform_t *$(proc)_fork_platform($(proc)_platform_t *platform);
 $(proc)_memory_t *$(proc)_get_memory($(proc)_platform_t *platform, int index);
 struct $(proc)_env_t;
 struct $(proc)_env_t *$(proc)_get_sys_env($(proc)_platform_t *platform);
@@ -134,6 +155,8 @@ void $(proc)_lock_platform($(proc)_platform_t *platform);
 void $(proc)_unlock_platform($(proc)_platform_t *platform);
 int $(proc)_load_platform($(proc)_platform_t *platform, const char *path);
 void $(proc)_load($(proc)_platform_t *platform, struct $(proc)_loader_t *loader);
+int $(proc)_save_image($(proc)_platform_t *platform, const char *path, uint64_t key, $(proc)_address_t exit_addr);
+int $(proc)_load_image($(proc)_platform_t *platform, const char *path, uint64_t key, $(proc)_address_t *exit_addr);
 
 /* fetching */
 $(proc)_fetch_t *$(proc)_new_fetch($(proc)_platform_t *pf$(if is_multi_set), $(proc)_state_t *state$(end));
@@ -158,6 +181,23 @@ $(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf);
 void $(proc)_delete_decoder($(proc)_decoder_t *decoder);
 $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t address);
 void $(proc)_free_inst($(proc)_inst_t *inst);
+#ifdef $(PROC)_FLAT_DECODE
+struct $(proc)_flat_image_t;
+struct $(proc)_flat_image_t *$(proc)_new_flat_image($(proc)_platform_t *pf, struct $(proc)_loader_t *loader);
+void $(proc)_delete_flat_image(struct $(proc)_flat_image_t *image);
+struct $(proc)_flat_image_t *$(proc)_share_flat_image(struct $(proc)_flat_image_t *image);
+#endif
+#ifdef $(PROC)_SHARED_DECODE_CACHE
+typedef struct $(proc)_decode_cache_t $(proc)_decode_cache_t;
+$(proc)_decode_cache_t *$(proc)_new_decode_cache(unsigned int bits);
+void $(proc)_lock_decode_cache($(proc)_decode_cache_t *cache);
+void $(proc)_unlock_decode_cache($(proc)_decode_cache_t *cache);
+$(proc)_decode_cache_t *$(proc)_get_decode_cache($(proc)_platform_t *pf);
+void $(proc)_set_decode_cache($(proc)_platform_t *pf, $(proc)_decode_cache_t *cache);
+#endif
+#ifdef $(PROC)_DTRACE_CACHE
+$(proc)_inst_t *$(proc)_decode_next($(proc)_decoder_t *decoder, $(proc)_inst_t *trace, $(proc)_address_t address);
+#endif
 /* only used if several ISS defined to fully initialize decoder structure,
  * does nothing if one inst set only is defined */
 void $(proc)_set_cond_state($(proc)_decoder_t *decoder, $(proc)_state_t *state);
@@ -179,6 +219,9 @@ void $(proc)_delete_state($(proc)_state_t *state);
 $(proc)_state_t *$(proc)_copy_state($(proc)_state_t *state);
 $(proc)_state_t *$(proc)_fork_state($(proc)_state_t *state);
 void $(proc)_dump_state($(proc)_state_t *state, FILE *out);
+int $(proc)_save_checkpoint($(proc)_state_t *state, const char *path);
+int $(proc)_save_delta_checkpoint($(proc)_state_t *state, const char *path);
+int $(proc)_load_checkpoint($(proc)_state_t *state, const char *path);
 void $(proc)_output_header_valid(FILE *out);
 void $(proc)_output_state_valid($(proc)_state_t *state, FILE *out);
 $(proc)_platform_t *$(proc)_platform($(proc)_state_t *state);
@@ -188,12 +231,17 @@ $(proc)_sim_t *$(proc)_new_sim($(proc)_state_t *state, $(proc)_address_t start_a
 $(proc)_inst_t *$(proc)_next_inst($(proc)_sim_t *sim);
 uint64_t $(proc)_run_and_count_inst($(proc)_sim_t *sim);
 void $(proc)_run_sim($(proc)_sim_t *sim);
+uint64_t $(proc)_run_n($(proc)_sim_t *sim, uint64_t budget, $(proc)_stop_t *reason);
+uint64_t $(proc)_run_time($(proc)_sim_t *sim, uint64_t usec, $(proc)_stop_t *reason);
 void $(proc)_step($(proc)_sim_t *sim);
 void $(proc)_delete_sim($(proc)_sim_t *sim);
 $(proc)_address_t  $(proc)_next_addr($(proc)_sim_t *sim);
 void $(proc)_set_next_address($(proc)_sim_t *sim, $(proc)_address_t address);
 #define $(proc)_set_entry_address(sim, addr) $(proc)_set_next_address(sim, addr)
-void $(proc)_set_exit_address($(proc)_sim_t *sim, $(proc)_address_t address);
+int $(proc)_set_exit_address($(proc)_sim_t *sim, $(proc)_address_t address);
+int $(proc)_add_breakpoint($(proc)_sim_t *sim, $(proc)_address_t address);
+void $(proc)_remove_breakpoint($(proc)_sim_t *sim, $(proc)_address_t address);
+int $(proc)_is_breakpoint($(proc)_sim_t *sim, $(proc)_address_t address);
 #define $(proc)_set_sim_ended(sim) (sim)->ended = 1
 #define $(proc)_is_sim_ended(sim) ((sim)->ended)
 
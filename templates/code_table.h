@@ -42,11 +42,15 @@ $(end)
 
 typedef void (*$(proc)_code_function_t)($(proc)_state_t *, $(proc)_inst_t *);
 
+/* $(PROC)_NO_CODE_TABLE allows to use the code functions without the table
+ * (the table is already in the library) */
+#ifndef $(PROC)_NO_CODE_TABLE
 $(proc)_code_function_t $(proc)_code_table[] =
 {
 	$(proc)_instr_UNKNOWN_code$(foreach instructions),
 	$(proc)_instr_$(IDENT)_code$(end)
 };
+#endif
 
 
 
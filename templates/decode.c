@@ -61,8 +61,6 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 
 
 /* initialization and destruction of $(proc)_decode_t object */
-static int number_of_decoder_objects = 0;
-
 static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 {
 	$(if is_multi_set)d->fetch = NULL;
@@ -89,7 +87,6 @@ $(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf) {
     if (res == NULL)
                 $(proc)_error("not enough memory to create a $(proc)_decoder_t object"); /* I assume error handling will remain the same, we use $(proc)_error istead of iss_error ? */
     init_decoder(res, pf);
-    number_of_decoder_objects++;
     return res;
 }
 
@@ -98,8 +95,6 @@ void $(proc)_delete_decoder($(proc)_decoder_t *decode)
     if (decode == NULL)
         /* we shouldn't try to free a void decoder_t object, should this output an error ? */
                 $(proc)_error("cannot delete an NULL $(proc)_decoder_t object");
-    number_of_decoder_objects--;
-    /*assert(number_of_decode_objects >= 0);*/
     halt_decoder(decode);
     free(decode);
     
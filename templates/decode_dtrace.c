@@ -1,6 +1,7 @@
 /* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <math.h>
 #include <$(proc)/fetch.h>
@@ -29,10 +30,16 @@
 /* Double linked list (linked as a ring) */
 typedef struct $(proc)_entry {
 	$(proc)_address_t	key;
+	$(proc)_address_t	size;		/* size of the decoded code (0 if none) */
 	$(proc)_inst_t value[TRACE_DEPTH+1];
 	struct $(proc)_entry *next;
+	struct $(proc)_entry *succ[2];	/* chained successor traces */
+	int last;						/* last replaced successor */
 } $(proc)_entry_t;
 
+/* get the cache entry of a trace */
+#define ENTRY_OF(trace)	(($(proc)_entry_t *)((char *)(trace) - offsetof($(proc)_entry_t, value)))
+
 typedef struct $(proc)_hashtable {
 	$(proc)_entry_t *entry_tab;
 	$(proc)_entry_t *table[CACHE_SIZE];
@@ -47,6 +54,12 @@ struct $(proc)_decoder_t
 $(if is_multi_set)	/* help determine which decode type if several instr sets defined */
 	$(proc)_state_t *state;
 	$(proc)_platform_t *pf;$(end)
+#ifdef $(PROC)_MEM_WATCH
+	/* self-modifying code detection */
+	$(proc)_memory_t *mem;		/* watched memory */
+	int smc;					/* 1 if decoded code has been written */
+	$(proc)_address_t smc_low, smc_high;	/* written code range */
+#endif
 };
 
 /** ! Size must be a power of two ! */
@@ -63,9 +76,67 @@ static $(proc)_inst_t* hashtable_search($(proc)_hashtable_t* h, $(proc)_address_
 $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t address);
 
 
-/* initialization and destruction of $(proc)_decode_t object */
-static int number_of_decoder_objects = 0;
+#ifdef $(PROC)_MEM_WATCH
+
+/**
+ * Called at the first write to a page containing decoded instructions:
+ * the written range is only recorded as the instruction performing
+ * the write may be in the current trace.
+ * @param mem		Written memory.
+ * @param address	Address of the written page.
+ * @param size		Size of the written page.
+ * @param data		Watching decoder.
+ */
+static void decoder_watcher($(proc)_memory_t *mem, $(proc)_address_t address, uint32_t size, void *data)
+{
+	$(proc)_decoder_t *d = ($(proc)_decoder_t *)data;
+	$(proc)_address_t high = address + (size - 1);
+	if(!d->smc || address < d->smc_low)
+		d->smc_low = address;
+	if(!d->smc || high > d->smc_high)
+		d->smc_high = high;
+	d->smc = 1;
+}
+
+/* test if the given bytes overlap the written code range */
+#define SMC_HIT(d, a, s)	((a) <= (d)->smc_high && (a) + ((s) - 1) >= (d)->smc_low)
+
+/* size of the code of the n first instructions of a trace: up to the end of the last one */
+#define TRACE_SIZE(t, n)	((t)[(n) - 1].addr + $(proc)_get_inst_size(&(t)[(n) - 1]) / 8 - (t)[0].addr)
+
+/**
+ * Invalidate the traces overlapping the written code range: the
+ * current trace remains usable until its entry is reused and the
+ * chained traces are unchained as their key no more matches.
+ * @param d		Decoder to invalidate in.
+ */
+static void decoder_invalidate($(proc)_decoder_t *d)
+{
+	unsigned int i;
+	$(proc)_entry_t *e = d->cache->entry_tab;
+	for(i = 0; i < CACHE_SIZE * CACHE_DEPTH; i++)
+		if(e[i].size != 0 && SMC_HIT(d, e[i].key, e[i].size)) {
+			e[i].key = -1;
+			e[i].size = 0;
+		}
+	d->smc = 0;
+}
 
+#	define SMC_CHECK(d)			if((d)->smc) decoder_invalidate(d)
+#	define SMC_WATCH(d, t, n) \
+		do { \
+			$(proc)_entry_t *e = ENTRY_OF(t); \
+			e->size = TRACE_SIZE(t, n); \
+			$(proc)_mem_watch((d)->mem, e->key); \
+			$(proc)_mem_watch((d)->mem, e->key + (e->size - 1)); \
+		} while(0)
+#else
+#	define SMC_CHECK(d)
+#	define SMC_WATCH(d, t, n)
+#endif
+
+
+/* initialization and destruction of $(proc)_decode_t object */
 static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 {
 	$(if is_multi_set)d->fetch = NULL;
@@ -74,10 +145,18 @@ static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 	$(else)d->fetch = $(proc)_new_fetch(pf);
 	$(end)
         d->cache = create_hashtable( CACHE_SIZE, CACHE_DEPTH );
+#	ifdef $(PROC)_MEM_WATCH
+		d->mem = $(proc)_get_memory(pf, $(PROC)_MAIN_MEMORY);
+		d->smc = 0;
+		$(proc)_mem_add_watcher(d->mem, decoder_watcher, d);
+#	endif
 }
 
 static void halt_decoder($(proc)_decoder_t *d)
 {
+#	ifdef $(PROC)_MEM_WATCH
+		$(proc)_mem_remove_watcher(d->mem, decoder_watcher, d);
+#	endif
         $(proc)_delete_fetch(d->fetch);
         hashtable_destroy(d->cache);
 }
@@ -87,9 +166,7 @@ $(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf)
     $(proc)_decoder_t *res = malloc(sizeof($(proc)_decoder_t));
     if (res == NULL)
                 $(proc)_error("not enough memory to create a $(proc)_decoder_t object");
-    /*assert(number_of_decode_objects >= 0);*/
     init_decoder(res, pf);
-    number_of_decoder_objects++;
     return res;
 }
 
@@ -98,8 +175,6 @@ void $(proc)_delete_decoder($(proc)_decoder_t *decode)
     if (decode == NULL)
         /* we shouldn't try to free a void decoder_t object, should this output an error ? */
                 $(proc)_error("cannot delete an NULL $(proc)_decoder_t object");
-    number_of_decoder_objects--;
-    /*assert(number_of_decode_objects >= 0);*/
     halt_decoder(decode);
     free(decode);
 }
@@ -206,6 +281,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	uint$(C_inst_size)_t code;
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -222,6 +300,7 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 		(res+i)->addr = a;
 	}
 	res[i].ident = -1;
+	SMC_WATCH(decoder, res, i);
 	return res;
 }
 $(else)
@@ -234,6 +313,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	mask_t code = {i_buff, 0};
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -250,6 +332,7 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 		(res+i)->addr = a;
 	}
 	res[i].ident = -1;
+	SMC_WATCH(decoder, res, i);
 	return res;
 }
 $(end)$(end)
@@ -280,6 +363,9 @@ $(proc)_inst_t *$(proc)_decode_$(if is_RISC_size)$(C_size)$(else)CISC$(end)($(pr
 	code.mask = {i_buff, 0};$(end)
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -296,6 +382,7 @@ $(proc)_inst_t *$(proc)_decode_$(if is_RISC_size)$(C_size)$(else)CISC$(end)($(pr
 		(res+i)->addr = a;
 	}
 	res[i].ident = -1;
+	SMC_WATCH(decoder, res, i);
 	return res;
 }
 $(end)$(end)
@@ -328,6 +415,9 @@ $(proc)_inst_t *$(proc)_decode_$(iset_name)($(proc)_decoder_t *decoder, $(proc)_
 	code.mask = {i_buff, 0};$(end)
 	int i;
 	
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -346,6 +436,7 @@ $(proc)_inst_t *$(proc)_decode_$(iset_name)($(proc)_decoder_t *decoder, $(proc)_
 		(res+i)->addr = a;
 	}
 	res[i].ident = -1;
+	SMC_WATCH(decoder, res, i);
 	return res;
 }
 $(end)
@@ -366,6 +457,41 @@ $(end)
 
 
 
+/**
+ * Get the trace following the given one, at the given address.
+ * Each trace records the last two traces executed after it (typically
+ * the taken and not-taken paths of its ending branch): the cache lookup
+ * is only performed when none of them matches the address.
+ * A chained trace is only valid while its entry holds the same address,
+ * so replaced entries are naturally unchained.
+ *
+ * @param decoder	decoder struct giving access to instr cache
+ * @param trace		current trace (as returned by $(proc)_decode())
+ * @param address	address of the next trace
+ * @return			next trace to execute
+ */
+$(proc)_inst_t *$(proc)_decode_next($(proc)_decoder_t *decoder, $(proc)_inst_t *trace, $(proc)_address_t address)
+{
+	$(proc)_entry_t *e = ENTRY_OF(trace);
+	$(proc)_inst_t *res;
+
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
+	/* chained trace ? */
+	if(e->succ[0] != NULL && e->succ[0]->key == address)
+		return e->succ[0]->value;
+	if(e->succ[1] != NULL && e->succ[1]->key == address)
+		return e->succ[1]->value;
+
+	/* look in the cache and chain it */
+	res = $(proc)_decode(decoder, address);
+	e->last ^= 1;
+	e->succ[e->last] = ENTRY_OF(res);
+	return res;
+}
+
+
 /**
  * @param depth  must greater or equal to 2
  */
@@ -399,6 +525,9 @@ static $(proc)_hashtable_t* create_hashtable( unsigned int size, unsigned int de
         }
         tmp0 = init;
         init->key   = -1;
+        init->size  = 0;
+        init->succ[0] = init->succ[1] = NULL;
+        init->last  = 0;
 
         for(j = 0; j < (depth-1); ++j)
         {
@@ -409,6 +538,9 @@ static $(proc)_hashtable_t* create_hashtable( unsigned int size, unsigned int de
                 return NULL;
             }
             tmp1->key   = -1;
+            tmp1->size  = 0;
+            tmp1->succ[0] = tmp1->succ[1] = NULL;
+            tmp1->last  = 0;
 
             tmp0->next = tmp1;
             tmp0       = tmp1;
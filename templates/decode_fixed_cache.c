@@ -52,6 +52,12 @@ struct gliss_decoder_t
 $(if is_multi_set)	/* help determine which decode type if several instr sets defined */
 	$(proc)_state_t *state;
 	$(proc)_platform_t *pf;$(end)
+#ifdef $(PROC)_MEM_WATCH
+	/* self-modifying code detection */
+	$(proc)_memory_t *mem;		/* watched memory */
+	int smc;					/* 1 if decoded code has been written */
+	$(proc)_address_t smc_low, smc_high;	/* written code range */
+#endif
 };
 
 
@@ -68,9 +74,57 @@ static gliss_inst_t* hashtable_search(gliss_hashtable_t* h, gliss_address_t key)
 /* decoding */
 gliss_inst_t *gliss_decode(gliss_decoder_t *decoder, gliss_address_t address);
 
-/* initialization and destruction of gliss_decode_t object */
-static int number_of_decoder_objects = 0;
+#ifdef $(PROC)_MEM_WATCH
+/* size in bytes of the watched instructions */
+#define SMC_INST_SIZE	(($(max_instruction_size) + 7) / 8)
+
+/**
+ * Called at the first write to a page containing decoded instructions:
+ * the written range is only recorded as the instruction performing
+ * the write may still be executing.
+ * @param mem		Written memory.
+ * @param address	Address of the written page.
+ * @param size		Size of the written page.
+ * @param data		Watching decoder.
+ */
+static void decoder_watcher($(proc)_memory_t *mem, $(proc)_address_t address, uint32_t size, void *data)
+{
+	$(proc)_decoder_t *d = ($(proc)_decoder_t *)data;
+	$(proc)_address_t high = address + (size - 1);
+	if(!d->smc || address < d->smc_low)
+		d->smc_low = address;
+	if(!d->smc || high > d->smc_high)
+		d->smc_high = high;
+	d->smc = 1;
+}
+
+/* test if the given bytes overlap the written code range */
+#define SMC_HIT(d, a, s)	((a) <= (d)->smc_high && (a) + ((s) - 1) >= (d)->smc_low)
+
+/**
+ * Invalidate the cache entries of the written code range (their
+ * instructions are freed when the entries are reused).
+ * @param d		Decoder to invalidate in.
+ */
+static void decoder_invalidate($(proc)_decoder_t *d)
+{
+	unsigned int i, j;
+	for(i = 0; i < d->cache->tablelength; i++)
+		for(j = 0; j < d->cache->tabledepth; j++)
+			if(SMC_HIT(d, d->cache->table[i]->entries[j].key, SMC_INST_SIZE))
+				d->cache->table[i]->entries[j].key = -1;
+	d->smc = 0;
+}
 
+#	define SMC_CHECK(d)			if((d)->smc) decoder_invalidate(d)
+#	define SMC_WATCH(d, a, s)	do { $(proc)_mem_watch((d)->mem, (a)); $(proc)_mem_watch((d)->mem, (a) + ((s) - 1)); } while(0)
+#else
+#	define SMC_CHECK(d)
+#	define SMC_WATCH(d, a, s)
+#endif
+
+
+/* initialization and destruction of gliss_decode_t object */
 static void init_decoder(gliss_decoder_t *d, gliss_platform_t *pf)
 {
         $(if is_multi_set)d->fetch = NULL;
@@ -79,10 +133,18 @@ static void init_decoder(gliss_decoder_t *d, gliss_platform_t *pf)
 	$(else)d->fetch = $(proc)_new_fetch(pf);
 	$(end)
         d->cache = create_hashtable(CACHE_SIZE, CACHE_DEPTH);
+#	ifdef $(PROC)_MEM_WATCH
+		d->mem = $(proc)_get_memory(pf, $(PROC)_MAIN_MEMORY);
+		d->smc = 0;
+		$(proc)_mem_add_watcher(d->mem, decoder_watcher, d);
+#	endif
 }
 
 static void halt_decoder(gliss_decoder_t *d)
 {
+#	ifdef $(PROC)_MEM_WATCH
+		$(proc)_mem_remove_watcher(d->mem, decoder_watcher, d);
+#	endif
 	gliss_delete_fetch(d->fetch);
 	hashtable_destroy(d->cache);
 }
@@ -92,9 +154,7 @@ gliss_decoder_t *gliss_new_decoder(gliss_platform_t *pf)
         gliss_decoder_t *res = malloc(sizeof(gliss_decoder_t));
     if (res == NULL)
                 gliss_error("not enough memory to create a gliss_decoder_t object"); /* I assume error handling will remain the same, we use gliss_error istead of iss_error ? */
-    /*assert(number_of_decode_objects >= 0);*/
     init_decoder(res, pf);
-    number_of_decoder_objects++;
     return res;
 }
 
@@ -103,8 +163,6 @@ void gliss_delete_decoder(gliss_decoder_t *decode)
     if (decode == NULL)
         /* we shouldn't try to free a void decoder_t object, should this output an error ? */
                 gliss_error("cannot delete an NULL gliss_decoder_t object");
-    number_of_decoder_objects--;
-    /*assert(number_of_decode_objects >= 0);*/
     halt_decoder(decode);
     free(decode);
 }
@@ -147,6 +205,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	$(proc)_ident_t id;
 	uint$(C_inst_size)_t code;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	unsigned int i;
 	gliss_entry_ring_t *ring = decoder->cache->table[MODULO(address, CACHE_SIZE)];
@@ -179,6 +240,7 @@ $(end)
 	res->addr = address;
 	
 	ring->entries[ring->idx].key   = address;
+	SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	ring->idx = MODULO((ring->idx+1), CACHE_DEPTH);
 	
 	return res;
@@ -192,6 +254,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	uint32_t i_buff[$(max_instruction_size) / 32 + ($(max_instruction_size) % 32? 1: 0)];
 	mask_t code = {i_buff, 0};
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	unsigned int i;
 	gliss_entry_ring_t *ring = decoder->cache->table[MODULO(address, CACHE_SIZE)];
@@ -224,6 +289,7 @@ $(end)
 	res->addr = address;
 	
 	ring->entries[ring->idx].key   = address;
+	SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	ring->idx = MODULO((ring->idx+1), CACHE_DEPTH);
 	
 	return res;
@@ -249,6 +315,9 @@ $(proc)_inst_t *$(proc)_decode_$(if is_RISC_size)$(C_size)$(else)CISC$(end)($(pr
 	uint32_t i_buff[$(max_instruction_size) / 32 + ($(max_instruction_size) % 32? 1: 0)];
 	code.mask = {i_buff, 0};$(end)
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	unsigned int i;
 	gliss_entry_ring_t *ring = decoder->cache->table[MODULO(address, CACHE_SIZE)];
@@ -281,6 +350,7 @@ $(end)
 	res->addr = address;
 	
 	ring->entries[ring->idx].key   = address;
+	SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	ring->idx = MODULO((ring->idx+1), CACHE_DEPTH);
 	
 	return res;
@@ -302,6 +372,9 @@ $(proc)_inst_t *$(proc)_decode_$(iset_name)($(proc)_decoder_t *decoder, $(proc)_
 	uint32_t i_buff[$(max_instruction_size) / 32 + ($(max_instruction_size) % 32? 1: 0)];
 	code.mask = {i_buff, 0};$(end)
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	unsigned int i;
 	gliss_entry_ring_t *ring = decoder->cache->table[MODULO(address, CACHE_SIZE)];
@@ -335,6 +408,7 @@ $(end)
 	res->addr = address;
 	
 	ring->entries[ring->idx].key   = address;
+	SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	ring->idx = MODULO((ring->idx+1), CACHE_DEPTH);
 	
 	return res;
@@ -0,0 +1,209 @@
+/* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
+/* decode:decode_flat */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <$(proc)/fetch.h>
+#include <$(proc)/decode.h> /* api.h will be in it, for fetch functions, decode_table.h also */
+#include <$(proc)/config.h> /* for memory endiannesses */
+#include <$(proc)/loader.h>
+
+#include "decode_table.h"
+#include "platform.h"
+
+$(if is_multi_set)
+#error "decode_flat module only supports one instruction set"
+$(end)
+$(if !is_RISC)
+#error "decode_flat module only supports fixed-size instruction sets"
+$(end)
+
+#define $(proc)_error(e) fprintf(stderr, "%s\n", (e))
+
+/* size of an instruction in bytes */
+#define INST_SIZE	($(C_inst_size) / 8)
+
+/* pre-decoded image of the code */
+struct $(proc)_flat_image_t {
+	$(proc)_address_t base;		/* address of the first instruction */
+	$(proc)_address_t size;		/* size of the image in bytes */
+	$(proc)_inst_t *insts;		/* decoded instructions */
+	int usage;					/* number of platforms and decoders using the image */
+};
+
+/* decode structure */
+struct $(proc)_decoder_t
+{
+	/* the fetch unit used to retrieve instruction ID */
+	$(proc)_fetch_t *fetch;
+	/* pre-decoded image (shared by the platform) */
+	struct $(proc)_flat_image_t *image;
+	/* instruction for out-of-image addresses */
+	$(proc)_inst_t tmp_inst;
+};
+
+
+/**
+ * Decode an instruction out of the image.
+ * @param fetch		Fetch unit.
+ * @param address	Address of the instruction.
+ * @param inst		Instruction to fill.
+ */
+static void decode_inst($(proc)_fetch_t *fetch, $(proc)_address_t address, $(proc)_inst_t *inst)
+{
+	$(proc)_ident_t id;
+	uint$(C_inst_size)_t code;
+
+	id = $(proc)_fetch(fetch, address, &code);
+$(if GLISS_NO_MALLOC)
+	$(proc)_decode_table[id](code, inst);
+$(else)
+	{
+		$(proc)_inst_t *res = $(proc)_decode_table[id](code);
+		memcpy(inst, res, sizeof($(proc)_inst_t));
+		free(res);
+	}
+$(end)
+	inst->addr = address;
+}
+
+
+/**
+ * Build the pre-decoded image of the biggest code section of the loaded program.
+ * The memory of the platform must already contain the program.
+ * @param pf		Platform containing the program.
+ * @param loader	Loader of the program.
+ * @return			Built image or NULL (no code section or not enough memory).
+ */
+struct $(proc)_flat_image_t *$(proc)_new_flat_image($(proc)_platform_t *pf, $(proc)_loader_t *loader)
+{
+	struct $(proc)_flat_image_t *image;
+	$(proc)_loader_sect_t sect, text;
+	$(proc)_fetch_t *fetch;
+	$(proc)_address_t i, n;
+	int s;
+
+	/* look for the biggest code section */
+	text.size = 0;
+	for(s = 0; s < $(proc)_loader_count_sects(loader); s++) {
+		$(proc)_loader_sect(loader, s, &sect);
+		if(sect.type == $(PROC)_LOADER_SECT_TEXT && sect.size > text.size)
+			text = sect;
+	}
+	if(text.size == 0)
+		return NULL;
+
+	/* allocate the image */
+	image = (struct $(proc)_flat_image_t *)malloc(sizeof(struct $(proc)_flat_image_t));
+	if(image == NULL)
+		return NULL;
+	n = text.size / INST_SIZE;
+	image->base = text.addr;
+	image->usage = 1;
+	image->size = n * INST_SIZE;
+	image->insts = ($(proc)_inst_t *)malloc(n * sizeof($(proc)_inst_t));
+	if(image->insts == NULL) {
+		free(image);
+		return NULL;
+	}
+
+	/* decode all instructions */
+	fetch = $(proc)_new_fetch(pf);
+	for(i = 0; i < n; i++)
+		decode_inst(fetch, image->base + i * INST_SIZE, &image->insts[i]);
+	$(proc)_delete_fetch(fetch);
+	return image;
+}
+
+
+/**
+ * Delete a pre-decoded image (actually released with its last user).
+ * @param image		Image to delete (may be NULL).
+ */
+void $(proc)_delete_flat_image(struct $(proc)_flat_image_t *image)
+{
+	if(image == NULL || __atomic_sub_fetch(&image->usage, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	free(image->insts);
+	free(image);
+}
+
+
+/**
+ * Share the given image with another platform (typically a forked one)
+ * or with a decoder.
+ * @param image		Shared image (may be null).
+ * @return			The same image.
+ */
+struct $(proc)_flat_image_t *$(proc)_share_flat_image(struct $(proc)_flat_image_t *image)
+{
+	if(image != NULL)
+		__atomic_add_fetch(&image->usage, 1, __ATOMIC_RELAXED);
+	return image;
+}
+
+
+/* initialization and destruction of $(proc)_decode_t object */
+$(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf)
+{
+	$(proc)_decoder_t *res = malloc(sizeof($(proc)_decoder_t));
+	if (res == NULL) {
+		$(proc)_error("not enough memory to create a $(proc)_decoder_t object");
+		return NULL;
+	}
+	res->fetch = $(proc)_new_fetch(pf);
+	if(res->fetch == NULL) {
+		$(proc)_error("not enough memory to create a $(proc)_decoder_t object");
+		free(res);
+		return NULL;
+	}
+
+	/* the image may be replaced in the platform by a new load */
+	res->image = $(proc)_share_flat_image(pf->flat_image);
+	return res;
+}
+
+void $(proc)_delete_decoder($(proc)_decoder_t *decode)
+{
+	if (decode == NULL) {
+		$(proc)_error("cannot delete an NULL $(proc)_decoder_t object");
+		return;
+	}
+	$(proc)_delete_fetch(decode->fetch);
+	$(proc)_delete_flat_image(decode->image);
+	free(decode);
+}
+
+/** Does nothing as only one instr set is supported. */
+void $(proc)_set_cond_state($(proc)_decoder_t *decoder, $(proc)_state_t *state)
+{
+}
+
+
+/**
+ * Decode the instruction at the given address. Instructions of the
+ * pre-decoded image are returned directly, others are decoded in a buffer
+ * of the decoder, valid until the next call.
+ * In both cases, the instruction must not be freed.
+ * @param decoder	Current decoder.
+ * @param address	Address of the instruction.
+ * @return			Decoded instruction.
+ */
+$(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t address)
+{
+	struct $(proc)_flat_image_t *image = decoder->image;
+
+	/* in the image ? */
+	if(image != NULL) {
+		$(proc)_address_t off = address - image->base;
+		if(off < image->size && off % INST_SIZE == 0)
+			return &image->insts[off / INST_SIZE];
+	}
+
+	/* else decode it */
+	decode_inst(decoder->fetch, address, &decoder->tmp_inst);
+	return &decoder->tmp_inst;
+}
+
+/* End of file $(proc)_decode.c */
@@ -41,6 +41,13 @@ struct $(proc)_decoder_t
 $(if is_multi_set)	/* help determine which decode type if several instr sets defined */
 	$(proc)_state_t *state;
 	$(proc)_platform_t *pf;$(end)
+#ifdef $(PROC)_MEM_WATCH
+	/* self-modifying code detection */
+	$(proc)_memory_t *mem;		/* watched memory */
+	int smc;					/* 1 if decoded code has been written */
+	$(proc)_address_t smc_low, smc_high;	/* written code range */
+	$(proc)_entry_t *retired;	/* invalidated entries (freed with the decoder) */
+#endif
 };
 
 
@@ -56,9 +63,65 @@ static $(proc)_inst_t* hashtable_search($(proc)_hashtable_t* h, $(proc)_address_
 /* decoding */
 $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t address);
 
-/* initialization and destruction of $(proc)_decode_t object */
-static int number_of_decoder_objects = 0;
+#ifdef $(PROC)_MEM_WATCH
+/* size in bytes of the watched instructions */
+#define SMC_INST_SIZE	(($(max_instruction_size) + 7) / 8)
+
+/**
+ * Called at the first write to a page containing decoded instructions:
+ * the written range is only recorded as the instruction performing
+ * the write may still be executing.
+ * @param mem		Written memory.
+ * @param address	Address of the written page.
+ * @param size		Size of the written page.
+ * @param data		Watching decoder.
+ */
+static void decoder_watcher($(proc)_memory_t *mem, $(proc)_address_t address, uint32_t size, void *data)
+{
+	$(proc)_decoder_t *d = ($(proc)_decoder_t *)data;
+	$(proc)_address_t high = address + (size - 1);
+	if(!d->smc || address < d->smc_low)
+		d->smc_low = address;
+	if(!d->smc || high > d->smc_high)
+		d->smc_high = high;
+	d->smc = 1;
+}
+
+/* test if the given bytes overlap the written code range */
+#define SMC_HIT(d, a, s)	((a) <= (d)->smc_high && (a) + ((s) - 1) >= (d)->smc_low)
+
+/**
+ * Remove the cache entries of the written code range. The removed
+ * instructions are kept until the decoder is deleted as they may
+ * still be used by the caller.
+ * @param d		Decoder to invalidate in.
+ */
+static void decoder_invalidate($(proc)_decoder_t *d)
+{
+	unsigned int i;
+	$(proc)_entry_t **p, *e;
+	for(i = 0; i < d->cache->tablelength; i++)
+		for(p = &d->cache->table[i]; *p != NULL;)
+			if(SMC_HIT(d, (*p)->key, SMC_INST_SIZE)) {
+				e = *p;
+				*p = e->next;
+				e->next = d->retired;
+				d->retired = e;
+			}
+			else
+				p = &(*p)->next;
+	d->smc = 0;
+}
 
+#	define SMC_CHECK(d)			if((d)->smc) decoder_invalidate(d)
+#	define SMC_WATCH(d, a, s)	do { $(proc)_mem_watch((d)->mem, (a)); $(proc)_mem_watch((d)->mem, (a) + ((s) - 1)); } while(0)
+#else
+#	define SMC_CHECK(d)
+#	define SMC_WATCH(d, a, s)
+#endif
+
+
+/* initialization and destruction of $(proc)_decode_t object */
 static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 {
         $(if is_multi_set)d->fetch = NULL;
@@ -68,10 +131,25 @@ static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 	$(end)
         d->cache = create_hashtable(CACHE_SIZE);
 
+#	ifdef $(PROC)_MEM_WATCH
+		d->mem = $(proc)_get_memory(pf, $(PROC)_MAIN_MEMORY);
+		d->smc = 0;
+		d->retired = NULL;
+		$(proc)_mem_add_watcher(d->mem, decoder_watcher, d);
+#	endif
 }
 
 static void halt_decoder($(proc)_decoder_t *d)
 {
+#	ifdef $(PROC)_MEM_WATCH
+		$(proc)_mem_remove_watcher(d->mem, decoder_watcher, d);
+		while(d->retired != NULL) {
+			$(proc)_entry_t *e = d->retired;
+			d->retired = e->next;
+			free(e->value);
+			free(e);
+		}
+#	endif
         $(proc)_delete_fetch(d->fetch);
         hashtable_destroy(d->cache);
 }
@@ -81,9 +159,7 @@ $(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf)
         $(proc)_decoder_t *res = malloc(sizeof($(proc)_decoder_t));
     if (res == NULL)
                 $(proc)_error("not enough memory to create a $(proc)_decoder_t object"); /* I assume error handling will remain the same, we use $(proc)_error istead of iss_error ? */
-    /*assert(number_of_decode_objects >= 0);*/
     init_decoder(res, pf);
-    number_of_decoder_objects++;
     return res;
 }
 
@@ -92,8 +168,6 @@ void $(proc)_delete_decoder($(proc)_decoder_t *decode)
     if (decode == NULL)
         /* we shouldn't try to free a void decoder_t object, should this output an error ? */
                 $(proc)_error("cannot delete an NULL $(proc)_decoder_t object");
-    number_of_decoder_objects--;
-    /*assert(number_of_decode_objects >= 0);*/
     halt_decoder(decode);
     free(decode);
 }
@@ -136,6 +210,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	$(proc)_ident_t id;
 	uint$(C_inst_size)_t code;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	res = hashtable_search(decoder->cache, address);
 	if( !res ) {
@@ -153,6 +230,7 @@ $(end)
 
 		/* and last cache the instruction */
 		hashtable_insert(decoder->cache, address, res);
+		SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	}
 	return res;
 }
@@ -165,6 +243,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	uint32_t i_buff[$(max_instruction_size) / 32 + ($(max_instruction_size) % 32? 1: 0)];
 	mask_t code = {i_buff, 0};
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	res = hashtable_search(decoder->cache, address);
 	if( !res ) {
@@ -182,6 +263,7 @@ $(end)
 
 		/* and last cache the instruction */
 		hashtable_insert(decoder->cache, address, res);
+		SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	}
 	return res;
 }
@@ -206,6 +288,9 @@ $(proc)_inst_t *$(proc)_decode_$(if is_RISC_size)$(C_size)$(else)CISC$(end)($(pr
 	uint32_t i_buff[$(max_instruction_size) / 32 + ($(max_instruction_size) % 32? 1: 0)];
 	code.mask = {i_buff, 0};$(end)
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	res = hashtable_search(decoder->cache, address);
 	if( !res ) {
@@ -223,6 +308,7 @@ $(end)
 
 		/* and last cache the instruction */
 		hashtable_insert(decoder->cache, address, res);
+		SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	}
 	return res;
 }
@@ -244,6 +330,9 @@ $(proc)_inst_t *$(proc)_decode_$(iset_name)($(proc)_decoder_t *decoder, $(proc)_
 	code.mask = {i_buff, 0};$(end)
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	res = hashtable_search(decoder->cache, address);
 	if( !res ) {
@@ -262,6 +351,7 @@ $(end)
 
 		/* and last cache the instruction */
 		hashtable_insert(decoder->cache, address, res);
+		SMC_WATCH(decoder, address, SMC_INST_SIZE);
 	}
 	return res;
 }
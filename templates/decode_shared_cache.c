@@ -0,0 +1,399 @@
+/* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
+/* decode:decode_shared_cache */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <$(proc)/fetch.h>
+#include <$(proc)/decode.h> /* api.h will be in it, for fetch functions, decode_table.h also */
+#include <$(proc)/config.h> /* for memory endiannesses */
+
+#include "decode_table.h"
+#include "platform.h"
+
+$(if is_multi_set)
+#error "decode_shared_cache module only supports one instruction set"
+$(end)
+
+#define $(proc)_error(e) fprintf(stderr, "%s\n", (e))
+
+/* Only works if tablelength == 2^N */
+#define INDEX_FOR(tablelength, hash) (hash & (tablelength - 1u))
+
+/* size of the private cache of a decoder */
+#ifndef CACHE_SIZE
+#define CACHE_SIZE (4096*2) // Must be a power of two
+#endif
+
+/* log2 of the number of slots of a shared cache */
+#ifndef SHARED_CACHE_BITS
+#define SHARED_CACHE_BITS	16
+#endif
+
+/* number of slots looked for an address in the shared cache */
+#ifndef SHARED_CACHE_PROBES
+#define SHARED_CACHE_PROBES	8
+#endif
+
+
+/*
+ * The shared cache is an open-addressing table of instruction pointers used
+ * by the decoders of several simulators (possibly running on different threads).
+ * Slots are only filled (with an atomic compare-and-swap publishing a fully
+ * decoded instruction) and are never emptied before the cache is released:
+ * lookups are simple atomic loads, without any lock. When the slots of
+ * an address are all used by other addresses, the instruction is kept
+ * in the private cache of the decoder.
+ */
+struct $(proc)_decode_cache_t {
+	int usage;						/* number of platforms using the cache */
+	unsigned int bits;				/* log2 of the number of slots */
+	$(proc)_inst_t **slots;			/* published instructions */
+};
+
+typedef struct $(proc)_entry {
+	$(proc)_address_t key;
+	$(proc)_inst_t *value;
+	struct $(proc)_entry *next;
+} $(proc)_entry_t;
+
+typedef struct $(proc)_hashtable_t {
+	unsigned int tablelength;
+	$(proc)_entry_t **table;
+} $(proc)_hashtable_t;
+
+/* decode structure */
+struct $(proc)_decoder_t
+{
+	/* the fetch unit used to retrieve instruction ID */
+	$(proc)_fetch_t*     fetch;
+	/* cache shared with other decoders */
+	$(proc)_decode_cache_t *shared;
+	/* private cache for the instructions not fitting in the shared cache */
+	$(proc)_hashtable_t* cache;
+};
+
+
+static $(proc)_hashtable_t* create_hashtable (unsigned int size);
+static void hashtable_destroy($(proc)_hashtable_t* h );
+static void hashtable_insert($(proc)_hashtable_t* h, $(proc)_address_t key, $(proc)_inst_t* value);
+static $(proc)_inst_t* hashtable_search($(proc)_hashtable_t* h, $(proc)_address_t key);
+
+
+/**
+ * Build a new shared decode cache.
+ * @param bits	Log2 of the number of slots (0 for default).
+ * @return		Created cache (with one lock) or null if there is no more memory.
+ */
+$(proc)_decode_cache_t *$(proc)_new_decode_cache(unsigned int bits)
+{
+	$(proc)_decode_cache_t *cache;
+
+	if(bits == 0)
+		bits = SHARED_CACHE_BITS;
+	assert(bits < 30);
+	cache = ($(proc)_decode_cache_t *)malloc(sizeof($(proc)_decode_cache_t));
+	if(cache == NULL)
+		return NULL;
+	cache->slots = ($(proc)_inst_t **)calloc(1u << bits, sizeof($(proc)_inst_t *));
+	if(cache->slots == NULL) {
+		free(cache);
+		return NULL;
+	}
+	cache->usage = 1;
+	cache->bits = bits;
+	return cache;
+}
+
+
+/**
+ * Add a lock on the shared cache.
+ * @param cache		Cache to lock (may be null).
+ */
+void $(proc)_lock_decode_cache($(proc)_decode_cache_t *cache)
+{
+	if(cache != NULL)
+		__atomic_add_fetch(&cache->usage, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Release a lock on the shared cache. The cache and its instructions are
+ * freed with the last lock.
+ * @param cache		Cache to unlock (may be null).
+ */
+void $(proc)_unlock_decode_cache($(proc)_decode_cache_t *cache)
+{
+	unsigned int i;
+
+	if(cache == NULL || __atomic_sub_fetch(&cache->usage, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+	for(i = 0; i < (1u << cache->bits); i++)
+		if(cache->slots[i] != NULL)
+			free(cache->slots[i]);
+	free(cache->slots);
+	free(cache);
+}
+
+
+/**
+ * Get the decode cache of the platform, creating it if needed.
+ * @param pf	Platform.
+ * @return		Platform decode cache (null if there is no more memory).
+ */
+$(proc)_decode_cache_t *$(proc)_get_decode_cache($(proc)_platform_t *pf)
+{
+	$(proc)_decode_cache_t *cache = __atomic_load_n(&pf->decode_cache, __ATOMIC_ACQUIRE), *expected = NULL;
+
+	if(cache == NULL) {
+		cache = $(proc)_new_decode_cache(0);
+		if(cache == NULL)
+			return NULL;
+
+		/* another decoder may have created it at the same time */
+		if(!__atomic_compare_exchange_n(&pf->decode_cache, &expected, cache, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			$(proc)_unlock_decode_cache(cache);
+			cache = expected;
+		}
+	}
+	return cache;
+}
+
+
+/**
+ * Make the platform use the given decode cache: all simulators of platforms
+ * running the same code may share the same cache. Must be called before
+ * building the simulators of the platform.
+ * @param pf		Platform.
+ * @param cache		Cache to use.
+ */
+void $(proc)_set_decode_cache($(proc)_platform_t *pf, $(proc)_decode_cache_t *cache)
+{
+	$(proc)_lock_decode_cache(cache);
+	$(proc)_unlock_decode_cache(pf->decode_cache);
+	pf->decode_cache = cache;
+}
+
+
+/**
+ * Compute the first slot of an address.
+ * @param cache		Shared cache.
+ * @param address	Instruction address.
+ * @return			Slot index.
+ */
+static inline unsigned int shared_hash($(proc)_decode_cache_t *cache, $(proc)_address_t address)
+{
+	return ((uint32_t)address * 2654435761u) >> (32 - cache->bits);
+}
+
+
+/**
+ * Look for an instruction in the shared cache.
+ * @param cache		Shared cache.
+ * @param address	Instruction address.
+ * @return			Found instruction or null.
+ */
+static inline $(proc)_inst_t *shared_search($(proc)_decode_cache_t *cache, $(proc)_address_t address)
+{
+	unsigned int i = shared_hash(cache, address), n;
+	$(proc)_inst_t *inst;
+
+	for(n = 0; n < SHARED_CACHE_PROBES; n++) {
+		inst = __atomic_load_n(&cache->slots[i], __ATOMIC_ACQUIRE);
+		if(inst == NULL)
+			return NULL;
+		if(inst->addr == address)
+			return inst;
+		i = (i + 1) & ((1u << cache->bits) - 1);
+	}
+	return NULL;
+}
+
+
+/**
+ * Publish a decoded instruction in the shared cache.
+ * @param cache		Shared cache.
+ * @param inst		Decoded instruction.
+ * @return			Published instruction (inst or the instruction published
+ *					before by another decoder) or null if the slots are full.
+ */
+static $(proc)_inst_t *shared_publish($(proc)_decode_cache_t *cache, $(proc)_inst_t *inst)
+{
+	unsigned int i = shared_hash(cache, inst->addr), n;
+	$(proc)_inst_t *cur;
+
+	for(n = 0; n < SHARED_CACHE_PROBES; n++) {
+		cur = NULL;
+		if(__atomic_compare_exchange_n(&cache->slots[i], &cur, inst, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+			return inst;
+		if(cur->addr == inst->addr)
+			return cur;
+		i = (i + 1) & ((1u << cache->bits) - 1);
+	}
+	return NULL;
+}
+
+
+/* initialization and destruction of $(proc)_decode_t object */
+$(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf)
+{
+	$(proc)_decoder_t *res = malloc(sizeof($(proc)_decoder_t));
+	if (res == NULL) {
+		$(proc)_error("not enough memory to create a $(proc)_decoder_t object");
+		return NULL;
+	}
+	res->shared = $(proc)_get_decode_cache(pf);
+	res->cache = create_hashtable(CACHE_SIZE);
+	if(res->shared == NULL || res->cache == NULL) {
+		$(proc)_error("not enough memory to create a $(proc)_decoder_t object");
+		if(res->cache != NULL)
+			hashtable_destroy(res->cache);
+		free(res);
+		return NULL;
+	}
+	res->fetch = $(proc)_new_fetch(pf);
+	return res;
+}
+
+void $(proc)_delete_decoder($(proc)_decoder_t *decode)
+{
+	if (decode == NULL) {
+		$(proc)_error("cannot delete an NULL $(proc)_decoder_t object");
+		return;
+	}
+	$(proc)_delete_fetch(decode->fetch);
+	hashtable_destroy(decode->cache);
+	free(decode);
+}
+
+/** Does nothing as only one instr set is supported. */
+void $(proc)_set_cond_state($(proc)_decoder_t *decoder, $(proc)_state_t *state)
+{
+}
+
+
+/** @brief decode an instruction given address
+ *  The instruction is looked in the shared cache, then in the private
+ *  cache of the decoder and else decoded and published in the shared cache.
+ *  @param address of the instruction addr to be decoded
+ *  @return a heap allocated intruction which would be freed
+ *  with the shared cache or with the decoder (must not be freed).
+ * */
+$(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t address)
+{
+	$(proc)_inst_t *res, *pub;
+	$(proc)_ident_t id;
+$(if is_RISC)
+	uint$(C_inst_size)_t code;
+$(else)
+	/* init a buffer for the read instr, size should be max instr size for the given arch */
+	uint32_t i_buff[$(max_instruction_size) / 32 + ($(max_instruction_size) % 32? 1: 0)];
+	mask_t code = {i_buff, 0};
+$(end)
+
+	/* Is the instruction inside the caches ? */
+	res = shared_search(decoder->shared, address);
+	if(res != NULL)
+		return res;
+	res = hashtable_search(decoder->cache, address);
+	if(res != NULL)
+		return res;
+
+	/* If not found : */
+	/* first, fetch the instruction at the given address */
+	id   = $(proc)_fetch(decoder->fetch, address, &code);
+	/* then decode it */
+$(if GLISS_NO_MALLOC)
+	res = ($(proc)_inst_t*)malloc(sizeof($(proc)_inst_t));
+	$(proc)_decode_table[id]($(if !is_RISC)&$(end)code, res);
+$(else)
+	res = $(proc)_decode_table[id]($(if !is_RISC)&$(end)code);
+$(end)
+	res->addr = address;
+
+	/* and last publish or cache the instruction */
+	pub = shared_publish(decoder->shared, res);
+	if(pub == NULL)
+		hashtable_insert(decoder->cache, address, res);
+	else if(pub != res) {
+		free(res);
+		res = pub;
+	}
+	return res;
+}
+
+
+static $(proc)_hashtable_t* create_hashtable( unsigned int size )
+{
+    $(proc)_hashtable_t* h;
+    unsigned int i;
+    /* Check requested size is a power of two */
+    assert( size != 0 && (size & (size - 1)) == 0 );
+
+    h = ($(proc)_hashtable_t*)malloc( sizeof($(proc)_hashtable_t) );
+    if (NULL == h) return NULL; /*oom*/
+
+    h->table = ($(proc)_entry_t **)malloc( sizeof($(proc)_entry_t*) * size );
+    if (NULL == h->table)
+    {
+        free(h);
+        return NULL;
+    } /*oom*/
+
+    for(i = 0; i < size; i++)
+        h->table[i] = NULL;
+
+    h->tablelength  = size;
+    return h;
+}
+
+
+static void hashtable_insert($(proc)_hashtable_t* h, $(proc)_address_t key, $(proc)_inst_t* value)
+{
+    unsigned int   index;
+    $(proc)_entry_t* entry;
+    entry = ($(proc)_entry_t*)malloc( sizeof($(proc)_entry_t) );
+
+    index        = INDEX_FOR(h->tablelength, key);
+    entry->key   = key;
+    entry->value = value;
+    entry->next  = h->table[index];
+    h->table[index] = entry;
+}
+
+
+static $(proc)_inst_t* hashtable_search($(proc)_hashtable_t* h, $(proc)_address_t key)
+{
+    $(proc)_entry_t* entry = h->table[INDEX_FOR(h->tablelength, key)];
+
+    while (NULL != entry)
+    {
+        if (key == entry->key) return entry->value;
+        entry = entry->next;
+    }
+
+    return NULL;
+}
+
+static void hashtable_destroy($(proc)_hashtable_t* h)
+{
+    unsigned int i;
+    $(proc)_entry_t *e, *f;
+    $(proc)_entry_t **table = h->table;
+
+    for (i = 0; i < h->tablelength; i++)
+    {
+        e = table[i];
+        while (NULL != e){
+            f = e;
+            e = e->next;
+
+            free(f->value);
+            free(f);
+        }
+    }
+
+    free(h->table);
+    free(h);
+}
+/* End of file $(proc)_decode.c */
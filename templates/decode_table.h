@@ -120,8 +120,10 @@ void $(proc)_free_inst($(proc)_inst_t *inst) {
 	// NB : inst->instrinput is allocate with the same malloc which allocate an instr
 
 	$(if !GLISS_NO_MALLOC)$(if !GLISS_INF_DECODE_CACHE)$(if !GLISS_FIXED_DECODE_CACHE)$(if !GLISS_LRU_DECODE_CACHE)
+#if !defined($(PROC)_FLAT_DECODE) && !defined($(PROC)_SHARED_DECODE_CACHE)
     /* finally free it */
 	free(inst);
+#endif
 	$(end)$(end)$(end)$(end)
 }
 
@@ -48,6 +48,12 @@ struct $(proc)_decoder_t
 $(if is_multi_set)	/* help determine which decode type if several instr sets defined */
 	$(proc)_state_t *state;
 	$(proc)_platform_t *pf;$(end)
+#ifdef $(PROC)_MEM_WATCH
+	/* self-modifying code detection */
+	$(proc)_memory_t *mem;		/* watched memory */
+	int smc;					/* 1 if decoded code has been written */
+	$(proc)_address_t smc_low, smc_high;	/* written code range */
+#endif
 };
 
 
@@ -65,9 +71,55 @@ static $(proc)_inst_t* hashtable_search($(proc)_hashtable_t* h, $(proc)_address_
 $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t address);
 
 
-/* initialization and destruction of $(proc)_decode_t object */
-static int number_of_decoder_objects = 0;
+#ifdef $(PROC)_MEM_WATCH
+
+/**
+ * Called at the first write to a page containing decoded instructions:
+ * the written range is only recorded as the instruction performing
+ * the write may be in the current trace.
+ * @param mem		Written memory.
+ * @param address	Address of the written page.
+ * @param size		Size of the written page.
+ * @param data		Watching decoder.
+ */
+static void decoder_watcher($(proc)_memory_t *mem, $(proc)_address_t address, uint32_t size, void *data)
+{
+	$(proc)_decoder_t *d = ($(proc)_decoder_t *)data;
+	$(proc)_address_t high = address + (size - 1);
+	if(!d->smc || address < d->smc_low)
+		d->smc_low = address;
+	if(!d->smc || high > d->smc_high)
+		d->smc_high = high;
+	d->smc = 1;
+}
+
+/* test if the given bytes overlap the written code range */
+#define SMC_HIT(d, a, s)	((a) <= (d)->smc_high && (a) + ((s) - 1) >= (d)->smc_low)
+
+/**
+ * Invalidate the traces overlapping the written code range (the
+ * current trace remains usable until its entry is reused).
+ * @param d		Decoder to invalidate in.
+ */
+static void decoder_invalidate($(proc)_decoder_t *d)
+{
+	unsigned int i;
+	$(proc)_entry_t *e = d->cache->entry_tab;
+	for(i = 0; i < CACHE_SIZE * CACHE_DEPTH; i++)
+		if(SMC_HIT(d, e[i].key, TRACE_DEPTH << 2))
+			e[i].key = -1;
+	d->smc = 0;
+}
+
+#	define SMC_CHECK(d)			if((d)->smc) decoder_invalidate(d)
+#	define SMC_WATCH(d, a, s)	do { $(proc)_mem_watch((d)->mem, (a)); $(proc)_mem_watch((d)->mem, (a) + ((s) - 1)); } while(0)
+#else
+#	define SMC_CHECK(d)
+#	define SMC_WATCH(d, a, s)
+#endif
+
 
+/* initialization and destruction of $(proc)_decode_t object */
 static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 {
         $(if is_multi_set)d->fetch = NULL;
@@ -77,10 +129,18 @@ static void init_decoder($(proc)_decoder_t *d, $(proc)_platform_t *pf)
 	$(end)
         d->cache = create_hashtable( CACHE_SIZE, CACHE_DEPTH );
 
+#	ifdef $(PROC)_MEM_WATCH
+		d->mem = $(proc)_get_memory(pf, $(PROC)_MAIN_MEMORY);
+		d->smc = 0;
+		$(proc)_mem_add_watcher(d->mem, decoder_watcher, d);
+#	endif
 }
 
 static void halt_decoder($(proc)_decoder_t *d)
 {
+#	ifdef $(PROC)_MEM_WATCH
+		$(proc)_mem_remove_watcher(d->mem, decoder_watcher, d);
+#	endif
         $(proc)_delete_fetch(d->fetch);
         hashtable_destroy(d->cache);
 
@@ -91,9 +151,7 @@ $(proc)_decoder_t *$(proc)_new_decoder($(proc)_platform_t *pf)
     $(proc)_decoder_t *res = malloc(sizeof($(proc)_decoder_t));
     if (res == NULL)
                 $(proc)_error("not enough memory to create a $(proc)_decoder_t object"); /* I assume error handling will remain the same, we use $(proc)_error istead of iss_error ? */
-    /*assert(number_of_decode_objects >= 0);*/
     init_decoder(res, pf);
-    number_of_decoder_objects++;
     return res;
 }
 
@@ -102,8 +160,6 @@ void $(proc)_delete_decoder($(proc)_decoder_t *decode)
     if (decode == NULL)
         /* we shouldn't try to free a void decoder_t object, should this output an error ? */
                 $(proc)_error("cannot delete an NULL $(proc)_decoder_t object");
-    number_of_decoder_objects--;
-    /*assert(number_of_decode_objects >= 0);*/
     halt_decoder(decode);
     free(decode);
 }
@@ -221,6 +277,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	uint$(C_inst_size)_t code;
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -235,6 +294,7 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 		$(proc)_decode_table[id](code, (res+i));
 		(res+i)->addr = block_addr + (i<<2);
 	}
+	SMC_WATCH(decoder, block_addr, TRACE_DEPTH << 2);
 	return res;
 }
 $(else)
@@ -247,6 +307,9 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 	mask_t code = {i_buff, 0};
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -261,6 +324,7 @@ $(proc)_inst_t *$(proc)_decode($(proc)_decoder_t *decoder, $(proc)_address_t add
 		$(proc)_decode_table[id](&code, (res+i));
 		(res+i)->addr = block_addr + (i<<2);
 	}
+	SMC_WATCH(decoder, block_addr, TRACE_DEPTH << 2);
 	return res;
 }
 $(end)$(end)
@@ -290,6 +354,9 @@ $(proc)_inst_t *$(proc)_decode_$(if is_RISC_size)$(C_size)$(else)CISC$(end)($(pr
 	code.mask = {i_buff, 0};$(end)
 	int i;
 
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -304,6 +371,7 @@ $(proc)_inst_t *$(proc)_decode_$(if is_RISC_size)$(C_size)$(else)CISC$(end)($(pr
 		$(proc)_decode_table[id](&code, (res+i));
 		(res+i)->addr = block_addr + (i<<2);
 	}
+	SMC_WATCH(decoder, block_addr, TRACE_DEPTH << 2);
 	return res;
 }
 $(end)$(end)
@@ -334,6 +402,9 @@ $(proc)_inst_t *$(proc)_decode_$(iset_name)($(proc)_decoder_t *decoder, $(proc)_
 	code.mask = {i_buff, 0};$(end)
 	int i;
 	
+	/* has decoded code been written ? */
+	SMC_CHECK(decoder);
+
 	/* Is the instruction inside the cache ? */
 	int inst_in_cache = cache_lookup(decoder, address, &res);
 	if (inst_in_cache) {
@@ -349,6 +420,7 @@ $(proc)_inst_t *$(proc)_decode_$(iset_name)($(proc)_decoder_t *decoder, $(proc)_
 		$(proc)_decode_table[id](&code, (res+i));
 		(res+i)->addr = block_addr + (i<<2);
 	}
+	SMC_WATCH(decoder, block_addr, TRACE_DEPTH << 2);
 	return res;
 }
 $(end)
@@ -25,10 +25,11 @@ $(proc)_label_solver_t $(proc)_solve_label = $(proc)_solve_label_null;
 /**
  * Default label solver.
  * @param address	Address to look a label for.
- * @return			Buffer to solved label (may be destroyed between two calls to this function).
+ * @return			Buffer to solved label (may be destroyed between two calls to this function
+ * 					in the same thread).
  */
 char *$(proc)_solve_label_null($(proc)_address_t address) {
-	static char buf[10];
+	static __thread char buf[10];
 	sprintf(buf, "%08x", address);
 	return buf;
 }
@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <$(proc)/mem.h>
 #include <$(proc)/fetch.h>
@@ -12,25 +13,22 @@ $(if is_CISC_present)#include <$(proc)/gen_int.h>$(end)
 
 #define $(proc)_error(e) fprintf(stderr, "%s\n", (e))
 
-
-/**
- * Halt the fetch module.
- */
-static void halt_fetch(void) {
-}
-
-/**
- * Initialize the fetch module.
- */
-static void init_fetch(void) {
-}
-
+/* opcode extraction with the BMI2 parallel bit extract (unless $(PROC)_NO_PEXT) */
+#if defined(__BMI2__) && !defined($(PROC)_NO_PEXT)
+#	include <immintrin.h>
+#	define $(PROC)_PEXT8(i, m)		_pext_u32((i), (m))
+#	define $(PROC)_PEXT16(i, m)	_pext_u32((i), (m))
+#	define $(PROC)_PEXT32(i, m)	_pext_u32((i), (m))
+#	ifdef __x86_64__
+#		define $(PROC)_PEXT64(i, m)	_pext_u64((i), (m))
+#	endif
+#endif
 
 
-/**
- *  initialization and destruction of $(proc)_fetch_t object
+/*
+ * initialization and destruction of $(proc)_fetch_t object
+ * (fetch objects do not share any global state)
  */
-static int number_of_fetch_objects = 0;
 
 
 /**
@@ -45,9 +43,9 @@ $(proc)_fetch_t *$(proc)_new_fetch($(proc)_platform_t *pf$(if is_multi_set), $(p
 		$(proc)_error("not enough memory to create a $(proc)_fetch_t object"); /* I assume error handling will remain the same, we use $(proc)_error instead of iss_error ? */
 	res->mem = $(proc)_get_memory(pf, $(PROC)_MAIN_MEMORY);
 	$(if is_multi_set)res->state = state;$(end)
-	if (number_of_fetch_objects == 0)
-		init_fetch();
-	number_of_fetch_objects++;
+$(if is_CISC_present)#	ifdef $(PROC)_MEM_WATCH
+		res->win_size = 0;
+#	endif$(end)
 	return res;
 }
 
@@ -62,35 +60,25 @@ void $(proc)_delete_fetch($(proc)_fetch_t *fetch)
 		/* we shouldn't try to free a void fetch_t object, should this output an error ? */
 		$(proc)_error("cannot delete an NULL $(proc)_fetch_t object");
 	free(fetch);
-	number_of_fetch_objects--;
-	/*assert(number_of_fetch_objects >= 0);*/
-	if (number_of_fetch_objects == 0)
-		halt_fetch();
 }
 
 $(foreach instruction_sets_sizes)
 $(if is_RISC_size)			//$ RISC instruction set
 
 /**
- * Assemble bits representing the opcode.
+ * Assemble bits representing the opcode, either with the host
+ * parallel bit extract or with the shift/mask sequence generated
+ * for the table.
  * @param	instr	Instruction work.
- * @param	mask	Mask of bits to group.
+ * @param	table	Decoding table whose mask bits are grouped.
  * @return			Opcode.
  */
-static uint$(C_size)_t make_opcode$(C_size)(uint$(C_size)_t instr, uint$(C_size)_t mask) {
-	int i;
-	uint$(C_size)_t tmp_mask;
-	uint$(C_size)_t res = 0;
-
-	tmp_mask = mask;
-	for (i = $(C_size) - 1; i >= 0; i--) {
-		if (tmp_mask & $(msb_size_mask)) {
-			res <<= 1;
-			res |= ((instr >> i) & 0x01);
-		}
-		tmp_mask <<= 1;
-	}
-	return res;
+static inline uint$(C_size)_t make_opcode$(C_size)(uint$(C_size)_t instr, Table_Decodage$(if is_multi_set)_$(C_size)$(end) *table) {
+#	ifdef $(PROC)_PEXT$(C_size)
+		return $(PROC)_PEXT$(C_size)(instr, table->mask);
+#	else
+		return table->extract(instr);
+#	endif
 }
 
 
@@ -106,23 +94,66 @@ $(proc)_ident_t $(proc)_fetch_$(C_size)($(proc)_fetch_t *fetch, $(proc)_address_
 $(else)//$ 					RISC mono-set
 $(proc)_ident_t $(proc)_fetch($(proc)_fetch_t *fetch, $(proc)_address_t address, uint$(C_size)_t *code) {
 $(end)
-	uint$(C_size)_t valeur;
-	Table_Decodage$(if is_multi_set)_$(C_size)$(end) *ptr;
-	Table_Decodage$(if is_multi_set)_$(C_size)$(end) *ptr2 = $(if !is_multi_set)$(proc)_$(end)table;
 	*code = $(proc)_mem_read$(C_size)(fetch->mem, address);
 #	ifdef $(PROC)_ORDER_BYTES$(C_size) 
 		{ uint8_t *buff = (uint8_t *)code; $(PROC)_ORDER_BYTES$(C_size); }
 #	endif
+#	ifdef $(PROC)_SWITCH_FETCH
+		return $(if is_multi_set)table->decode$(else)decode_table$(end)(*code);
+#	else
+	uint$(C_size)_t valeur;
+	Table_Decodage$(if is_multi_set)_$(C_size)$(end) *ptr;
+	Table_Decodage$(if is_multi_set)_$(C_size)$(end) *ptr2 = $(if !is_multi_set)$(proc)_$(end)table;
 	do {
-		valeur = make_opcode$(C_size)(*code, ptr2->mask);
+		valeur = make_opcode$(C_size)(*code, ptr2);
 		ptr  = ptr2;
 		ptr2 = ptr->table[valeur].ptr;
 	} while(ptr->table[valeur].type == TABLEFETCH);
 	return ($(proc)_ident_t)ptr->table[valeur].ptr;
+#	endif
 }
 
 $(else)//$ 					CISC instruction set
 
+#ifdef $(PROC)_MEM_WATCH
+/**
+ * Read instruction bytes through the window of the fetch handler:
+ * the window is refilled with the aligned block of $(PROC)_FETCH_WINDOW
+ * bytes containing the read bytes and its page is watched to detect
+ * the writes making the window out of date.
+ * @param fetch		Fetch handler.
+ * @param address	Address of the bytes.
+ * @param buff		Buffer to store the bytes in.
+ * @param size		Number of bytes to read.
+ */
+static void $(proc)_fetch_read($(proc)_fetch_t *fetch, $(proc)_address_t address, uint8_t *buff, uint32_t size) {
+	while(size > 0) {
+		$(proc)_address_t off = address - fetch->win_addr;
+		uint32_t n;
+
+		/* refill the window */
+		if(off >= fetch->win_size) {
+			fetch->win_addr = address & ~(($(proc)_address_t)$(PROC)_FETCH_WINDOW - 1);
+			$(proc)_mem_watch(fetch->mem, fetch->win_addr);
+			$(proc)_mem_read(fetch->mem, fetch->win_addr, fetch->win, $(PROC)_FETCH_WINDOW);
+			fetch->win_size = $(PROC)_FETCH_WINDOW;
+			fetch->win_stamp = $(proc)_mem_watch_stamp(fetch->mem);
+			off = address - fetch->win_addr;
+		}
+
+		/* copy from the window */
+		n = fetch->win_size - off;
+		if(n > size)
+			n = size;
+		memcpy(buff, fetch->win + off, n);
+		buff += n;
+		address += n;
+		size -= n;
+	}
+}
+#endif
+
+
 /**
  * Fetch and decode an instruction (for CISC instruction set).
  * @param fetch		Fetch handler.
@@ -140,13 +171,23 @@ $(end)
 	Table_Decodage_CISC *ptr;
 	Table_Decodage_CISC *ptr2 = $(if !is_multi_set)$(proc)_$(end)table;
 
+#	ifdef $(PROC)_MEM_WATCH
+		/* the memory has been written since the window was filled */
+		if(fetch->win_stamp != $(proc)_mem_watch_stamp(fetch->mem))
+			fetch->win_size = 0;
+#	endif
+
 	do {
 		
 		/* if inst buffer has not enough bits to apply mask, read and add what's needed, read a 32 bit chunk (like in mask_t) at a time */
 		while (get_mask_length(code) < get_mask_length(ptr2->mask)) {
 			uint8_t buff[4];
 			uint32_t word;
-			$(proc)_mem_read(fetch->mem, address + (get_mask_length(code) >> 3), buff, 4);
+#			ifdef $(PROC)_MEM_WATCH
+				$(proc)_fetch_read(fetch, address + (get_mask_length(code) >> 3), buff, 4);
+#			else
+				$(proc)_mem_read(fetch->mem, address + (get_mask_length(code) >> 3), buff, 4);
+#			endif
 #			ifdef $(PROC)_ORDER_BYTES_CISC
 				$(PROC)_ORDER_BYTES_CISC;
 #			elif HOST_ENDIANNESS == TARGET_ENDIANNESS
@@ -15,6 +15,12 @@ extern  "C"
 #define $(PROC)_FETCH_STATE
 #define $(PROC)_FETCH_INIT(s)
 #define $(PROC)_FETCH_DESTROY(s)
+$(if is_CISC_present)
+/* size of the instruction byte window of the CISC fetch (power of 2) */
+#ifndef $(PROC)_FETCH_WINDOW
+#	define $(PROC)_FETCH_WINDOW	64
+#endif
+$(end)
 
 /* fetch structure */
 struct $(proc)_fetch_t
@@ -23,6 +29,14 @@ struct $(proc)_fetch_t
 	$(proc)_memory_t *mem;
 $(if is_multi_set)/* state used to determine correct fetch */
 	$(proc)_state_t *state;$(end)
+$(if is_CISC_present)#ifdef $(PROC)_MEM_WATCH
+	/* copy of the instruction bytes around the last fetched address (CISC),
+	   valid while the watch stamp of the memory does not change */
+	$(proc)_address_t win_addr;
+	uint32_t win_size;
+	uint32_t win_stamp;
+	uint8_t win[$(PROC)_FETCH_WINDOW];
+#endif$(end)
 };
 
 #if defined(__cplusplus)
@@ -37,6 +37,8 @@ $(if is_RISC_size)
 typedef struct Table_Decodage_$(C_size) {
         uint$(C_size)_t        mask;
         Decode_Ent      *table;
+        uint$(C_size)_t        (*extract)(uint$(C_size)_t code);	/* gathers the bits of mask */
+        $(proc)_ident_t        (*decode)(uint$(C_size)_t code);	/* decoding switch of the root table (-fswitch) */
 } Table_Decodage_$(C_size);
 $(else)
 /* CISC multi-instruction set */
@@ -51,6 +53,8 @@ $(if is_RISC)
 typedef struct Table_Decodage {
         uint$(C_inst_size)_t        mask;
         Decode_Ent      *table;
+        uint$(C_inst_size)_t        (*extract)(uint$(C_inst_size)_t code);	/* gathers the bits of mask */
+        $(proc)_ident_t        (*decode)(uint$(C_inst_size)_t code);	/* decoding switch of the root table (-fswitch) */
 } Table_Decodage;
 $(else)
 /* CISC single instruction set */
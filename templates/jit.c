@@ -0,0 +1,662 @@
+/* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
+
+/*
+ * Block translator: the hot blocks of guest instructions are translated
+ * into x86-64 host code by copying and patching the host code templates
+ * (stencils) of the instructions. The stencils are the instruction codes
+ * generated by gep from the NML semantics, compiled by the C compiler with
+ * holes for the instruction address and the operands (see jit_stencils.c
+ * and jit-mkstencils), so that the translated code contains the semantics
+ * of the instructions with constant operands. After each instruction, the
+ * host code checks that the execution is sequential and that no translated
+ * code has been written; else it returns to the run loop that falls back
+ * to the interpreter. The end of a block jumps directly to the blocks
+ * executed after it (block chaining).
+ *
+ * The host code buffer is never writable and executable at once: the pages
+ * of a block are made writable to emit it, then read-only and executable.
+ * The chaining slots are data read by the host code, so that chaining does
+ * not modify the host code.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <$(proc)/api.h>
+#include <$(proc)/macros.h>
+$(foreach modules)
+#include <$(proc)/$(name).h>
+$(end)
+#include "jit.h"
+
+/* the translator needs an x86-64 host and a memory watching code pages */
+$(if !is_multi_set)
+#if defined(__x86_64__) && defined($(PROC)_MEM_WATCH) && !defined($(PROC)_TRACE_CACHE) && !defined($(PROC)_DTRACE_CACHE) && !defined($(PROC)_NO_JIT)
+#	define $(PROC)_JIT_HOST
+#endif
+$(end)
+
+#ifdef $(PROC)_JIT_HOST
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define $(proc)_error(e) fprintf(stderr, "%s\n", (e))
+
+/* size of the host code buffer */
+#ifndef $(PROC)_JIT_CODE_SIZE
+#	define $(PROC)_JIT_CODE_SIZE	(16 << 20)
+#endif
+/* size of the data of the host code (chaining slots) */
+#ifndef $(PROC)_JIT_DATA_SIZE
+#	define $(PROC)_JIT_DATA_SIZE	(1 << 20)
+#endif
+/* number of hash buckets of the translation cache (power of 2) */
+#ifndef $(PROC)_JIT_HASH_SIZE
+#	define $(PROC)_JIT_HASH_SIZE	4096
+#endif
+/* number of execution counters of the not translated addresses (power of 2) */
+#ifndef $(PROC)_JIT_HEAT_SIZE
+#	define $(PROC)_JIT_HEAT_SIZE	4096
+#endif
+/* a block does not cross the boundary of these pages */
+#define $(PROC)_JIT_PAGE_BITS	12
+
+/* size of the host code around the stencils */
+#define $(PROC)_JIT_INST_GLUE	40
+#define $(PROC)_JIT_BLOCK_GLUE	128
+
+/* instructions are released as in $(proc)_run_n() */
+$(if !GLISS_NO_MALLOC)
+#if !defined($(PROC)_INF_DECODE_CACHE) && !defined($(PROC)_FIXED_DECODE_CACHE) && !defined($(PROC)_LRU_DECODE_CACHE) && !defined($(PROC)_FLAT_DECODE) && !defined($(PROC)_SHARED_DECODE_CACHE)
+#	define JIT_FREE(i)		$(proc)_free_inst(i)
+#endif
+$(end)
+#ifndef JIT_FREE
+#	define JIT_FREE(i)
+#endif
+
+/* data accessed by the host code (at the start of the data area) */
+typedef struct $(proc)_jit_shared_t {
+	uint64_t count;						/* executed instruction count */
+	uint64_t limit;						/* no chaining after this count */
+	$(proc)_jit_block_t *last;			/* last block returning to the run loop */
+	int smc;							/* 1 if translated code has been written */
+} $(proc)_jit_shared_t;
+
+/* chaining slots of a block (in the data area) */
+typedef struct $(proc)_jit_slots_t {
+	uint64_t address[2];				/* chained address */
+	unsigned char *target[2];			/* host code to jump to */
+} $(proc)_jit_slots_t;
+
+/* translator */
+struct $(proc)_jit_t {
+	$(proc)_sim_t *sim;
+	$(proc)_memory_t *mem;				/* watched memory */
+	unsigned char *buf;					/* data area followed by the host code */
+	unsigned char *dtop;				/* first free byte in the data area */
+	unsigned char *code;				/* start of the host code */
+	unsigned char *top;					/* first free byte in the host code */
+	uintptr_t page;						/* host page size */
+	$(proc)_jit_shared_t *shared;		/* data of the host code */
+	$(proc)_jit_block_t *hash[$(PROC)_JIT_HASH_SIZE];
+	uint8_t heat[$(PROC)_JIT_HEAT_SIZE];	/* execution counters */
+	$(proc)_address_t smc_low, smc_high;	/* written code range */
+};
+
+#define HASH(a)		((((a) >> $(PROC)_JIT_PAGE_BITS) ^ (a)) & ($(PROC)_JIT_HASH_SIZE - 1))
+#define HEAT(a)		((((a) >> $(PROC)_JIT_PAGE_BITS) ^ (a)) & ($(PROC)_JIT_HEAT_SIZE - 1))
+
+/* conversion of the operands to the values patched in the stencils */
+#define $(PROC)_JIT_BITS_int8(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_uint8(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_int16(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_uint16(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_int32(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_uint32(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_int64(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS_uint64(v)			((uint64_t)(v))
+#define $(PROC)_JIT_BITS__float(v)			$(proc)_jit_float_bits(v)
+#define $(PROC)_JIT_BITS__double(v)			$(proc)_jit_double_bits(v)
+#define $(PROC)_JIT_BITS__long_double(v)	0
+#define $(PROC)_JIT_BITS_string(v)			0
+
+static inline uint64_t $(proc)_jit_float_bits(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+static inline uint64_t $(proc)_jit_double_bits(double d) {
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+/**
+ * Get the value patched for an operand of an instruction.
+ * @param inst	Decoded instruction.
+ * @param k		Operand index.
+ * @return		Bits of the operand value.
+ */
+static uint64_t jit_operand($(proc)_inst_t *inst, int k)
+{
+	switch(inst->ident) {
+$(foreach instructions)$(if has_param)
+	case $(PROC)_$(IDENT):
+		switch(k) {
+$(foreach params)		case $(INDEX): return $(PROC)_JIT_BITS_$(param_type)($(PROC)_$(IDENT)_$(PARAM));
+$(end)		}
+		break;
+$(end)$(end)
+	default:
+		break;
+	}
+	return 0;
+}
+
+/* x86-64 encoding */
+#define RAX		0
+#define RCX		1
+#define RDI		7
+#define JNE		0x85
+#define JA		0x87
+
+/* emit a 32-bit value */
+static inline unsigned char *emit32(unsigned char *p, uint32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+	return p + sizeof(v);
+}
+
+/* emit a 64-bit value */
+static inline unsigned char *emit64(unsigned char *p, uint64_t v)
+{
+	memcpy(p, &v, sizeof(v));
+	return p + sizeof(v);
+}
+
+/* emit "mov reg, imm64" */
+static inline unsigned char *emit_movi(unsigned char *p, int reg, uint64_t v)
+{
+	*p++ = 0x48;
+	*p++ = 0xB8 + reg;
+	return emit64(p, v);
+}
+
+/* emit the ModRM and displacement of [rdi + off] */
+static inline unsigned char *emit_rdi(unsigned char *p, int reg, uint32_t off)
+{
+	if(off < 128) {
+		*p++ = 0x40 | (reg << 3) | RDI;
+		*p++ = off;
+		return p;
+	}
+	else {
+		*p++ = 0x80 | (reg << 3) | RDI;
+		return emit32(p, off);
+	}
+}
+
+/* emit the ModRM and displacement of [rip + disp] where the instruction ends size bytes after */
+static inline unsigned char *emit_rip(unsigned char *p, int reg, void *target, int size)
+{
+	*p++ = (reg << 3) | 5;
+	return emit32(p, (uint32_t)(int32_t)((unsigned char *)target - (p + 4 + size)));
+}
+
+/* emit "jcc rel32" to be fixed later: the rel32 is just before the returned pointer */
+static inline unsigned char *emit_jcc(unsigned char *p, int cc)
+{
+	*p++ = 0x0F;
+	*p++ = cc;
+	return emit32(p, 0);
+}
+
+/* fix the rel32 at the given address to jump to target */
+static inline void fix_rel32(unsigned char *rel, unsigned char *target)
+{
+	int32_t d = (int32_t)(target - (rel + 4));
+	memcpy(rel, &d, sizeof(d));
+}
+
+/* emit "cmp byte [rip + smc], 0" */
+static inline unsigned char *emit_test_smc(unsigned char *p, $(proc)_jit_t *jit)
+{
+	*p++ = 0x80;
+	p = emit_rip(p, 7, &jit->shared->smc, 1);
+	*p++ = 0x00;
+	return p;
+}
+
+/* emit the comparison of the PC (state in rdi) with the given address */
+static inline unsigned char *emit_cmp_pc(unsigned char *p, $(proc)_address_t address)
+{
+	uint32_t off = offsetof($(proc)_state_t, $(pc_name));
+	if(sizeof((($(proc)_state_t *)0)->$(pc_name)) == 4) {
+		*p++ = 0x81;						/* cmp dword [rdi + off], imm32 */
+		p = emit_rdi(p, 7, off);
+		return emit32(p, (uint32_t)address);
+	}
+	else {
+		p = emit_movi(p, RAX, (uint64_t)address);
+		*p++ = 0x48;						/* cmp [rdi + off], rax */
+		*p++ = 0x39;
+		return emit_rdi(p, RAX, off);
+	}
+}
+
+
+/**
+ * Set a chaining slot of a block.
+ * @param b			Block containing the slot.
+ * @param s			Slot index.
+ * @param target	Chained block (NULL to reset the slot).
+ */
+static void jit_set_slot($(proc)_jit_block_t *b, int s, $(proc)_jit_block_t *target)
+{
+	b->slots->address[s] = target == NULL ? (uint64_t)-1 : (uint64_t)target->address;
+	b->slots->target[s] = target == NULL ? b->exit : target->code;
+	b->succ[s] = target;
+}
+
+
+/**
+ * Change the protection of the host code pages of a range.
+ * @param jit	Current translator.
+ * @param p		Range start.
+ * @param q		Range end.
+ * @param prot	New protection.
+ * @return		0 for success, -1 else.
+ */
+static int jit_protect($(proc)_jit_t *jit, unsigned char *p, unsigned char *q, int prot)
+{
+	uintptr_t low = (uintptr_t)p & ~(jit->page - 1);
+	uintptr_t high = ((uintptr_t)q + jit->page - 1) & ~(jit->page - 1);
+	return mprotect((void *)low, high - low, prot);
+}
+
+
+/**
+ * Called at the first write to a page containing translated code:
+ * the written range is only recorded as the writing instruction may be
+ * executed from the translated code.
+ * @param mem		Written memory.
+ * @param address	Address of the written page.
+ * @param size		Size of the written page.
+ * @param data		Watching translator.
+ */
+static void jit_watcher($(proc)_memory_t *mem, $(proc)_address_t address, uint32_t size, void *data)
+{
+	$(proc)_jit_t *jit = ($(proc)_jit_t *)data;
+	$(proc)_address_t high = address + (size - 1);
+	if(!jit->shared->smc || address < jit->smc_low)
+		jit->smc_low = address;
+	if(!jit->shared->smc || high > jit->smc_high)
+		jit->smc_high = high;
+	jit->shared->smc = 1;
+}
+
+
+/**
+ * Remove the translated blocks overlapping the written code range and
+ * reset the chaining slots jumping to them. The host code of removed
+ * blocks is only reclaimed by the next flush.
+ * @param jit	Translator to invalidate in.
+ */
+static void jit_invalidate($(proc)_jit_t *jit)
+{
+	$(proc)_jit_block_t **pb, *b, *dead = NULL;
+	int i, s;
+
+	/* unlink the written blocks */
+	for(i = 0; i < $(PROC)_JIT_HASH_SIZE; i++)
+		for(pb = &jit->hash[i]; *pb != NULL;) {
+			b = *pb;
+			if(b->address <= jit->smc_high && b->address + (b->size - 1) >= jit->smc_low) {
+				*pb = b->next;
+				b->dead = 1;
+				b->next = dead;
+				dead = b;
+			}
+			else
+				pb = &b->next;
+		}
+
+	/* unchain them */
+	for(i = 0; i < $(PROC)_JIT_HASH_SIZE; i++)
+		for(b = jit->hash[i]; b != NULL; b = b->next)
+			for(s = 0; s < 2; s++)
+				if(b->succ[s] != NULL && b->succ[s]->dead)
+					jit_set_slot(b, s, NULL);
+
+	/* release them */
+	while(dead != NULL) {
+		b = dead;
+		dead = b->next;
+		if(jit->shared->last == b)
+			jit->shared->last = NULL;
+		free(b);
+	}
+	jit->shared->smc = 0;
+}
+
+
+/**
+ * Translate the block at the given address.
+ * @param jit		Current translator.
+ * @param address	Block address.
+ * @return			Translated block or NULL if it cannot be translated.
+ */
+static $(proc)_jit_block_t *jit_translate($(proc)_jit_t *jit, $(proc)_address_t address)
+{
+	$(proc)_sim_t *sim = jit->sim;
+	$(proc)_inst_t insts[$(PROC)_JIT_BLOCK_MAX], *inst;
+	unsigned char *exits[$(PROC)_JIT_BLOCK_MAX][2];
+	$(proc)_address_t a = address, next[$(PROC)_JIT_BLOCK_MAX];
+	const $(proc)_jit_stencil_t *st;
+	$(proc)_jit_block_t *b;
+	unsigned char *p, *tail, *fix[3];
+	size_t size = $(PROC)_JIT_BLOCK_GLUE;
+	int n, i, s;
+
+	/* decode the block: stop before breakpoints, not translated instructions and page change */
+	for(n = 0; n < $(PROC)_JIT_BLOCK_MAX; n++) {
+		if(n != 0 && ($(proc)_is_breakpoint(sim, a)
+		|| (a >> $(PROC)_JIT_PAGE_BITS) != (address >> $(PROC)_JIT_PAGE_BITS)))
+			break;
+		inst = $(proc)_decode(sim->decoder, a);
+		if(inst == NULL)
+			break;
+		insts[n] = *inst;
+		JIT_FREE(inst);
+		if(insts[n].ident == $(PROC)_UNKNOWN || $(proc)_jit_stencils[insts[n].ident].code == NULL)
+			break;
+		size += $(proc)_jit_stencils[insts[n].ident].size + $(PROC)_JIT_INST_GLUE;
+		a += $(proc)_get_inst_size(&insts[n]) / 8;
+		next[n] = a;
+	}
+	if(n == 0)
+		return NULL;
+
+	/* allocate the block */
+	if(jit->top + size > jit->buf + $(PROC)_JIT_DATA_SIZE + $(PROC)_JIT_CODE_SIZE
+	|| jit->dtop + sizeof($(proc)_jit_slots_t) > jit->code) {
+		$(proc)_jit_flush(jit);
+		return NULL;
+	}
+	b = ($(proc)_jit_block_t *)calloc(1, sizeof($(proc)_jit_block_t));
+	if(b == NULL)
+		return NULL;
+	if(jit_protect(jit, jit->top, jit->top + size, PROT_READ | PROT_WRITE) != 0) {
+		free(b);
+		return NULL;
+	}
+	b->address = address;
+	b->n = n;
+	b->size = a - address;
+	b->slots = ($(proc)_jit_slots_t *)jit->dtop;
+	jit->dtop += sizeof($(proc)_jit_slots_t);
+
+	/* instructions: patched stencil and check (state in rdi) */
+	p = b->code = jit->top;
+	for(i = 0; i < n; i++) {
+		st = &$(proc)_jit_stencils[insts[i].ident];
+		memcpy(p, st->code, st->size);
+		for(s = 0; s < (int)st->hole_cnt; s++) {
+			const $(proc)_jit_hole_t *h = &st->holes[s];
+			uint64_t v;
+			switch(h->kind) {
+			case $(PROC)_JIT_HOLE_ABS:	v = (uint64_t)(uintptr_t)h->base; break;
+			case $(PROC)_JIT_HOLE_ADDR:	v = (uint64_t)insts[i].addr; break;
+			case $(PROC)_JIT_HOLE_NEXT:	v = (uint64_t)(uintptr_t)(p + st->size); break;
+			default:					v = jit_operand(&insts[i], h->kind - $(PROC)_JIT_HOLE_OP); break;
+			}
+			v += (uint64_t)h->addend;
+			memcpy(p + h->offset, &v, h->size);
+		}
+		p += st->size;
+		if(i == n - 1)
+			break;
+		p = emit_cmp_pc(p, next[i]);
+		p = emit_jcc(p, JNE);
+		exits[i][0] = p - 4;
+		p = emit_test_smc(p, jit);
+		p = emit_jcc(p, JNE);
+		exits[i][1] = p - 4;
+	}
+	*p++ = 0xB8;								/* mov eax, n */
+	p = emit32(p, n);
+
+	/* tail: count the instructions in rax */
+	tail = p;
+	*p++ = 0x48; *p++ = 0x01;					/* add [rip + count], rax */
+	p = emit_rip(p, RAX, &jit->shared->count, 0);
+	*p++ = 0x48; *p++ = 0x8B;					/* mov rax, [rip + count] */
+	p = emit_rip(p, RAX, &jit->shared->count, 0);
+	*p++ = 0x48; *p++ = 0x3B;					/* cmp rax, [rip + limit] */
+	p = emit_rip(p, RAX, &jit->shared->limit, 0);
+	p = emit_jcc(p, JA);
+	fix[0] = p - 4;
+	p = emit_test_smc(p, jit);
+	p = emit_jcc(p, JNE);
+	fix[1] = p - 4;
+	p = emit_movi(p, RAX, (uintptr_t)&sim->ended);
+	*p++ = 0x83; *p++ = 0x38; *p++ = 0x00;		/* cmp dword [rax], 0 */
+	p = emit_jcc(p, JNE);
+	fix[2] = p - 4;
+
+	/* chaining slots on the PC in rcx */
+	if(sizeof(sim->state->$(pc_name)) == 8)
+		*p++ = 0x48;
+	*p++ = 0x8B;								/* mov ecx / rcx, [rdi + off] */
+	p = emit_rdi(p, RCX, offsetof($(proc)_state_t, $(pc_name)));
+	for(i = 0; i < 2; i++) {
+		*p++ = 0x48; *p++ = 0x3B;				/* cmp rcx, [rip + address] */
+		p = emit_rip(p, RCX, &b->slots->address[i], 0);
+		*p++ = 0x75; *p++ = 0x06;				/* jne +6 */
+		*p++ = 0xFF;							/* jmp [rip + target] */
+		p = emit_rip(p, 4, &b->slots->target[i], 0);
+	}
+
+	/* return to the run loop */
+	b->exit = p;
+	p = emit_movi(p, RAX, (uintptr_t)b);
+	*p++ = 0x48; *p++ = 0x89;					/* mov [rip + last], rax */
+	p = emit_rip(p, RAX, &jit->shared->last, 0);
+	*p++ = 0xC3;								/* ret */
+	for(i = 0; i < 3; i++)
+		fix_rel32(fix[i], b->exit);
+	for(i = 0; i < 2; i++)
+		jit_set_slot(b, i, NULL);
+
+	/* exits in the middle of the block */
+	for(i = 0; i < n - 1; i++) {
+		fix_rel32(exits[i][0], p);
+		fix_rel32(exits[i][1], p);
+		*p++ = 0xB8;							/* mov eax, i + 1 */
+		p = emit32(p, i + 1);
+		*p++ = 0xE9;							/* jmp tail */
+		p = emit32(p, 0);
+		fix_rel32(p - 4, tail);
+	}
+	__builtin___clear_cache((char *)b->code, (char *)p);
+	if(jit_protect(jit, b->code, p, PROT_READ | PROT_EXEC) != 0) {
+		$(proc)_error("cannot make the translated code executable");
+		jit->dtop -= sizeof($(proc)_jit_slots_t);
+		free(b);
+		return NULL;
+	}
+	jit->top = p;
+
+	/* invalidate the block on write */
+	$(proc)_mem_watch(jit->mem, b->address);
+	$(proc)_mem_watch(jit->mem, b->address + (b->size - 1));
+	return b;
+}
+
+
+/**
+ * Find a block in the translation cache.
+ * @param jit		Current translator.
+ * @param address	Block address.
+ * @return			Found block or NULL.
+ */
+static $(proc)_jit_block_t *jit_find($(proc)_jit_t *jit, $(proc)_address_t address)
+{
+	$(proc)_jit_block_t *b;
+	for(b = jit->hash[HASH(address)]; b != NULL; b = b->next)
+		if(b->address == address)
+			return b;
+	return NULL;
+}
+
+
+/**
+ * Build a block translator for the given simulator. The translated code
+ * uses the state and the decoder of the simulator.
+ * @param sim	Simulator to translate for.
+ * @return		Built translator or NULL if the host does not support
+ *				translation (the interpreter is used instead).
+ */
+$(proc)_jit_t *$(proc)_new_jit($(proc)_sim_t *sim)
+{
+	$(proc)_jit_t *jit;
+	long page = sysconf(_SC_PAGESIZE);
+
+	if(sizeof(sim->state->$(pc_name)) != 4 && sizeof(sim->state->$(pc_name)) != 8)
+		return NULL;
+	if(page <= 0 || $(PROC)_JIT_DATA_SIZE % page != 0)
+		return NULL;
+	jit = ($(proc)_jit_t *)calloc(1, sizeof($(proc)_jit_t));
+	if(jit == NULL)
+		return NULL;
+
+	/* the host code is made executable block by block */
+	jit->buf = (unsigned char *)mmap(NULL, $(PROC)_JIT_DATA_SIZE + $(PROC)_JIT_CODE_SIZE,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(jit->buf == MAP_FAILED) {
+		$(proc)_error("no memory for the block translator: interpreting");
+		free(jit);
+		return NULL;
+	}
+	jit->page = page;
+	jit->shared = ($(proc)_jit_shared_t *)jit->buf;
+	jit->dtop = jit->buf + sizeof($(proc)_jit_shared_t);
+	jit->code = jit->top = jit->buf + $(PROC)_JIT_DATA_SIZE;
+	jit->sim = sim;
+	jit->mem = $(proc)_get_memory($(proc)_platform(sim->state), $(PROC)_MAIN_MEMORY);
+	$(proc)_mem_add_watcher(jit->mem, jit_watcher, jit);
+	return jit;
+}
+
+
+/**
+ * Delete a block translator.
+ * @param jit	Translator to delete (may be NULL).
+ */
+void $(proc)_delete_jit($(proc)_jit_t *jit)
+{
+	if(jit == NULL)
+		return;
+	$(proc)_jit_flush(jit);
+	$(proc)_mem_remove_watcher(jit->mem, jit_watcher, jit);
+	munmap(jit->buf, $(PROC)_JIT_DATA_SIZE + $(PROC)_JIT_CODE_SIZE);
+	free(jit);
+}
+
+
+/**
+ * Remove all translated blocks, for example when the breakpoints
+ * change or when the host code buffer is full.
+ * @param jit	Translator to flush (may be NULL).
+ */
+void $(proc)_jit_flush($(proc)_jit_t *jit)
+{
+	int i;
+	if(jit == NULL)
+		return;
+	for(i = 0; i < $(PROC)_JIT_HASH_SIZE; i++)
+		while(jit->hash[i] != NULL) {
+			$(proc)_jit_block_t *b = jit->hash[i];
+			jit->hash[i] = b->next;
+			free(b);
+		}
+	jit->top = jit->code;
+	jit->dtop = jit->buf + sizeof($(proc)_jit_shared_t);
+	jit->shared->last = NULL;
+}
+
+
+/**
+ * Get the translated block at the given address. The block is translated
+ * after the address has been looked up $(PROC)_JIT_THRESHOLD times (the
+ * counters of the not translated addresses are shared by hashing, so that
+ * their memory is bounded) and the last executed block is chained to it.
+ * @param jit		Current translator.
+ * @param address	Block address.
+ * @return			Translated block or NULL if the instruction at this
+ *					address has to be interpreted.
+ */
+$(proc)_jit_block_t *$(proc)_jit_get($(proc)_jit_t *jit, $(proc)_address_t address)
+{
+	$(proc)_jit_block_t *b, *last = jit->shared->last;
+
+	jit->shared->last = NULL;
+	if(jit->shared->smc) {
+		jit_invalidate(jit);
+		last = NULL;
+	}
+
+	/* look up the block, translate it if hot */
+	b = jit_find(jit, address);
+	if(b == NULL) {
+		uint8_t *heat = &jit->heat[HEAT(address)];
+		if(++*heat < $(PROC)_JIT_THRESHOLD)
+			return NULL;
+		*heat = 0;
+		b = jit_translate(jit, address);
+		if(b == NULL)
+			return NULL;
+		b->next = jit->hash[HASH(address)];
+		jit->hash[HASH(address)] = b;
+	}
+
+	/* chain the last block to this one */
+	if(last != NULL && !$(proc)_is_breakpoint(jit->sim, address)) {
+		last->last = (last->last + 1) & 1;
+		jit_set_slot(last, last->last, b);
+	}
+	return b;
+}
+
+
+/**
+ * Execute a translated block and the blocks chained to it.
+ * @param jit	Current translator.
+ * @param b		Block to execute.
+ * @param limit	No other block is entered after this count of instructions.
+ * @return		Count of executed instructions.
+ */
+uint64_t $(proc)_jit_exec($(proc)_jit_t *jit, $(proc)_jit_block_t *b, uint64_t limit)
+{
+	jit->shared->count = 0;
+	jit->shared->limit = limit;
+	((void (*)($(proc)_state_t *))b->code)(jit->sim->state);
+	return jit->shared->count;
+}
+
+#else	/* $(PROC)_JIT_HOST */
+
+struct $(proc)_jit_t {
+	int dummy;
+};
+
+$(proc)_jit_t *$(proc)_new_jit($(proc)_sim_t *sim) { return NULL; }
+void $(proc)_delete_jit($(proc)_jit_t *jit) { }
+void $(proc)_jit_flush($(proc)_jit_t *jit) { }
+$(proc)_jit_block_t *$(proc)_jit_get($(proc)_jit_t *jit, $(proc)_address_t address) { return NULL; }
+uint64_t $(proc)_jit_exec($(proc)_jit_t *jit, $(proc)_jit_block_t *b, uint64_t limit) { return 0; }
+
+#endif	/* $(PROC)_JIT_HOST */
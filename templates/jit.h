@@ -0,0 +1,78 @@
+/* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
+
+#ifndef GLISS_$(PROC)_INCLUDE_$(PROC)_JIT_H
+#define GLISS_$(PROC)_INCLUDE_$(PROC)_JIT_H
+
+#include <stdint.h>
+#include <$(proc)/api.h>
+
+#if defined(__cplusplus)
+extern  "C"
+{
+#endif
+
+/* maximal number of instructions of a translated block */
+#ifndef $(PROC)_JIT_BLOCK_MAX
+#	define $(PROC)_JIT_BLOCK_MAX	32
+#endif
+
+/* number of interpretations of an address before translating its block */
+#ifndef $(PROC)_JIT_THRESHOLD
+#	define $(PROC)_JIT_THRESHOLD	16
+#endif
+
+/* hole kinds of the host code templates */
+#define $(PROC)_JIT_HOLE_ABS	0		/* address of a symbol (base + addend) */
+#define $(PROC)_JIT_HOLE_ADDR	1		/* address of the instruction + addend */
+#define $(PROC)_JIT_HOLE_NEXT	2		/* end of the template copy + addend */
+#define $(PROC)_JIT_HOLE_OP		3		/* operand (kind - $(PROC)_JIT_HOLE_OP) + addend */
+
+/* hole of a host code template, patched at translation time */
+typedef struct $(proc)_jit_hole_t {
+	uint32_t offset;					/* offset of the patched value in the template */
+	uint8_t size;						/* size of the patched value (in bytes) */
+	uint8_t kind;						/* kind of the hole */
+	const void *base;					/* symbol of $(PROC)_JIT_HOLE_ABS */
+	int64_t addend;						/* added to the value */
+} $(proc)_jit_hole_t;
+
+/* host code template of an instruction, produced by jit-mkstencils from
+ * the compilation of jit_stencils.c */
+typedef struct $(proc)_jit_stencil_t {
+	const unsigned char *code;			/* NULL if the instruction is not translated */
+	uint32_t size;						/* code size (in bytes) */
+	uint32_t hole_cnt;					/* number of holes */
+	const $(proc)_jit_hole_t *holes;	/* holes to patch */
+} $(proc)_jit_stencil_t;
+
+/* templates indexed by instruction identifier */
+extern const $(proc)_jit_stencil_t $(proc)_jit_stencils[];
+
+/* block of the translation cache */
+typedef struct $(proc)_jit_block_t {
+	struct $(proc)_jit_block_t *next;	/* next block in the hash bucket */
+	$(proc)_address_t address;			/* address of the first instruction */
+	$(proc)_address_t size;				/* size of the guest code (in bytes) */
+	int n;								/* instruction count */
+	int dead;							/* invalidated block */
+	unsigned char *code;				/* host code */
+	unsigned char *exit;				/* host code returning to the run loop */
+	struct $(proc)_jit_slots_t *slots;	/* chaining slots (data read by the host code) */
+	struct $(proc)_jit_block_t *succ[2];	/* blocks chained in the slots */
+	int last;							/* last replaced slot */
+} $(proc)_jit_block_t;
+
+/* block translator */
+typedef struct $(proc)_jit_t $(proc)_jit_t;
+
+$(proc)_jit_t *$(proc)_new_jit($(proc)_sim_t *sim);
+void $(proc)_delete_jit($(proc)_jit_t *jit);
+void $(proc)_jit_flush($(proc)_jit_t *jit);
+$(proc)_jit_block_t *$(proc)_jit_get($(proc)_jit_t *jit, $(proc)_address_t address);
+uint64_t $(proc)_jit_exec($(proc)_jit_t *jit, $(proc)_jit_block_t *block, uint64_t limit);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* GLISS_$(PROC)_INCLUDE_$(PROC)_JIT_H */
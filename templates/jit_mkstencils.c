@@ -0,0 +1,353 @@
+/* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
+
+/*
+ * Build tool of the block translator: read the ELF64 x86-64 relocatable
+ * object compiled from jit_stencils.c and output the C source of the
+ * template table $(proc)_jit_stencils[] (host code bytes and holes).
+ *
+ * A stencil is kept only if all its relocations are absolute (large code
+ * model) and refer to a hole, to an external symbol (resolved when the
+ * table is linked in the library) or to read-only data of the object
+ * (copied in the table). Its continuation must be a tail jump through a
+ * register to the end of the stencil copy; if the stencil ends by such a
+ * jump, it is removed so that the next code follows it.
+ * The other stencils are output as NULL: their instructions are
+ * interpreted. If the object is not ELF64 x86-64, all stencils are NULL.
+ *
+ * usage: jit-mkstencils OBJECT > jit_stencil_table.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+
+#define PREFIX		"$(proc)_jit_"
+#define STENCIL		PREFIX "stencil_"
+#define HOLE		PREFIX "hole_"
+
+/* hole kinds (as in jit.h) */
+#define HOLE_ABS	0
+#define HOLE_ADDR	1
+#define HOLE_NEXT	2
+#define HOLE_OP		3
+
+static unsigned char *obj;
+static size_t obj_size;
+static Elf64_Ehdr *ehdr;
+static Elf64_Shdr *shdrs;
+static Elf64_Sym *syms;
+static int sym_cnt;
+static const char *strs;
+static int *data_used;		/* read-only sections to copy in the table */
+static int *ext_used;		/* external symbols to declare */
+
+/* hole found in a stencil */
+typedef struct hole_t {
+	Elf64_Addr offset;
+	int size;
+	int kind;
+	int sym;				/* symbol index (HOLE_ABS) */
+	Elf64_Sxword addend;
+} hole_t;
+
+/* analyzed stencil */
+typedef struct stencil_t {
+	const char *ident;		/* instruction identifier */
+	const unsigned char *code;
+	Elf64_Addr size;		/* code size without the final jump */
+	hole_t *holes;
+	int hole_cnt;
+} stencil_t;
+
+
+/**
+ * Read the whole object file.
+ * @param path	Object path.
+ * @return		0 for success, -1 else.
+ */
+static int read_object(const char *path) {
+	FILE *in = fopen(path, "rb");
+	long size;
+	if(in == NULL)
+		return -1;
+	if(fseek(in, 0, SEEK_END) != 0 || (size = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0) {
+		fclose(in);
+		return -1;
+	}
+	obj_size = size;
+	obj = (unsigned char *)malloc(obj_size ? obj_size : 1);
+	if(obj == NULL || fread(obj, 1, obj_size, in) != obj_size) {
+		fclose(in);
+		return -1;
+	}
+	fclose(in);
+	return 0;
+}
+
+
+/**
+ * Check the object and find the symbol table.
+ * @return	0 if the object is supported, -1 else.
+ */
+static int check_object(void) {
+	int i;
+	ehdr = (Elf64_Ehdr *)obj;
+	if(obj_size < sizeof(Elf64_Ehdr)
+	|| memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+	|| ehdr->e_ident[EI_CLASS] != ELFCLASS64
+	|| ehdr->e_ident[EI_DATA] != ELFDATA2LSB
+	|| ehdr->e_type != ET_REL
+	|| ehdr->e_machine != EM_X86_64
+	|| ehdr->e_shoff + (size_t)ehdr->e_shnum * sizeof(Elf64_Shdr) > obj_size)
+		return -1;
+	shdrs = (Elf64_Shdr *)(obj + ehdr->e_shoff);
+	for(i = 0; i < ehdr->e_shnum; i++)
+		if(shdrs[i].sh_type == SHT_SYMTAB) {
+			syms = (Elf64_Sym *)(obj + shdrs[i].sh_offset);
+			sym_cnt = shdrs[i].sh_size / sizeof(Elf64_Sym);
+			strs = (const char *)(obj + shdrs[shdrs[i].sh_link].sh_offset);
+			break;
+		}
+	if(syms == NULL)
+		return -1;
+	data_used = (int *)calloc(ehdr->e_shnum, sizeof(int));
+	ext_used = (int *)calloc(sym_cnt, sizeof(int));
+	return data_used == NULL || ext_used == NULL ? -1 : 0;
+}
+
+
+/**
+ * Test if the section may be copied as read-only data.
+ * @param s		Section index.
+ * @return		True if it is read-only data.
+ */
+static int is_data(int s) {
+	return s > 0 && s < ehdr->e_shnum
+		&& shdrs[s].sh_type == SHT_PROGBITS
+		&& (shdrs[s].sh_flags & SHF_ALLOC)
+		&& !(shdrs[s].sh_flags & (SHF_WRITE | SHF_EXECINSTR));
+}
+
+
+/**
+ * Get the register loaded by "mov reg, imm64" from its imm64.
+ * @param code	Section code.
+ * @param off	Offset of the imm64.
+ * @return		Register number (0 to 15), -1 if not such an instruction.
+ */
+static int movabs_reg(const unsigned char *code, Elf64_Addr off) {
+	if(off < 2 || (code[off - 1] & 0xF8) != 0xB8 || (code[off - 2] & 0xFE) != 0x48)
+		return -1;
+	return (code[off - 1] & 0x07) | ((code[off - 2] & 0x01) << 3);
+}
+
+
+/**
+ * Get the register of the jump "jmp reg" ending a code.
+ * @param code	Code.
+ * @param size	Code size.
+ * @param len	To store the size of the jump.
+ * @return		Register number (0 to 15), -1 if the code does not end by such a jump.
+ */
+static int final_jump(const unsigned char *code, Elf64_Addr size, int *len) {
+	if(size >= 3 && code[size - 3] == 0x41 && code[size - 2] == 0xFF && (code[size - 1] & 0xF8) == 0xE0) {
+		*len = 3;
+		return (code[size - 1] & 0x07) | 8;
+	}
+	if(size >= 2 && code[size - 2] == 0xFF && (code[size - 1] & 0xF8) == 0xE0) {
+		*len = 2;
+		return code[size - 1] & 0x07;
+	}
+	return -1;
+}
+
+
+/**
+ * Analyze the stencil of a function.
+ * @param sym	Function symbol.
+ * @param st	Stencil to fill.
+ * @return		0 if the stencil is supported, -1 else.
+ */
+static int analyze_stencil(Elf64_Sym *sym, stencil_t *st) {
+	Elf64_Shdr *text = &shdrs[sym->st_shndx];
+	const unsigned char *code = obj + text->sh_offset;
+	Elf64_Addr start = sym->st_value, end = sym->st_value + sym->st_size;
+	int i, r, len, regs = 0;
+
+	if(text->sh_type != SHT_PROGBITS || end > text->sh_size)
+		return -1;
+	st->code = code + start;
+	st->size = sym->st_size;
+	st->hole_cnt = 0;
+	st->holes = NULL;
+
+	for(i = 0; i < ehdr->e_shnum; i++) {
+		Elf64_Rela *rels;
+		if(shdrs[i].sh_type == SHT_REL && shdrs[i].sh_info == sym->st_shndx)
+			return -1;
+		if(shdrs[i].sh_type != SHT_RELA || shdrs[i].sh_info != sym->st_shndx)
+			continue;
+		rels = (Elf64_Rela *)(obj + shdrs[i].sh_offset);
+		for(r = 0; r < (int)(shdrs[i].sh_size / sizeof(Elf64_Rela)); r++) {
+			Elf64_Rela *rel = &rels[r];
+			int rsym = ELF64_R_SYM(rel->r_info);
+			Elf64_Sym *s = &syms[rsym];
+			const char *name = strs + s->st_name;
+			hole_t h;
+
+			if(rel->r_offset < start || rel->r_offset >= end)
+				continue;
+			h.offset = rel->r_offset - start;
+			h.sym = rsym;
+			h.addend = rel->r_addend;
+			switch(ELF64_R_TYPE(rel->r_info)) {
+			case R_X86_64_64:	h.size = 8; break;
+			case R_X86_64_32:
+			case R_X86_64_32S:	h.size = 4; break;
+			case R_X86_64_16:	h.size = 2; break;
+			case R_X86_64_8:	h.size = 1; break;
+			default:			return -1;
+			}
+
+			/* find the kind */
+			if(strcmp(name, HOLE "next") == 0) {
+				int reg = movabs_reg(code, rel->r_offset);
+				if(h.size != 8 || reg < 0)
+					return -1;
+				regs |= 1 << reg;
+				h.kind = HOLE_NEXT;
+			}
+			else if(strcmp(name, HOLE "addr") == 0)
+				h.kind = HOLE_ADDR;
+			else if(strncmp(name, HOLE "op", strlen(HOLE "op")) == 0)
+				h.kind = HOLE_OP + atoi(name + strlen(HOLE "op"));
+			else if(strncmp(name, HOLE, strlen(HOLE)) == 0)
+				return -1;
+			else if(s->st_shndx == SHN_UNDEF && ELF64_ST_BIND(s->st_info) != STB_LOCAL && *name != '\0')
+				h.kind = HOLE_ABS;
+			else if(s->st_shndx < SHN_LORESERVE && is_data(s->st_shndx))
+				h.kind = HOLE_ABS;
+			else
+				return -1;
+
+			/* record the hole */
+			st->holes = (hole_t *)realloc(st->holes, (st->hole_cnt + 1) * sizeof(hole_t));
+			if(st->holes == NULL)
+				return -1;
+			st->holes[st->hole_cnt++] = h;
+		}
+	}
+	/* the continuation must be a tail jump (a return would grow the stack) */
+	if(regs == 0 || st->size == 0 || st->code[st->size - 1] == 0xC3)
+		return -1;
+
+	/* remove the final jump to the next code: it follows the stencil */
+	r = final_jump(st->code, st->size, &len);
+	if(r >= 0 && (regs & (1 << r)))
+		st->size -= len;
+	return 0;
+}
+
+
+/**
+ * Output the holes and the code of a supported stencil.
+ * @param st	Stencil to output.
+ */
+static void output_stencil(stencil_t *st) {
+	Elf64_Addr i;
+	int j;
+
+	printf("static const $(proc)_jit_hole_t $(proc)_jit_holes_%s[] = {\n", st->ident);
+	for(j = 0; j < st->hole_cnt; j++) {
+		hole_t *h = &st->holes[j];
+		Elf64_Sym *s = &syms[h->sym];
+		printf("\t{ %llu, %d, %d, ", (unsigned long long)h->offset, h->size, h->kind);
+		if(h->kind != HOLE_ABS)
+			printf("NULL, %lldLL },\n", (long long)h->addend);
+		else if(s->st_shndx == SHN_UNDEF)
+			printf("$(proc)_jit_ext_%d, %lldLL },\n", h->sym, (long long)h->addend);
+		else
+			printf("$(proc)_jit_data_%d, %lldLL },\n", s->st_shndx, (long long)(s->st_value + h->addend));
+	}
+	printf("\t{ 0, 0, 0, NULL, 0 }\n};\n");
+	printf("static const unsigned char $(proc)_jit_code_%s[] = {", st->ident);
+	for(i = 0; i < st->size; i++)
+		printf("%s0x%02x,", i % 16 == 0 ? "\n\t" : " ", st->code[i]);
+	printf("\n\t0\n};\n\n");
+}
+
+
+int main(int argc, char **argv) {
+	stencil_t *sts;
+	int i, j, n = 0;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s OBJECT > jit_stencil_table.c\n", argv[0]);
+		return 2;
+	}
+	if(read_object(argv[1]) < 0) {
+		fprintf(stderr, "ERROR: cannot read %s\n", argv[1]);
+		return 1;
+	}
+	printf("/* Generated by jit-mkstencils from %s */\n\n", argv[1]);
+	printf("#include <stddef.h>\n#include <$(proc)/id.h>\n#include \"jit.h\"\n\n");
+	if(check_object() < 0) {
+		fprintf(stderr, "WARNING: %s is not an ELF64 x86-64 object: no instruction translated\n", argv[1]);
+		printf("const $(proc)_jit_stencil_t $(proc)_jit_stencils[$(PROC)_TOP] = { { NULL, 0, 0, NULL } };\n");
+		return 0;
+	}
+
+	/* analyze the stencils */
+	sts = (stencil_t *)calloc(sym_cnt, sizeof(stencil_t));
+	if(sts == NULL) {
+		fprintf(stderr, "ERROR: not enough memory\n");
+		return 1;
+	}
+	for(i = 0; i < sym_cnt; i++) {
+		const char *name = strs + syms[i].st_name;
+		if(ELF64_ST_TYPE(syms[i].st_info) != STT_FUNC || syms[i].st_shndx == SHN_UNDEF
+		|| syms[i].st_shndx >= SHN_LORESERVE || strncmp(name, STENCIL, strlen(STENCIL)) != 0)
+			continue;
+		sts[n].ident = name + strlen(STENCIL);
+		if(analyze_stencil(&syms[i], &sts[n]) < 0) {
+			fprintf(stderr, "WARNING: instruction %s is not translated\n", sts[n].ident);
+			continue;
+		}
+		for(j = 0; j < sts[n].hole_cnt; j++)
+			if(sts[n].holes[j].kind == HOLE_ABS) {
+				Elf64_Sym *s = &syms[sts[n].holes[j].sym];
+				if(s->st_shndx == SHN_UNDEF)
+					ext_used[sts[n].holes[j].sym] = 1;
+				else
+					data_used[s->st_shndx] = 1;
+			}
+		n++;
+	}
+
+	/* external symbols and read-only data */
+	for(i = 0; i < sym_cnt; i++)
+		if(ext_used[i])
+			printf("extern char $(proc)_jit_ext_%d[] __asm__(\"%s\");\n", i, strs + syms[i].st_name);
+	for(i = 0; i < ehdr->e_shnum; i++)
+		if(data_used[i]) {
+			Elf64_Xword k, align = shdrs[i].sh_addralign;
+			printf("static const unsigned char $(proc)_jit_data_%d[] __attribute__((aligned(%llu))) = {",
+				i, (unsigned long long)(align < 1 ? 1 : align > 4096 ? 4096 : align));
+			for(k = 0; k < shdrs[i].sh_size; k++)
+				printf("%s0x%02x,", k % 16 == 0 ? "\n\t" : " ", obj[shdrs[i].sh_offset + k]);
+			printf("\n\t0\n};\n");
+		}
+	printf("\n");
+
+	/* stencils and table */
+	for(i = 0; i < n; i++)
+		output_stencil(&sts[i]);
+	printf("const $(proc)_jit_stencil_t $(proc)_jit_stencils[$(PROC)_TOP] = {\n");
+	for(i = 0; i < n; i++)
+		printf("\t[$(PROC)_%s] = { $(proc)_jit_code_%s, %llu, %d, $(proc)_jit_holes_%s },\n",
+			sts[i].ident, sts[i].ident, (unsigned long long)sts[i].size, sts[i].hole_cnt, sts[i].ident);
+	printf("};\n");
+	fprintf(stderr, "%d translated instructions\n", n);
+	return 0;
+}
@@ -0,0 +1,77 @@
+/* Generated by gep ($(date)) copyright (c) 2008 IRIT - UPS */
+
+/*
+ * Host code templates (stencils) of the block translator. This file is
+ * not linked in the library: it is compiled with the large code model and
+ * without position-independent code so that each value unknown at compile
+ * time is an absolute relocation, and jit-mkstencils turns the object into
+ * the template table jit_stencil_table.c.
+ *
+ * Each stencil is the instruction code of code_table.h, flattened, where the
+ * instruction address and the operands are the addresses of the weak
+ * $(proc)_jit_hole_XXX symbols: they become immediate values patched by the
+ * translator. A stencil ends by a tail jump to $(proc)_jit_hole_next, the
+ * code following the stencil in the translated block.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#define $(PROC)_NO_CODE_TABLE
+#include "code_table.h"
+
+/* continuation of a stencil */
+typedef void $(proc)_jit_next_t($(proc)_state_t *state);
+extern char $(proc)_jit_hole_next[] __attribute__((weak));
+#define $(PROC)_JIT_NEXT(state)		(($(proc)_jit_next_t *)$(proc)_jit_hole_next)(state)
+
+/* instruction address */
+extern char $(proc)_jit_hole_addr[] __attribute__((weak));
+
+/* operand values: the patched 64-bit value contains the bits of the operand */
+extern char $(proc)_jit_hole_unsupported[] __attribute__((weak));
+#define $(PROC)_JIT_VALUE_int8(h)			((int8_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_uint8(h)			((uint8_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_int16(h)			((int16_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_uint16(h)			((uint16_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_int32(h)			((int32_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_uint32(h)			((uint32_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_int64(h)			((int64_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE_uint64(h)			((uint64_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE__float(h)			$(proc)_jit_float((uint32_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE__double(h)		$(proc)_jit_double((uint64_t)(uintptr_t)(h))
+#define $(PROC)_JIT_VALUE__long_double(h)	((long double)(uintptr_t)$(proc)_jit_hole_unsupported)
+#define $(PROC)_JIT_VALUE_string(h)			((char *)$(proc)_jit_hole_unsupported)
+
+static inline float $(proc)_jit_float(uint32_t bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static inline double $(proc)_jit_double(uint64_t bits) {
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+$(foreach instructions)
+/* $(syntax) */
+__attribute__((flatten)) void $(proc)_jit_stencil_$(IDENT)($(proc)_state_t *state) {
+	$(proc)_inst_t inst;
+	inst.ident = $(PROC)_$(IDENT);
+	inst.addr = ($(proc)_address_t)(uintptr_t)$(proc)_jit_hole_addr;
+$(foreach params)
+	{
+		extern char $(proc)_jit_hole_op$(INDEX)[] __attribute__((weak));
+$(if !GLISS_INSTR_FAST_STRUCT)
+		inst.instrinput[$(INDEX)].val.$(param_type) = $(PROC)_JIT_VALUE_$(param_type)($(proc)_jit_hole_op$(INDEX));
+$(else)
+		inst.op_union.op_struct_$(ident).$(PARAM) = $(PROC)_JIT_VALUE_$(param_type)($(proc)_jit_hole_op$(INDEX));
+$(end)
+	}
+$(end)
+	$(proc)_instr_$(IDENT)_code(state, &inst);
+	$(PROC)_JIT_NEXT(state);
+}
+
+$(end)
@@ -20,6 +20,11 @@ struct $(proc)_platform_t
 	$(proc)_address_t entry;
 	/* initial sp, argv, envp ... */
 	$(proc)_env_t *sys_env;
+	/* argv, envp and auxv owned by a forked platform (null else) */
+	void *env_copy;
+	/* last checkpoint saved or loaded (chain 0 if none) */
+	uint64_t ckp_chain;
+	uint64_t ckp_index;
 
 	union
 	{
@@ -34,6 +39,14 @@ $(end)
 $(foreach modules)
 	$(PROC)_$(NAME)_STATE
 $(end)
+#ifdef $(PROC)_FLAT_DECODE
+	/* pre-decoded code image shared by the decoders */
+	struct $(proc)_flat_image_t *flat_image;
+#endif
+#ifdef $(PROC)_SHARED_DECODE_CACHE
+	/* decode cache shared by the decoders */
+	struct $(proc)_decode_cache_t *decode_cache;
+#endif
 };
 
 /* functions */
@@ -33,6 +33,7 @@ extern  "C" {
 #define GLISS_EXCEPTION_STATE
 #define GLISS_EXCEPTION_INIT(s)
 #define GLISS_EXCEPTION_DESTROY(s)
+#define GLISS_EXCEPTION_COPY(s, src)
 
 void ppc_launch_exception(const char *, int);
 
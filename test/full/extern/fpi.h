@@ -32,6 +32,7 @@ extern  "C" {
 #define GLISS_FPI_STATE
 #define GLISS_FPI_INIT(s)
 #define GLISS_FPI_DESTROY(s)
+#define GLISS_FPI_COPY(s, src)
 
 #define FPI_TONEAREST   FE_TONEAREST
 #define FPI_TOWARDZERO  FE_TOWARDZERO
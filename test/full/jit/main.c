@@ -0,0 +1,143 @@
+/*
+ * Test of the block translator: the same executable is simulated
+ * instruction by instruction by ppc_step() (interpreter), then by
+ * ppc_run_n() with the given budget (translated blocks, interpreter
+ * for the other instructions). Both runs must end with the same state
+ * and the same number of instructions.
+ *
+ * The library must be generated with "make DFLAGS=-jit".
+ *
+ * usage: main EXECUTABLE [BUDGET]
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ppc/api.h>
+#include <ppc/loader.h>
+
+/* result of a simulation */
+typedef struct result_t {
+	uint64_t insts;		/* executed instructions */
+	char *state;		/* dump of the final state */
+	size_t size;		/* size of the dump */
+} result_t;
+
+static const char *path;
+
+
+/**
+ * Simulate the executable until its end.
+ * @param res		Filled with the result of the simulation.
+ * @param budget	Budget of the calls to ppc_run_n() (0 to use ppc_step()).
+ * @return			0 for success, -1 else.
+ */
+static int simulate(result_t *res, uint64_t budget) {
+	ppc_loader_t *loader;
+	ppc_platform_t *pf;
+	ppc_state_t *state;
+	ppc_sim_t *sim;
+	ppc_env_t *env;
+	ppc_address_t start, exit_addr = 0;
+	char *argv[] = { (char *)path, NULL }, *envp[] = { NULL };
+	FILE *out;
+	int i;
+
+	/* look for start and exit addresses */
+	loader = ppc_loader_open(path);
+	if(loader == NULL) {
+		fprintf(stderr, "ERROR: cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	start = ppc_loader_start(loader);
+	i = ppc_loader_find_sym(loader, "_exit");
+	if(i >= 0) {
+		ppc_loader_sym_t data;
+		ppc_loader_sym(loader, i, &data);
+		exit_addr = data.value;
+	}
+	ppc_loader_close(loader);
+
+	/* build the simulator */
+	pf = ppc_new_platform();
+	assert(pf != NULL);
+	env = ppc_get_sys_env(pf);
+	env->argc = 1;
+	env->argv = argv;
+	env->argv_addr = 0;
+	env->envp = envp;
+	env->envp_addr = 0;
+	env->auxv = 0;
+	env->auxv_addr = 0;
+	env->stack_pointer = 0;
+	if(ppc_load_platform(pf, path) == -1) {
+		fprintf(stderr, "ERROR: cannot load %s\n", path);
+		return -1;
+	}
+	state = ppc_new_state(pf);
+	assert(state != NULL);
+	sim = ppc_new_sim(state, start, exit_addr);
+	assert(sim != NULL);
+
+	/* run it */
+	res->insts = 0;
+	if(budget == 0)
+		while(!ppc_is_sim_ended(sim)) {
+			ppc_step(sim);
+			res->insts++;
+		}
+	else {
+		if(sim->jit == NULL)
+			printf("WARNING: no block translator on this host\n");
+		while(!ppc_is_sim_ended(sim))
+			res->insts += ppc_run_n(sim, budget, NULL);
+	}
+	out = open_memstream(&res->state, &res->size);
+	assert(out != NULL);
+	ppc_dump_state(state, out);
+	fclose(out);
+
+	/* cleanup */
+	ppc_delete_sim(sim);
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+	uint64_t budget = 100003;
+	result_t reference, translated;
+	int failed;
+
+	/* parse arguments */
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s EXECUTABLE [BUDGET]\n", argv[0]);
+		return 2;
+	}
+	path = argv[1];
+	if(argc > 2)
+		budget = strtoull(argv[2], NULL, 10);
+	if(budget == 0) {
+		fprintf(stderr, "ERROR: the budget must be positive\n");
+		return 2;
+	}
+
+	/* interpreted and translated runs */
+	if(simulate(&reference, 0) != 0 || simulate(&translated, budget) != 0)
+		return 1;
+	printf("reference: %llu instructions\n", (unsigned long long)reference.insts);
+
+	/* display result */
+	failed = translated.insts != reference.insts
+		|| translated.size != reference.size
+		|| memcmp(translated.state, reference.state, translated.size) != 0;
+	free(reference.state);
+	free(translated.state);
+	if(failed) {
+		printf("FAILURE: the translated run (%llu instructions) differs from the interpreted run\n",
+			(unsigned long long)translated.insts);
+		return 1;
+	}
+	printf("SUCCESS: translated run identical to the interpreted run\n");
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Test of the sampling simulation: the same executable is simulated
+ * by ppc_run_and_count_inst(), then by alternating fast-forwards with
+ * ppc_run_n() and detailed windows with ppc_next_inst()/ppc_step()
+ * (as the -sample option of the simulator). Both runs must end with
+ * the same state and the same number of instructions.
+ *
+ * To test the dynamic traces, the library must be generated with
+ * "make DECODE=decode32_dtrace DFLAGS='-gen-with-trace -on GLISS_NO_MALLOC'".
+ *
+ * usage: main EXECUTABLE [PERIOD [WINDOW]]
+ */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ppc/api.h>
+#include <ppc/loader.h>
+
+/* result of a simulation */
+typedef struct result_t {
+	uint64_t insts;		/* executed instructions */
+	char *state;		/* dump of the final state */
+	size_t size;		/* size of the dump */
+} result_t;
+
+static const char *path;
+
+
+/**
+ * Simulate the executable until its end.
+ * @param res		Filled with the result of the simulation.
+ * @param period	Sampling period (0 for a run without sampling).
+ * @param window	Size of the detailed windows.
+ * @return			0 for success, -1 else.
+ */
+static int simulate(result_t *res, uint64_t period, uint64_t window) {
+	ppc_loader_t *loader;
+	ppc_platform_t *pf;
+	ppc_state_t *state;
+	ppc_sim_t *sim;
+	ppc_env_t *env;
+	ppc_address_t start, exit_addr = 0;
+	char *argv[] = { (char *)path, NULL }, *envp[] = { NULL };
+	FILE *out;
+	int i;
+
+	/* look for start and exit addresses */
+	loader = ppc_loader_open(path);
+	if(loader == NULL) {
+		fprintf(stderr, "ERROR: cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	start = ppc_loader_start(loader);
+	i = ppc_loader_find_sym(loader, "_exit");
+	if(i >= 0) {
+		ppc_loader_sym_t data;
+		ppc_loader_sym(loader, i, &data);
+		exit_addr = data.value;
+	}
+	ppc_loader_close(loader);
+
+	/* build the simulator */
+	pf = ppc_new_platform();
+	assert(pf != NULL);
+	env = ppc_get_sys_env(pf);
+	env->argc = 1;
+	env->argv = argv;
+	env->argv_addr = 0;
+	env->envp = envp;
+	env->envp_addr = 0;
+	env->auxv = 0;
+	env->auxv_addr = 0;
+	env->stack_pointer = 0;
+	if(ppc_load_platform(pf, path) == -1) {
+		fprintf(stderr, "ERROR: cannot load %s\n", path);
+		return -1;
+	}
+	state = ppc_new_state(pf);
+	assert(state != NULL);
+	sim = ppc_new_sim(state, start, exit_addr);
+	assert(sim != NULL);
+
+	/* run it */
+	if(period == 0)
+		res->insts = ppc_run_and_count_inst(sim);
+	else {
+		res->insts = 0;
+		while(!ppc_is_sim_ended(sim)) {
+			uint64_t n;
+			ppc_stop_t reason;
+
+			/* fast-forward */
+			res->insts += ppc_run_n(sim, period - window, &reason);
+			if(reason != PPC_STOP_BUDGET)
+				continue;
+
+			/* detailed window */
+			for(n = 0; n < window && !ppc_is_sim_ended(sim); n++) {
+				ppc_inst_t *inst = ppc_next_inst(sim);
+				if(inst->addr != state->CIA) {
+					fprintf(stderr, "ERROR: instruction at %08lx instead of %08lx\n",
+						(unsigned long)inst->addr, (unsigned long)state->CIA);
+					return -1;
+				}
+				ppc_free_inst(inst);
+				ppc_step(sim);
+			}
+			res->insts += n;
+		}
+	}
+	out = open_memstream(&res->state, &res->size);
+	assert(out != NULL);
+	ppc_dump_state(state, out);
+	fclose(out);
+
+	/* cleanup */
+	ppc_delete_sim(sim);
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+	uint64_t period = 1000, window = 100;
+	result_t reference, sampled;
+	int failed;
+
+	/* parse arguments */
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s EXECUTABLE [PERIOD [WINDOW]]\n", argv[0]);
+		return 2;
+	}
+	path = argv[1];
+	if(argc > 2)
+		period = strtoull(argv[2], NULL, 10);
+	if(argc > 3)
+		window = strtoull(argv[3], NULL, 10);
+	if(window == 0 || window >= period) {
+		fprintf(stderr, "ERROR: the window must be in ]0, PERIOD[\n");
+		return 2;
+	}
+
+	/* plain and sampled runs */
+	if(simulate(&reference, 0, 0) != 0 || simulate(&sampled, period, window) != 0)
+		return 1;
+	printf("reference: %llu instructions\n", (unsigned long long)reference.insts);
+
+	/* display result */
+	failed = sampled.insts != reference.insts
+		|| sampled.size != reference.size
+		|| memcmp(sampled.state, reference.state, sampled.size) != 0;
+	free(reference.state);
+	free(sampled.state);
+	if(failed) {
+		printf("FAILURE: the sampled run (%llu instructions) differs from the plain run\n",
+			(unsigned long long)sampled.insts);
+		return 1;
+	}
+	printf("SUCCESS: sampled run identical to the plain run\n");
+	return 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * Stress test of concurrent simulators: the same executable is simulated
+ * serially, then by several simulators running concurrently in different
+ * threads of the same process. Each concurrent run must end with a state
+ * identical to the serial run.
+ *
+ * usage: main EXECUTABLE [THREADS [RUNS]]
+ */
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ppc/api.h>
+#include <ppc/loader.h>
+
+/* result of a simulation */
+typedef struct result_t {
+	uint64_t insts;		/* executed instructions */
+	char *state;		/* dump of the final state */
+	size_t size;		/* size of the dump */
+} result_t;
+
+/* description of a thread */
+typedef struct job_t {
+	pthread_t thread;
+	int runs;
+	int failed;
+} job_t;
+
+static const char *path;
+static result_t reference;
+
+
+/**
+ * Simulate the executable until its end.
+ * @param res	Filled with the result of the simulation.
+ * @return		0 for success, -1 else.
+ */
+static int simulate(result_t *res) {
+	ppc_loader_t *loader;
+	ppc_platform_t *pf;
+	ppc_state_t *state;
+	ppc_sim_t *sim;
+	ppc_env_t *env;
+	ppc_address_t start, exit_addr = 0;
+	char *argv[] = { (char *)path, NULL }, *envp[] = { NULL };
+	FILE *out;
+	int i;
+
+	/* look for start and exit addresses */
+	loader = ppc_loader_open(path);
+	if(loader == NULL) {
+		fprintf(stderr, "ERROR: cannot open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	start = ppc_loader_start(loader);
+	i = ppc_loader_find_sym(loader, "_exit");
+	if(i >= 0) {
+		ppc_loader_sym_t data;
+		ppc_loader_sym(loader, i, &data);
+		exit_addr = data.value;
+	}
+	ppc_loader_close(loader);
+
+	/* build the simulator */
+	pf = ppc_new_platform();
+	assert(pf != NULL);
+	env = ppc_get_sys_env(pf);
+	env->argc = 1;
+	env->argv = argv;
+	env->argv_addr = 0;
+	env->envp = envp;
+	env->envp_addr = 0;
+	env->auxv = 0;
+	env->auxv_addr = 0;
+	env->stack_pointer = 0;
+	if(ppc_load_platform(pf, path) == -1) {
+		fprintf(stderr, "ERROR: cannot load %s\n", path);
+		return -1;
+	}
+	state = ppc_new_state(pf);
+	assert(state != NULL);
+	sim = ppc_new_sim(state, start, exit_addr);
+	assert(sim != NULL);
+
+	/* run it */
+	res->insts = ppc_run_and_count_inst(sim);
+	out = open_memstream(&res->state, &res->size);
+	assert(out != NULL);
+	ppc_dump_state(state, out);
+	fclose(out);
+
+	/* cleanup */
+	ppc_delete_sim(sim);
+	return 0;
+}
+
+
+/**
+ * Thread entry: perform several simulations and compare them with
+ * the reference.
+ * @param arg	Job of the thread.
+ */
+static void *run_job(void *arg) {
+	job_t *job = (job_t *)arg;
+	int i;
+	for(i = 0; i < job->runs; i++) {
+		result_t res;
+		if(simulate(&res) != 0
+		|| res.insts != reference.insts
+		|| res.size != reference.size
+		|| memcmp(res.state, reference.state, res.size) != 0)
+			job->failed++;
+		free(res.state);
+	}
+	return NULL;
+}
+
+
+int main(int argc, char **argv) {
+	int threads = 8, runs = 4, failed = 0, i;
+	job_t *jobs;
+
+	/* parse arguments */
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s EXECUTABLE [THREADS [RUNS]]\n", argv[0]);
+		return 2;
+	}
+	path = argv[1];
+	if(argc > 2)
+		threads = atoi(argv[2]);
+	if(argc > 3)
+		runs = atoi(argv[3]);
+
+	/* serial reference */
+	if(simulate(&reference) != 0)
+		return 1;
+	printf("reference: %llu instructions\n", (unsigned long long)reference.insts);
+
+	/* concurrent runs */
+	jobs = (job_t *)calloc(threads, sizeof(job_t));
+	assert(jobs != NULL);
+	for(i = 0; i < threads; i++) {
+		jobs[i].runs = runs;
+		if(pthread_create(&jobs[i].thread, NULL, run_job, &jobs[i]) != 0) {
+			fprintf(stderr, "ERROR: cannot create thread %d\n", i);
+			return 1;
+		}
+	}
+	for(i = 0; i < threads; i++) {
+		pthread_join(jobs[i].thread, NULL);
+		failed += jobs[i].failed;
+	}
+	free(jobs);
+	free(reference.state);
+
+	/* display result */
+	if(failed) {
+		printf("FAILURE: %d runs out of %d differ from the serial run\n", failed, threads * runs);
+		return 1;
+	}
+	printf("SUCCESS: %d concurrent runs identical to the serial run\n", threads * runs);
+	return 0;
+}
@@ -142,6 +142,21 @@ int main(void) {
 		assert(check_block(mem, buf, PAGE / 2, 3 * PAGE));
 	}
 
+	/* scattered pages (conflicting page caches) */
+	{
+		int i;
+		for(i = 0; i < 256; i++)
+			gliss_mem_write32(mem, 0x10000000 + i * 17 * PAGE + i, i);
+		for(i = 0; i < 256; i++)
+			assert(gliss_mem_read32(mem, 0x10000000 + i * 17 * PAGE + i) == i);
+		for(i = 255; i >= 0; i--) {
+			gliss_mem_write8(mem, 0x10000000 + i * PAGE * 64, i);
+			assert(gliss_mem_read8(mem, 0x10000000 + i * PAGE * 64) == i);
+		}
+		for(i = 0; i < 256; i++)
+			assert(gliss_mem_read8(mem, 0x10000000 + i * PAGE * 64) == i);
+	}
+
 	gliss_mem_delete(mem);
 	puts("SUCCESS: all is fine !");
 	return 0;